@@ -0,0 +1,641 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Threshold alerts evaluated on every sample.
+ *
+ * A rule compares two expressions over PM table fields and derived values:
+ *
+ *     CORE_TEMP[*] > 90 for 2s hyst 5
+ *     PPT_VALUE / PPT_LIMIT > 0.98
+ *     THM_VALUE > THM_LIMIT - 3
+ *
+ * Rules are compiled once into one flat array of stack machine ops, field
+ * names resolved to their offset in pm_table. [*] makes one instance of the
+ * rule per array element. A condition has to hold for the "for" time before
+ * the rule fires, and it clears once the left side is "hyst" past the
+ * threshold. Events go to the sinks right away from the sampling loop: a
+ * shell hook, syslog and a unix datagram socket, stderr when none is set.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "commonfuncs.h"
+#include "pmt_fields.h"
+#include "derived.h"
+#include "alert.h"
+
+extern char **environ;
+
+enum alert_opcode {
+    OP_CONST,
+    OP_FIELD,           //Fixed element, offset points at its float pointer
+    OP_FIELD_EACH,      //Element of the instance being evaluated
+    OP_DERIVED,
+    OP_ADD,
+    OP_SUB,
+    OP_MUL,
+    OP_DIV,
+    OP_NEG,
+};
+
+typedef struct {
+    enum alert_opcode code;
+    float value;
+    size_t offset;
+    int derived;
+} alert_op;
+
+typedef struct {
+    const char *s;
+    const char *text;
+    int each;           //Array length of the [*] fields, 0 without
+    int per_core;
+    int depth, max_depth;
+} alert_parser;
+
+static alert_op ops[ALERT_MAX_OPS];
+static int op_count = 0;
+static alert_rule rules[ALERT_MAX_RULES];
+static int rule_count = 0;
+
+static const char *hook_cmd = NULL;
+static int use_syslog = 0;
+static int sock = -1;
+static struct sockaddr_un sock_addr;
+static pid_t children[ALERT_MAX_CHILDREN];    //Hooks still running, 0 for a free slot
+static int child_count = 0;
+static unsigned int dropped = 0;
+
+static void skip_space(alert_parser *p) {
+    while (isspace((unsigned char)*p->s))
+        p->s++;
+}
+
+static int parse_error(alert_parser *p, const char *msg) {
+    fprintf(stderr, "alert: %s at \"%s\" in rule \"%s\"\n", msg, p->s, p->text);
+    return -1;
+}
+
+static int emit(alert_parser *p, enum alert_opcode code, float value, size_t offset, int derived) {
+    if (op_count >= ALERT_MAX_OPS)
+        return parse_error(p, "too many operations");
+
+    //Binary ops take two values and leave one
+    p->depth += code == OP_ADD || code == OP_SUB || code == OP_MUL || code == OP_DIV ? -1 : code == OP_NEG ? 0 : 1;
+    if (p->depth > p->max_depth) p->max_depth = p->depth;
+    if (p->max_depth > ALERT_STACK)
+        return parse_error(p, "expression too deep");
+
+    ops[op_count].code = code;
+    ops[op_count].value = value;
+    ops[op_count].offset = offset;
+    ops[op_count].derived = derived;
+    op_count++;
+    return 0;
+}
+
+static int parse_expr(alert_parser *p);
+
+static int parse_name(alert_parser *p) {
+    const pmt_field *field;
+    const char *start = p->s;
+    size_t len;
+    char *end;
+    long idx;
+    int i;
+
+    while (isalnum((unsigned char)*p->s) || *p->s == '_')
+        p->s++;
+    len = p->s - start;
+
+    field = pmt_field_find(start, len);
+    if (!field) {
+        for (i = 0; i < DERIVED_COUNT; i++) {
+            if (strlen(derived_name(i)) == len && !strncmp(derived_name(i), start, len))
+                return emit(p, OP_DERIVED, 0, 0, i);
+        }
+        p->s = start;
+        return parse_error(p, "unknown field");
+    }
+
+    skip_space(p);
+    if (*p->s != '[') {
+        if (field->count > 1) {
+            p->s = start;
+            return parse_error(p, "array field needs an index or [*]");
+        }
+        return emit(p, OP_FIELD, 0, field->offset, 0);
+    }
+
+    p->s++;
+    skip_space(p);
+    if (*p->s == '*') {
+        p->s++;
+        if (p->each && p->each != field->count)
+            return parse_error(p, "[*] over arrays of different length");
+        p->each = field->count;
+        p->per_core = field->count == PMT_MAX_NUM_CORES;
+        if (emit(p, OP_FIELD_EACH, 0, field->offset, 0))
+            return -1;
+    } else {
+        idx = strtol(p->s, &end, 10);
+        if (end == p->s || idx < 0 || idx >= field->count)
+            return parse_error(p, "bad index");
+        p->s = end;
+        if (emit(p, OP_FIELD, 0, field->offset + idx * sizeof(float *), 0))
+            return -1;
+    }
+    skip_space(p);
+    if (*p->s != ']')
+        return parse_error(p, "expected ]");
+    p->s++;
+    return 0;
+}
+
+static int parse_factor(alert_parser *p) {
+    char *end;
+    float value;
+
+    skip_space(p);
+    if (*p->s == '(') {
+        p->s++;
+        if (parse_expr(p))
+            return -1;
+        skip_space(p);
+        if (*p->s != ')')
+            return parse_error(p, "expected )");
+        p->s++;
+        return 0;
+    }
+    if (*p->s == '-') {
+        p->s++;
+        return parse_factor(p) || emit(p, OP_NEG, 0, 0, 0);
+    }
+    if (isalpha((unsigned char)*p->s) || *p->s == '_')
+        return parse_name(p);
+
+    value = strtof(p->s, &end);
+    if (end == p->s)
+        return parse_error(p, "expected a number, field or (");
+    p->s = end;
+    return emit(p, OP_CONST, value, 0, 0);
+}
+
+static int parse_term(alert_parser *p) {
+    char op;
+
+    if (parse_factor(p))
+        return -1;
+    for (;;) {
+        skip_space(p);
+        if (*p->s != '*' && *p->s != '/')
+            return 0;
+        op = *p->s++;
+        if (parse_factor(p) || emit(p, op == '*' ? OP_MUL : OP_DIV, 0, 0, 0))
+            return -1;
+    }
+}
+
+static int parse_expr(alert_parser *p) {
+    char op;
+
+    if (parse_term(p))
+        return -1;
+    for (;;) {
+        skip_space(p);
+        if (*p->s != '+' && *p->s != '-')
+            return 0;
+        op = *p->s++;
+        if (parse_term(p) || emit(p, op == '+' ? OP_ADD : OP_SUB, 0, 0, 0))
+            return -1;
+    }
+}
+
+static int keyword(alert_parser *p, const char *word) {
+    size_t len = strlen(word);
+
+    if (strncmp(p->s, word, len) || isalnum((unsigned char)p->s[len]))
+        return 0;
+    p->s += len;
+    return 1;
+}
+
+static int parse_duration(alert_parser *p, unsigned long long *ns) {
+    char *end;
+    double value;
+
+    skip_space(p);
+    value = strtod(p->s, &end);
+    if (end == p->s || value < 0)
+        return parse_error(p, "expected a duration");
+    p->s = end;
+    if (!strncmp(p->s, "ms", 2)) {
+        value *= 1e6;
+        p->s += 2;
+    } else if (*p->s == 's') {
+        value *= 1e9;
+        p->s++;
+    } else if (*p->s == 'm') {
+        value *= 60e9;
+        p->s++;
+    } else {
+        value *= 1e9;
+    }
+    *ns = (unsigned long long)value;
+    return 0;
+}
+
+static int compile_rule(const char *text, size_t len) {
+    alert_parser p;
+    alert_rule *r;
+    int start = op_count;
+    char *end;
+
+    if (rule_count >= ALERT_MAX_RULES) {
+        fprintf(stderr, "alert: more than %d rules\n", ALERT_MAX_RULES);
+        return -1;
+    }
+    //A cut off rule would compile into a different one
+    if (len >= ALERT_TEXT_MAX) {
+        fprintf(stderr, "alert: rule \"%.*s...\" is longer than %d characters\n", 32, text, ALERT_TEXT_MAX - 1);
+        return -1;
+    }
+    r = &rules[rule_count];
+    memset(r, 0, sizeof(alert_rule));
+    memcpy(r->text, text, len);
+    r->text[len] = '\0';
+
+    memset(&p, 0, sizeof(p));
+    p.s = p.text = r->text;
+
+    r->lhs = op_count;
+    if (parse_expr(&p))
+        goto _FAIL;
+    r->lhs_len = op_count - r->lhs;
+
+    skip_space(&p);
+    if (p.s[0] == '>' || p.s[0] == '<') {
+        r->cmp = p.s[0] == '>' ? (p.s[1] == '=' ? ALERT_GE : ALERT_GT) : (p.s[1] == '=' ? ALERT_LE : ALERT_LT);
+        p.s += p.s[1] == '=' ? 2 : 1;
+    } else {
+        parse_error(&p, "expected >, >=, < or <=");
+        goto _FAIL;
+    }
+
+    r->rhs = op_count;
+    p.depth = 0;
+    if (parse_expr(&p))
+        goto _FAIL;
+    r->rhs_len = op_count - r->rhs;
+
+    for (;;) {
+        skip_space(&p);
+        if (!*p.s)
+            break;
+        if (keyword(&p, "for")) {
+            if (parse_duration(&p, &r->for_ns))
+                goto _FAIL;
+        } else if (keyword(&p, "hyst")) {
+            skip_space(&p);
+            r->hyst = strtof(p.s, &end);
+            if (end == p.s || r->hyst < 0) {
+                parse_error(&p, "expected a hysteresis value");
+                goto _FAIL;
+            }
+            p.s = end;
+        } else {
+            parse_error(&p, "expected for, hyst or the end of the rule");
+            goto _FAIL;
+        }
+    }
+
+    r->each = p.each ? p.each : 1;
+    r->per_core = p.per_core;
+    rule_count++;
+    return 0;
+
+_FAIL:
+    op_count = start;
+    return -1;
+}
+
+//Rules separated by ';' or new lines, '#' starts a comment
+int alert_compile(const char *text) {
+    const char *s = text, *end, *hash;
+    size_t len;
+
+    while (*s) {
+        end = s + strcspn(s, ";\n");
+        hash = memchr(s, '#', end - s);
+        len = (hash ? hash : end) - s;
+        while (len && isspace((unsigned char)*s)) {
+            s++;
+            len--;
+        }
+        while (len && isspace((unsigned char)s[len - 1]))
+            len--;
+        if (len && compile_rule(s, len))
+            return -1;
+        s = *end ? end + 1 : end;
+    }
+    return 0;
+}
+
+int alert_load_file(const char *path) {
+    FILE *f;
+    char *buf;
+    long size;
+    int err;
+
+    f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "alert: can't open \"%s\"\n", path);
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    buf = calloc(size + 1, 1);
+    if (!buf || fread(buf, 1, size, f) != (size_t)size) {
+        fprintf(stderr, "alert: can't read \"%s\"\n", path);
+        free(buf);
+        fclose(f);
+        return -1;
+    }
+    fclose(f);
+    err = alert_compile(buf);
+    free(buf);
+    return err;
+}
+
+int alert_set_sinks(const char *exec_cmd, const char *socket_path, int syslog_enable) {
+    hook_cmd = exec_cmd;
+    use_syslog = syslog_enable;
+    if (use_syslog)
+        openlog("ryzen_monitor_ng", LOG_PID, LOG_DAEMON);
+
+    if (socket_path) {
+        if (strlen(socket_path) >= sizeof(sock_addr.sun_path)) {
+            fprintf(stderr, "alert: socket path \"%s\" is too long\n", socket_path);
+            return -1;
+        }
+        memset(&sock_addr, 0, sizeof(sock_addr));
+        sock_addr.sun_family = AF_UNIX;
+        strcpy(sock_addr.sun_path, socket_path);
+        sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (sock < 0) {
+            fprintf(stderr, "alert: can't create the event socket\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int alert_count() {
+    return rule_count;
+}
+
+static float eval(pm_table *pmt, const alert_op *op, int len, int idx) {
+    float stack[ALERT_STACK], *p;
+    int sp = 0;
+
+    for (; len > 0; len--, op++) {
+        switch (op->code) {
+            case OP_CONST:
+                stack[sp++] = op->value;
+                break;
+            case OP_FIELD:
+                p = *(float **)((char *)pmt + op->offset);
+                stack[sp++] = p ? *p : NAN;
+                break;
+            case OP_FIELD_EACH:
+                p = ((float **)((char *)pmt + op->offset))[idx];
+                stack[sp++] = p ? *p : NAN;
+                break;
+            case OP_DERIVED:
+                stack[sp++] = derived_get()->v[op->derived];
+                break;
+            case OP_ADD: sp--; stack[sp - 1] += stack[sp]; break;
+            case OP_SUB: sp--; stack[sp - 1] -= stack[sp]; break;
+            case OP_MUL: sp--; stack[sp - 1] *= stack[sp]; break;
+            case OP_DIV: sp--; stack[sp - 1] /= stack[sp]; break;
+            case OP_NEG: stack[sp - 1] = -stack[sp - 1]; break;
+        }
+    }
+    return stack[0];
+}
+
+//NaN compares false, a missing field neither fires nor clears a rule
+static int compare(enum alert_cmp cmp, float a, float b) {
+    switch (cmp) {
+        case ALERT_GT: return a > b;
+        case ALERT_GE: return a >= b;
+        case ALERT_LT: return a < b;
+        case ALERT_LE: return a <= b;
+    }
+    return 0;
+}
+
+static void run_hook(const alert_rule *r, int idx, int firing, float value, float threshold, unsigned long long now_ns) {
+    char env_state[32], env_rule[ALERT_TEXT_MAX + 16], env_index[32], env_value[48], env_threshold[48], env_time[48];
+    char *argv[] = { "sh", "-c", (char *)hook_cmd, NULL };
+    char **envp;
+    int n = 0, i;
+    pid_t pid;
+
+    if (child_count >= ALERT_MAX_CHILDREN) {
+        dropped++;
+        return;
+    }
+
+    //Everything is prepared before the fork, the child only calls execve()
+    snprintf(env_state, sizeof(env_state), "ALERT_STATE=%s", firing ? "firing" : "cleared");
+    snprintf(env_rule, sizeof(env_rule), "ALERT_RULE=%s", r->text);
+    snprintf(env_index, sizeof(env_index), "ALERT_INDEX=%d", idx);
+    snprintf(env_value, sizeof(env_value), "ALERT_VALUE=%f", value);
+    snprintf(env_threshold, sizeof(env_threshold), "ALERT_THRESHOLD=%f", threshold);
+    snprintf(env_time, sizeof(env_time), "ALERT_TIME_NS=%llu", now_ns);
+
+    while (environ[n])
+        n++;
+    envp = calloc(n + 7, sizeof(char *));
+    if (!envp)
+        return;
+    for (i = 0; i < n; i++)
+        envp[i] = environ[i];
+    envp[n++] = env_state;
+    envp[n++] = env_rule;
+    envp[n++] = env_index;
+    envp[n++] = env_value;
+    envp[n++] = env_threshold;
+    envp[n++] = env_time;
+
+    pid = fork();
+    if (pid == 0) {
+        execve("/bin/sh", argv, envp);
+        _exit(127);
+    }
+    if (pid > 0) {
+        for (i = 0; i < ALERT_MAX_CHILDREN; i++) {
+            if (!children[i]) {
+                children[i] = pid;
+                child_count++;
+                break;
+            }
+        }
+    }
+    free(envp);
+}
+
+static void alert_event(const alert_rule *r, int idx, int firing, float value, float threshold, unsigned long long now_ns) {
+    char line[ALERT_TEXT_MAX + 128], where[24] = "";
+
+    if (r->each > 1)
+        snprintf(where, sizeof(where), " [%d]", idx);
+    snprintf(line, sizeof(line), "%s %s%s value=%.3f threshold=%.3f",
+        firing ? "FIRING" : "CLEARED", r->text, where, value, threshold);
+
+    if (use_syslog)
+        syslog(firing ? LOG_WARNING : LOG_NOTICE, "%s", line);
+
+    if (sock >= 0) {
+        snprintf(line, sizeof(line),
+            "{\"state\":\"%s\",\"rule\":%d,\"expr\":\"%s\",\"index\":%d,\"value\":%.3f,\"threshold\":%.3f,\"time_ns\":%llu}\n",
+            firing ? "firing" : "cleared", (int)(r - rules), r->text, idx, value, threshold, now_ns);
+        sendto(sock, line, strlen(line), 0, (struct sockaddr *)&sock_addr, sizeof(sock_addr));
+    }
+
+    if (hook_cmd)
+        run_hook(r, idx, firing, value, threshold, now_ns);
+
+    if (!use_syslog && sock < 0 && !hook_cmd)
+        fprintf(stderr, "alert: %s\n", line);
+}
+
+void alert_update(pm_table *pmt, system_info *sysinfo, unsigned long long now_ns) {
+    alert_rule *r;
+    alert_state *st;
+    float lhs, rhs;
+    int i, k, status;
+
+    //Reap the hooks that finished, only our own, the host may have children of its own
+    for (i = 0; child_count > 0 && i < ALERT_MAX_CHILDREN; i++) {
+        if (children[i] && waitpid(children[i], &status, WNOHANG) != 0) {
+            children[i] = 0;
+            child_count--;
+        }
+    }
+
+    for (i = 0; i < rule_count; i++) {
+        r = &rules[i];
+        for (k = 0; k < r->each; k++) {
+            if (r->per_core && (k >= pmt->max_cores || ((sysinfo->core_disable_map >> k) & 1)))
+                continue;
+            st = &r->state[k];
+            lhs = eval(pmt, &ops[r->lhs], r->lhs_len, k);
+            rhs = eval(pmt, &ops[r->rhs], r->rhs_len, k);
+
+            if (!st->active) {
+                if (!compare(r->cmp, lhs, rhs)) {
+                    st->pending = 0;
+                    continue;
+                }
+                if (!st->pending) {
+                    st->pending = 1;
+                    st->since_ns = now_ns;
+                }
+                if (now_ns - st->since_ns >= r->for_ns) {
+                    st->active = 1;
+                    st->pending = 0;
+                    r->fired++;
+                    alert_event(r, k, 1, lhs, rhs, now_ns);
+                }
+            } else if (!isnan(lhs) && !isnan(rhs)
+                       && !compare(r->cmp, lhs, r->cmp <= ALERT_GE ? rhs - r->hyst : rhs + r->hyst)) {
+                st->active = 0;
+                alert_event(r, k, 0, lhs, rhs, now_ns);
+            }
+        }
+    }
+}
+
+static int rule_active(const alert_rule *r) {
+    int k, n = 0;
+
+    for (k = 0; k < r->each; k++)
+        n += r->state[k].active;
+    return n;
+}
+
+void draw_alert_export(const char *hostname) {
+    int i;
+
+    for (i = 0; i < rule_count; i++)
+        fprintf(stdout, "ryzen_monitor_ng_alert,host=%s,rule=%d active=%ii,fired=%ui\n",
+                hostname, i, rule_active(&rules[i]), rules[i].fired);
+}
+
+void draw_alert_pane() {
+    char label[46], value[64];
+    int i, k, n, len;
+
+    if (!rule_count)
+        return;
+
+    fprintf(stdout, "╭── Alerts ─────────────────────────────────────┬────────────────────────────────────────────────╮\n");
+    for (i = 0; i < rule_count; i++) {
+        n = rule_active(&rules[i]);
+        if (!n) {
+            snprintf(value, sizeof(value), "ok | fired %u", rules[i].fired);
+        } else if (rules[i].each == 1) {
+            snprintf(value, sizeof(value), "FIRING | fired %u", rules[i].fired);
+        } else {
+            len = snprintf(value, sizeof(value), "FIRING");
+            for (k = 0; k < rules[i].each && len < 40; k++) {
+                if (rules[i].state[k].active)
+                    len += snprintf(value + len, sizeof(value) - len, " %d", k);
+            }
+            snprintf(value + len, sizeof(value) - len, " | fired %u", rules[i].fired);
+        }
+        snprintf(label, sizeof(label), "%.*s", (int)sizeof(label) - 1, rules[i].text);
+        print_line(label, "%s", value);
+    }
+    if (dropped)
+        print_line("Hooks dropped", "%u", dropped);
+    fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
+}
+
+void alert_free() {
+    if (sock >= 0)
+        close(sock);
+    sock = -1;
+    if (use_syslog)
+        closelog();
+    rule_count = op_count = 0;
+}
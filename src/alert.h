@@ -0,0 +1,62 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef ALERT_H
+#define ALERT_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define ALERT_MAX_RULES     64
+#define ALERT_MAX_OPS       1024    //Shared by all rules
+#define ALERT_STACK         16
+#define ALERT_TEXT_MAX      128
+#define ALERT_MAX_CHILDREN  8       //Hooks still running, more events are dropped
+
+enum alert_cmp { ALERT_GT, ALERT_GE, ALERT_LT, ALERT_LE };
+
+typedef struct {
+    int pending;                //Condition true, waiting for the debounce time
+    int active;
+    unsigned long long since_ns;
+} alert_state;
+
+typedef struct {
+    char text[ALERT_TEXT_MAX];
+    int lhs, lhs_len;           //Ranges in the op array
+    int rhs, rhs_len;
+    enum alert_cmp cmp;
+    unsigned long long for_ns;
+    float hyst;
+    int each;                   //Instances of a rule with [*], 1 otherwise
+    int per_core;               //[*] walks a per core array, disabled cores are skipped
+    unsigned int fired;
+    alert_state state[PMT_MAX_NUM_CORES];
+} alert_rule;
+
+int alert_compile(const char *rules);
+int alert_load_file(const char *path);
+int alert_set_sinks(const char *exec_cmd, const char *socket_path, int use_syslog);
+int alert_count();
+void alert_update(pm_table *pmt, system_info *sysinfo, unsigned long long now_ns);
+void draw_alert_export(const char *hostname);
+void draw_alert_pane();
+void alert_free();
+
+#endif
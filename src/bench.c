@@ -0,0 +1,240 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Benchmark of the per-sample path without the SMU.
+ *
+ * For every supported PM table version the table comes from a dump written
+ * with -w when one is found in the dump directory, otherwise from a fixed
+ * pseudo random fill so runs are comparable between builds. Each stage is
+ * timed per call after a warm-up. The renderers write to stdout, so for the
+ * run file descriptor 1 points at /dev/null behind a fully buffered stdout,
+ * and the JSON results go to a stream on a copy of the original descriptor.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "commonfuncs.h"
+#include "readinfo.h"
+#include "derived.h"
+#include "dumpfile.h"
+#include "bench.h"
+
+#define BENCH_TABLE_BYTES   0x4000  //Larger than any supported PM table
+
+extern void draw_screen(pm_table *pmt, system_info *sysinfo);
+extern void draw_export(pm_table *pmt, system_info *sysinfo);
+
+static const unsigned int bench_versions[] = {
+    0x380804, 0x380805, 0x380904, 0x380905, 0x400005,
+    0x240903, 0x240803, 0x370003, 0x370005, 0x1E0004,
+};
+
+enum bench_stage {
+    BENCH_SELECT,
+    BENCH_AGGREGATE,
+    BENCH_SCREEN,
+    BENCH_EXPORT,
+    BENCH_STAGES
+};
+
+static const char *bench_stage_name[] = { "select_pm_table_version", "derived_update", "draw_screen", "draw_export" };
+
+static volatile float bench_sink_value;
+
+static int compare_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+//Looks for a dump of this version as written by -w, or a legacy "<VERSION>_name" raw dump,
+//returns the size of its first snapshot or 0
+static size_t bench_load_dump(const char *dir, unsigned int version, unsigned char *buf, char *path, size_t path_len) {
+    unsigned long long t;
+    dumpfile_header hdr;
+    struct dirent *de;
+    struct stat st;
+    size_t size = 0;
+    char *end;
+    FILE *fp;
+    DIR *d;
+
+    if (!dir || !(d = opendir(dir)))
+        return 0;
+
+    while (!size && (de = readdir(d))) {
+        snprintf(path, path_len, "%s/%s", dir, de->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode) || !(fp = fopen(path, "rb")))
+            continue;
+        switch (dumpfile_read_header(fp, &hdr)) {
+            case 0:
+                if (hdr.pm_table_version == version && hdr.table_size <= BENCH_TABLE_BYTES &&
+                    dumpfile_read_snapshot(fp, &hdr, &t, buf) > 0)
+                    size = hdr.table_size;
+                break;
+            case 1:
+                if (strtoul(de->d_name, &end, 16) == version && *end == '_' && st.st_size <= BENCH_TABLE_BYTES)
+                    size = fread(buf, 1, st.st_size, fp);
+                break;
+        }
+        fclose(fp);
+    }
+    closedir(d);
+    return size;
+}
+
+static void bench_fill_synthetic(unsigned char *buf, unsigned int version) {
+    float *table = (float *)buf;
+    unsigned int seed = version;
+    int i;
+
+    //Values between 0 and 100 keep every renderer branch reachable
+    for (i = 0; i < BENCH_TABLE_BYTES / (int)sizeof(float); i++) {
+        seed = seed * 1103515245 + 12345;
+        table[i] = (seed >> 8) * (100.f / (1 << 24));
+    }
+}
+
+static void bench_stage(enum bench_stage stage, pm_table *pmt, system_info *sysinfo, unsigned int version, unsigned char *buf) {
+    switch (stage) {
+        case BENCH_SELECT:
+            select_pm_table_version(version, pmt, buf);
+            break;
+        case BENCH_AGGREGATE:
+            derived_update(pmt, sysinfo);
+            bench_sink_value = derived_get()->cores.total_power;
+            break;
+        case BENCH_SCREEN:
+            draw_screen(pmt, sysinfo);
+            break;
+        case BENCH_EXPORT:
+            draw_export(pmt, sysinfo);
+            break;
+        default:
+            break;
+    }
+}
+
+static void bench_print_result(FILE *out, enum bench_stage stage, unsigned long long *ns, int n, int last) {
+    unsigned long long sum = 0;
+    int i;
+
+    qsort(ns, n, sizeof(*ns), compare_ull);
+    for (i = 0; i < n; i++)
+        sum += ns[i];
+
+    fprintf(out, "        \"%s\": { \"mean_ns\": %.1f, \"min_ns\": %llu, \"p50_ns\": %llu, \"p90_ns\": %llu, \"p99_ns\": %llu, \"max_ns\": %llu }%s\n",
+        bench_stage_name[stage], (double)sum / n, ns[0], ns[n / 2], ns[(int)(n * 0.9)], ns[(int)(n * 0.99)], ns[n - 1],
+        last ? "" : ",");
+}
+
+int bench_run(bench_config *cfg) {
+    unsigned long long *ns, start, overhead;
+    unsigned char *buf;
+    char path[1024], source[1100];
+    enum bench_stage stage;
+    system_info sysinfo;
+    pm_table pmt;
+    FILE *out;
+    size_t size;
+    int v, i, fd, sink, count = sizeof(bench_versions) / sizeof(bench_versions[0]);
+
+    if (cfg->iterations < 1) cfg->iterations = BENCH_DEFAULT_ITERATIONS;
+    if (cfg->warmup < 0) cfg->warmup = 0;
+
+    buf = calloc(BENCH_TABLE_BYTES, sizeof(unsigned char));
+    ns = calloc(cfg->iterations, sizeof(unsigned long long));
+    sink = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    fflush(stdout);
+    fd = dup(STDOUT_FILENO);
+    out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!buf || !ns || sink < 0 || !out || dup2(sink, STDOUT_FILENO) < 0) {
+        fprintf(stderr, "bench: setup failed\n");
+        free(buf);
+        free(ns);
+        if (sink >= 0) close(sink);
+        if (out) fclose(out);
+        else if (fd >= 0) close(fd);
+        return -1;
+    }
+    close(sink);
+    //Nothing went through stdout yet in bench mode, the renderers get the same buffering as on a pipe
+    setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+    //Cost of the clock read itself, included in every figure below
+    overhead = ~0ULL;
+    for (i = 0; i < 1000; i++) {
+        start = get_time_ns();
+        start = get_time_ns() - start;
+        if (start < overhead) overhead = start;
+    }
+
+    fprintf(out, "{\n  \"iterations\": %d,\n  \"warmup\": %d,\n  \"clock_overhead_ns\": %llu,\n  \"core_stats_kernel\": \"%s\",\n  \"versions\": [\n",
+        cfg->iterations, cfg->warmup, overhead, core_stats_kernel());
+
+    for (v = 0; v < count; v++) {
+        memset(buf, 0, BENCH_TABLE_BYTES);
+        size = bench_load_dump(cfg->dump_dir, bench_versions[v], buf, path, sizeof(path));
+        if (size)
+            snprintf(source, sizeof(source), "%s", path);
+        else
+            bench_fill_synthetic(buf, bench_versions[v]);
+
+        memset(&sysinfo, 0, sizeof(sysinfo));
+        select_pm_table_version(bench_versions[v], &pmt, buf);
+        if (size && size < pmt.min_size) {
+            fprintf(stderr, "bench: \"%s\" is shorter than PM Table 0x%X, using a synthetic table\n", path, bench_versions[v]);
+            bench_fill_synthetic(buf, bench_versions[v]);
+            size = 0;
+        }
+        sysinfo_from_pmt(&pmt, &sysinfo);
+        derived_update(&pmt, &sysinfo);
+
+        fprintf(out, "    {\n      \"version\": \"0x%06X\",\n      \"source\": \"%s\",\n      \"stages\": {\n",
+            bench_versions[v], size ? source : "synthetic");
+
+        for (stage = 0; stage < BENCH_STAGES; stage++) {
+            for (i = 0; i < cfg->warmup; i++)
+                bench_stage(stage, &pmt, &sysinfo, bench_versions[v], buf);
+            for (i = 0; i < cfg->iterations; i++) {
+                start = get_time_ns();
+                bench_stage(stage, &pmt, &sysinfo, bench_versions[v], buf);
+                ns[i] = get_time_ns() - start;
+            }
+            bench_print_result(out, stage, ns, cfg->iterations, stage == BENCH_STAGES - 1);
+        }
+        fprintf(out, "      }\n    }%s\n", v == count - 1 ? "" : ",");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    //Put the original descriptor back under stdout
+    fflush(stdout);
+    fflush(out);
+    dup2(fileno(out), STDOUT_FILENO);
+    fclose(out);
+    free(buf);
+    free(ns);
+    return 0;
+}
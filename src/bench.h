@@ -0,0 +1,35 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#define BENCH_DEFAULT_ITERATIONS    2000
+#define BENCH_DEFAULT_WARMUP        200
+
+typedef struct {
+    const char *dump_dir;   //Dumps written with -w, NULL for synthetic tables only
+    int iterations;
+    int warmup;
+} bench_config;
+
+int bench_run(bench_config *cfg);
+
+#endif
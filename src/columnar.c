@@ -0,0 +1,585 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Columnar copies of recordings for analytics tools.
+ *
+ * Every decoded PM table field the table version has and every derived
+ * metric becomes one float column, next to a u64 time column. Rows are
+ * buffered for one chunk and written column after column, so memory stays
+ * at chunk_rows * columns floats however long the recording is. The footer
+ * keeps the min/max of every column in every chunk, a query skips the
+ * chunks its predicate can't match and reads only the columns it needs.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <sys/types.h>
+#include "commonfuncs.h"
+#include "readinfo.h"
+#include "derived.h"
+#include "pmt_fields.h"
+#include "recording.h"
+#include "columnar.h"
+
+
+typedef struct {
+    FILE *fp;
+    int columns;
+    int chunk_rows;
+    int rows;                   //Buffered in the current chunk
+    unsigned long long total;
+    unsigned long long *t;
+    float *values;              //Column major, chunk_rows per column
+    const float **src;          //Where every column takes its value from
+    columnar_column *cols;
+    columnar_chunk *chunks;
+    columnar_range *ranges;     //chunks * columns
+    int chunk_count, chunk_alloc;
+} columnar_writer;
+
+enum query_op { Q_NONE, Q_GT, Q_GE, Q_LT, Q_LE, Q_EQ };
+
+static void add_column(columnar_writer *w, const char *name, const float *src) {
+    memset(&w->cols[w->columns], 0, sizeof(*w->cols));
+    snprintf(w->cols[w->columns].name, COLUMNAR_NAME_LEN, "%s", name);
+    w->cols[w->columns].min = w->cols[w->columns].max = NAN;
+    w->src[w->columns++] = src;
+}
+
+//Fields the table version doesn't have get no column
+static int build_columns(columnar_writer *w, pm_table *pmt) {
+    const derived_values *d = derived_get();
+    const pmt_field *f;
+    char name[COLUMNAR_NAME_LEN];
+    int i, k, max = DERIVED_COUNT;
+    float *p;
+
+    for (i = 0; i < pmt_field_count(); i++)
+        max += pmt_field_at(i)->count;
+    w->cols = malloc(max * sizeof(*w->cols));
+    w->src = malloc(max * sizeof(*w->src));
+    if (!w->cols || !w->src)
+        return -1;
+
+    for (i = 0; i < pmt_field_count(); i++) {
+        f = pmt_field_at(i);
+        for (k = 0; k < f->count; k++) {
+            if (!(p = pmt_field_ptr(pmt, f, k)))
+                continue;
+            if (f->count > 1)
+                snprintf(name, sizeof(name), "%s[%d]", f->name, k);
+            else
+                snprintf(name, sizeof(name), "%s", f->name);
+            add_column(w, name, p);
+        }
+    }
+    for (i = 0; i < DERIVED_COUNT; i++) {
+        //Intermediate steps without a value of their own
+        if (i != DERIVED_CORE_LANES && i != DERIVED_CORE_STATS)
+            add_column(w, derived_name(i), &d->v[i]);
+    }
+    return 0;
+}
+
+static void range_of(const float *v, int n, columnar_range *r, unsigned long long *count) {
+    float lo = INFINITY, hi = -INFINITY;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (isnan(v[i]))
+            continue;
+        lo = v[i] < lo ? v[i] : lo;
+        hi = v[i] > hi ? v[i] : hi;
+        (*count)++;
+    }
+    r->min = lo <= hi ? lo : NAN;
+    r->max = lo <= hi ? hi : NAN;
+}
+
+static int flush_chunk(columnar_writer *w) {
+    columnar_chunk *chunk, *chunks;
+    columnar_range *r, *ranges;
+    columnar_column *col;
+    int c, alloc;
+
+    if (!w->rows)
+        return 0;
+    if (w->chunk_count == w->chunk_alloc) {
+        alloc = w->chunk_alloc ? 2 * w->chunk_alloc : 16;
+        if (!(chunks = realloc(w->chunks, alloc * sizeof(*w->chunks))))
+            return -1;
+        w->chunks = chunks;
+        if (!(ranges = realloc(w->ranges, (size_t)alloc * w->columns * sizeof(*w->ranges))))
+            return -1;
+        w->ranges = ranges;
+        w->chunk_alloc = alloc;
+    }
+
+    chunk = &w->chunks[w->chunk_count];
+    memset(chunk, 0, sizeof(*chunk));
+    chunk->offset = ftello(w->fp);
+    chunk->rows = w->rows;
+    chunk->t_min = w->t[0];
+    chunk->t_max = w->t[w->rows - 1];
+    if (fwrite(w->t, sizeof(*w->t), w->rows, w->fp) != (size_t)w->rows)
+        return -1;
+
+    for (c = 0; c < w->columns; c++) {
+        if (fwrite(&w->values[(size_t)c * w->chunk_rows], sizeof(float), w->rows, w->fp) != (size_t)w->rows)
+            return -1;
+        r = &w->ranges[(size_t)w->chunk_count * w->columns + c];
+        col = &w->cols[c];
+        range_of(&w->values[(size_t)c * w->chunk_rows], w->rows, r, &col->count);
+        if (!isnan(r->min)) {
+            col->min = isnan(col->min) || r->min < col->min ? r->min : col->min;
+            col->max = isnan(col->max) || r->max > col->max ? r->max : col->max;
+        }
+    }
+
+    w->chunk_count++;
+    w->rows = 0;
+    return 0;
+}
+
+static int append_row(columnar_writer *w, unsigned long long t) {
+    int c;
+
+    w->t[w->rows] = t;
+    for (c = 0; c < w->columns; c++)
+        w->values[(size_t)c * w->chunk_rows + w->rows] = *w->src[c];
+    w->total++;
+    if (++w->rows == w->chunk_rows)
+        return flush_chunk(w);
+    return 0;
+}
+
+static int write_footer(columnar_writer *w) {
+    columnar_trailer trailer;
+    size_t ranges = (size_t)w->chunk_count * w->columns;
+
+    memset(&trailer, 0, sizeof(trailer));
+    trailer.footer_offset = ftello(w->fp);
+    trailer.rows = w->total;
+    trailer.chunks = w->chunk_count;
+    trailer.crc = crc32c(0, w->cols, w->columns * sizeof(*w->cols));
+    trailer.crc = crc32c(trailer.crc, w->chunks, w->chunk_count * sizeof(*w->chunks));
+    trailer.crc = crc32c(trailer.crc, w->ranges, ranges * sizeof(*w->ranges));
+    memcpy(trailer.magic, COLUMNAR_END_MAGIC, sizeof(trailer.magic));
+
+    if (fwrite(w->cols, sizeof(*w->cols), w->columns, w->fp) != (size_t)w->columns ||
+        fwrite(w->chunks, sizeof(*w->chunks), w->chunk_count, w->fp) != (size_t)w->chunk_count ||
+        fwrite(w->ranges, sizeof(*w->ranges), ranges, w->fp) != ranges ||
+        fwrite(&trailer, sizeof(trailer), 1, w->fp) != 1)
+        return -1;
+    return 0;
+}
+
+int columnar_convert(const char *in, unsigned int version, const char *out, int chunk_rows) {
+    unsigned long long t;
+    columnar_header hdr;
+    columnar_writer w;
+    unsigned char *pm_buf = NULL;
+    pm_table pmt;
+    system_info sysinfo;
+    recording rec;
+    int ret, err = 0;
+
+    if (recording_open(&rec, in, version) != 0)
+        return -1;
+    memset(&w, 0, sizeof(w));
+    w.chunk_rows = chunk_rows > 0 ? chunk_rows : COLUMNAR_DEFAULT_CHUNK;
+
+    //The PM table fields must stay inside the buffer even for a short sample
+    pm_buf = calloc(rec.table_size > 10240 ? rec.table_size : 10240, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(rec.version, &pmt, pm_buf)) {
+        fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", rec.version);
+        err = -1;
+        goto _FREE;
+    }
+    if (rec.table_size < pmt.min_size) {
+        fprintf(stderr, "Samples in \"%s\" are %d bytes, but the selected PM Table is %d bytes long.\n", in, rec.table_size, pmt.min_size);
+        err = -1;
+        goto _FREE;
+    }
+
+    w.t = malloc(w.chunk_rows * sizeof(*w.t));
+    if (!w.t || build_columns(&w, &pmt) != 0 ||
+        !(w.values = malloc((size_t)w.chunk_rows * w.columns * sizeof(float)))) {
+        fprintf(stderr, "columnar: out of memory\n");
+        err = -1;
+        goto _FREE;
+    }
+    if (!(w.fp = fopen(out, "wb"))) {
+        fprintf(stderr, "Could not create the columnar file (\"%s\").\n", out);
+        err = -4;
+        goto _FREE;
+    }
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, COLUMNAR_MAGIC, sizeof(hdr.magic));
+    hdr.format = COLUMNAR_VERSION;
+    hdr.pm_table_version = rec.version;
+    hdr.columns = w.columns;
+    hdr.chunk_rows = w.chunk_rows;
+    if (fwrite(&hdr, sizeof(hdr), 1, w.fp) != 1)
+        err = -4;
+
+    memset(&sysinfo, 0, sizeof(sysinfo));
+    while (!err && (ret = recording_read(&rec, &t, pm_buf)) != 0) {
+        if (ret < 0) {
+            fprintf(stderr, "%s sample %llu in \"%s\", the rest is left out.\n",
+                ret == -2 ? "Checksum mismatch in" : "Truncated", w.total, in);
+            break;
+        }
+        sysinfo_from_pmt(&pmt, &sysinfo);
+        if (rec.dump)
+            dumpfile_apply_sysinfo(&rec.dump_hdr, &sysinfo);
+        derived_update(&pmt, &sysinfo);
+        if (append_row(&w, t) != 0)
+            err = -4;
+    }
+    if (!err && (flush_chunk(&w) != 0 || write_footer(&w) != 0))
+        err = -4;
+    if (fclose(w.fp) != 0 && !err)
+        err = -4;
+
+    if (err)
+        fprintf(stderr, "Could not write to the columnar file (\"%s\").\n", out);
+    else
+        fprintf(stderr, "Wrote %llu rows of %d columns in %d chunks to \"%s\".\n", w.total, w.columns + 1, w.chunk_count, out);
+
+_FREE:
+    recording_close(&rec);
+    free(pm_buf);
+    free(w.t);
+    free(w.values);
+    free((void *)w.src);
+    free(w.cols);
+    free(w.chunks);
+    free(w.ranges);
+    return err;
+}
+
+typedef struct {
+    FILE *fp;
+    columnar_header hdr;
+    columnar_trailer trailer;
+    columnar_column *cols;
+    columnar_chunk *chunks;
+    columnar_range *ranges;
+} columnar_file;
+
+static void columnar_close(columnar_file *f) {
+    if (f->fp)
+        fclose(f->fp);
+    free(f->cols);
+    free(f->chunks);
+    free(f->ranges);
+    memset(f, 0, sizeof(*f));
+}
+
+static int columnar_open(columnar_file *f, const char *path) {
+    size_t ranges;
+    unsigned int crc;
+
+    memset(f, 0, sizeof(*f));
+    if (!(f->fp = fopen(path, "rb"))) {
+        fprintf(stderr, "Could not read the columnar file (\"%s\").\n", path);
+        return -1;
+    }
+    if (fread(&f->hdr, sizeof(f->hdr), 1, f->fp) != 1 || memcmp(f->hdr.magic, COLUMNAR_MAGIC, sizeof(f->hdr.magic)) ||
+        f->hdr.format != COLUMNAR_VERSION || fseeko(f->fp, -(off_t)sizeof(f->trailer), SEEK_END) != 0 ||
+        fread(&f->trailer, sizeof(f->trailer), 1, f->fp) != 1 ||
+        memcmp(f->trailer.magic, COLUMNAR_END_MAGIC, sizeof(f->trailer.magic))) {
+        fprintf(stderr, "\"%s\" is not a complete columnar file.\n", path);
+        columnar_close(f);
+        return -1;
+    }
+
+    ranges = (size_t)f->trailer.chunks * f->hdr.columns;
+    f->cols = calloc(f->hdr.columns, sizeof(*f->cols));
+    f->chunks = calloc(f->trailer.chunks ? f->trailer.chunks : 1, sizeof(*f->chunks));
+    f->ranges = calloc(ranges ? ranges : 1, sizeof(*f->ranges));
+    if (!f->cols || !f->chunks || !f->ranges || fseeko(f->fp, f->trailer.footer_offset, SEEK_SET) != 0 ||
+        fread(f->cols, sizeof(*f->cols), f->hdr.columns, f->fp) != f->hdr.columns ||
+        fread(f->chunks, sizeof(*f->chunks), f->trailer.chunks, f->fp) != f->trailer.chunks ||
+        fread(f->ranges, sizeof(*f->ranges), ranges, f->fp) != ranges) {
+        fprintf(stderr, "Could not read the footer of \"%s\".\n", path);
+        columnar_close(f);
+        return -1;
+    }
+
+    crc = crc32c(0, f->cols, f->hdr.columns * sizeof(*f->cols));
+    crc = crc32c(crc, f->chunks, f->trailer.chunks * sizeof(*f->chunks));
+    crc = crc32c(crc, f->ranges, ranges * sizeof(*f->ranges));
+    if (crc != f->trailer.crc) {
+        fprintf(stderr, "The footer of \"%s\" failed its checksum.\n", path);
+        columnar_close(f);
+        return -1;
+    }
+    return 0;
+}
+
+//Column index, -1 for the time column, -2 when there is no such column
+static int find_column(columnar_file *f, const char *name, size_t len) {
+    unsigned int c;
+
+    if (strlen(COLUMNAR_TIME) == len && !strncmp(name, COLUMNAR_TIME, len))
+        return -1;
+    for (c = 0; c < f->hdr.columns; c++) {
+        if (strlen(f->cols[c].name) == len && !strncmp(f->cols[c].name, name, len))
+            return c;
+    }
+    return -2;
+}
+
+static void trim(const char **s, const char **end) {
+    while (*s < *end && (**s == ' ' || **s == '\t')) (*s)++;
+    while (*end > *s && ((*end)[-1] == ' ' || (*end)[-1] == '\t')) (*end)--;
+}
+
+static int parse_where(columnar_file *f, const char *where, int *col, enum query_op *op, double *value) {
+    static const struct { const char *str; enum query_op op; } ops[] = {
+        { ">=", Q_GE }, { "<=", Q_LE }, { "==", Q_EQ }, { ">", Q_GT }, { "<", Q_LT },
+    };
+    const char *p, *s = where, *end;
+    char *num_end;
+    size_t i;
+
+    for (p = where; *p; p++) {
+        for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++) {
+            if (strncmp(p, ops[i].str, strlen(ops[i].str)))
+                continue;
+            end = p;
+            trim(&s, &end);
+            if ((*col = find_column(f, s, end - s)) == -2) {
+                fprintf(stderr, "query: no column \"%.*s\"\n", (int)(end - s), s);
+                return -1;
+            }
+            *op = ops[i].op;
+            *value = strtod(p + strlen(ops[i].str), &num_end);
+            while (*num_end == ' ' || *num_end == '\t') num_end++;
+            if (num_end == p + strlen(ops[i].str) || *num_end) {
+                fprintf(stderr, "query: expected a number after \"%s\" in \"%s\"\n", ops[i].str, where);
+                return -1;
+            }
+            return 0;
+        }
+    }
+    fprintf(stderr, "query: expected <column> <op> <value> with >, >=, <, <= or ==, got \"%s\"\n", where);
+    return -1;
+}
+
+static int match(enum query_op op, double v, double ref) {
+    switch (op) {
+        case Q_GT: return v > ref;
+        case Q_GE: return v >= ref;
+        case Q_LT: return v < ref;
+        case Q_LE: return v <= ref;
+        case Q_EQ: return v == ref;
+        default:   return 1;
+    }
+}
+
+//Whether any value between min and max can match
+static int range_may_match(enum query_op op, double min, double max, double ref) {
+    if (isnan(min))
+        return 0;
+    switch (op) {
+        case Q_GT: return max > ref;
+        case Q_GE: return max >= ref;
+        case Q_LT: return min < ref;
+        case Q_LE: return min <= ref;
+        case Q_EQ: return min <= ref && ref <= max;
+        default:   return 1;
+    }
+}
+
+static int read_column(columnar_file *f, columnar_chunk *chunk, int col, void *buf) {
+    size_t size = col < 0 ? sizeof(unsigned long long) : sizeof(float);
+    off_t off = chunk->offset + (col < 0 ? 0 : (off_t)chunk->rows * sizeof(unsigned long long) + (off_t)col * chunk->rows * sizeof(float));
+
+    return fseeko(f->fp, off, SEEK_SET) == 0 && fread(buf, size, chunk->rows, f->fp) == chunk->rows ? 0 : -1;
+}
+
+static void print_columns(columnar_file *f, const char *path) {
+    unsigned int c;
+
+    fprintf(stdout, "# \"%s\": PM Table 0x%X, %llu rows in %u chunks\n", path,
+        f->hdr.pm_table_version, f->trailer.rows, f->trailer.chunks);
+    fprintf(stdout, "column\tcount\tmin\tmax\n");
+    if (f->trailer.chunks)
+        fprintf(stdout, "%s\t%llu\t%llu\t%llu\n", COLUMNAR_TIME, f->trailer.rows,
+            f->chunks[0].t_min, f->chunks[f->trailer.chunks - 1].t_max);
+    for (c = 0; c < f->hdr.columns; c++)
+        fprintf(stdout, "%s\t%llu\t%g\t%g\n", f->cols[c].name, f->cols[c].count, f->cols[c].min, f->cols[c].max);
+}
+
+//Without select the columns are listed, print_rows prints every matching row instead of a summary
+int columnar_query(const char *path, const char *select, const char *where, int print_rows) {
+    int *sel = NULL, nsel = 0, where_col = -2, r, s, err = 0;
+    unsigned long long *t = NULL, scanned_chunks = 0, matched = 0;
+    float **vals = NULL, *where_vals = NULL;
+    double *sum = NULL, *lo = NULL, *hi = NULL, ref = 0, v;
+    unsigned long long *n = NULL;
+    enum query_op op = Q_NONE;
+    columnar_chunk *chunk;
+    columnar_range *range;
+    const char *p, *end;
+    columnar_file f;
+    unsigned int k;
+
+    if (columnar_open(&f, path) != 0)
+        return -1;
+    if (!select) {
+        print_columns(&f, path);
+        columnar_close(&f);
+        return 0;
+    }
+
+    sel = calloc(f.hdr.columns + 1, sizeof(int));
+    vals = calloc(f.hdr.columns + 1, sizeof(float *));
+    sum = calloc(f.hdr.columns + 1, sizeof(double));
+    lo = calloc(f.hdr.columns + 1, sizeof(double));
+    hi = calloc(f.hdr.columns + 1, sizeof(double));
+    n = calloc(f.hdr.columns + 1, sizeof(unsigned long long));
+    t = calloc(f.hdr.chunk_rows ? f.hdr.chunk_rows : 1, sizeof(unsigned long long));
+    where_vals = calloc(f.hdr.chunk_rows ? f.hdr.chunk_rows : 1, sizeof(float));
+    if (!sel || !vals || !sum || !lo || !hi || !n || !t || !where_vals) {
+        fprintf(stderr, "query: out of memory\n");
+        err = -1;
+        goto _FREE;
+    }
+
+    for (p = select; *p && nsel <= (int)f.hdr.columns; p = *end ? end + 1 : end) {
+        end = strchr(p, ',');
+        if (!end) end = p + strlen(p);
+        s = find_column(&f, p, end - p);
+        if (s == -2) {
+            fprintf(stderr, "query: no column \"%.*s\", --query without --query-select lists them\n", (int)(end - p), p);
+            err = -1;
+            goto _FREE;
+        }
+        if (s == -1)
+            continue;   //The time column is printed with every row anyway
+        if (!(vals[nsel] = malloc(f.hdr.chunk_rows * sizeof(float)))) {
+            err = -1;
+            goto _FREE;
+        }
+        lo[nsel] = INFINITY;
+        hi[nsel] = -INFINITY;
+        sel[nsel++] = s;
+    }
+    if (where && parse_where(&f, where, &where_col, &op, &ref) != 0) {
+        err = -1;
+        goto _FREE;
+    }
+
+    if (print_rows) {
+        fprintf(stdout, "%s", COLUMNAR_TIME);
+        for (s = 0; s < nsel; s++)
+            fprintf(stdout, "\t%s", f.cols[sel[s]].name);
+        fprintf(stdout, "\n");
+    }
+
+    for (k = 0; k < f.trailer.chunks; k++) {
+        chunk = &f.chunks[k];
+        if (chunk->rows > f.hdr.chunk_rows) {
+            err = -1;
+            break;
+        }
+        if (op != Q_NONE && where_col < 0 && !range_may_match(op, chunk->t_min, chunk->t_max, ref))
+            continue;
+        if (op != Q_NONE && where_col >= 0) {
+            range = &f.ranges[(size_t)k * f.hdr.columns + where_col];
+            if (!range_may_match(op, range->min, range->max, ref))
+                continue;
+        }
+        scanned_chunks++;
+
+        if (read_column(&f, chunk, -1, t) != 0 ||
+            (where_col >= 0 && read_column(&f, chunk, where_col, where_vals) != 0)) {
+            err = -1;
+            break;
+        }
+        for (s = 0; s < nsel; s++) {
+            if (read_column(&f, chunk, sel[s], vals[s]) != 0) {
+                err = -1;
+                break;
+            }
+        }
+        if (err)
+            break;
+
+        for (r = 0; r < (int)chunk->rows; r++) {
+            if (op != Q_NONE && !match(op, where_col < 0 ? (double)t[r] : where_vals[r], ref))
+                continue;
+            matched++;
+            if (print_rows)
+                fprintf(stdout, "%llu", t[r]);
+            for (s = 0; s < nsel; s++) {
+                v = vals[s][r];
+                if (print_rows)
+                    fprintf(stdout, "\t%g", v);
+                if (isnan(v))
+                    continue;
+                n[s]++;
+                sum[s] += v;
+                lo[s] = v < lo[s] ? v : lo[s];
+                hi[s] = v > hi[s] ? v : hi[s];
+            }
+            if (print_rows)
+                fprintf(stdout, "\n");
+        }
+    }
+    if (err) {
+        fprintf(stderr, "Could not read chunk %u of \"%s\".\n", k, path);
+        goto _FREE;
+    }
+
+    if (!print_rows) {
+        fprintf(stdout, "column\tcount\tmin\tmean\tmax\n");
+        for (s = 0; s < nsel; s++) {
+            if (n[s])
+                fprintf(stdout, "%s\t%llu\t%g\t%g\t%g\n", f.cols[sel[s]].name, n[s], lo[s], sum[s] / n[s], hi[s]);
+            else
+                fprintf(stdout, "%s\t0\tnan\tnan\tnan\n", f.cols[sel[s]].name);
+        }
+    }
+    fprintf(stderr, "query: %llu rows matched, %llu of %u chunks read\n", matched, scanned_chunks, f.trailer.chunks);
+
+_FREE:
+    if (vals)
+        for (s = 0; s < nsel; s++)
+            free(vals[s]);
+    free(vals);
+    free(sel);
+    free(sum);
+    free(lo);
+    free(hi);
+    free(n);
+    free(t);
+    free(where_vals);
+    columnar_close(&f);
+    return err;
+}
@@ -0,0 +1,78 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef COLUMNAR_H
+#define COLUMNAR_H
+
+#define COLUMNAR_MAGIC          "RMNGCOL1"
+#define COLUMNAR_END_MAGIC      "RMNGCOLE"
+#define COLUMNAR_VERSION        1
+#define COLUMNAR_NAME_LEN       48
+#define COLUMNAR_DEFAULT_CHUNK  4096    //Rows buffered before a chunk is written
+#define COLUMNAR_TIME           "time_ns"
+
+/**
+ * File layout, native endianness:
+ *   header   columnar_header
+ *   chunks   the time column (u64 ns) then every value column (float) in
+ *            column order, rows values each
+ *   footer   columnar_column[columns], columnar_chunk[chunks] and
+ *            columnar_range[chunks][columns], the min/max of every column
+ *            in every chunk
+ *   trailer  columnar_trailer, crc covers the footer
+ * Column c of a chunk starts at offset + rows * 8 + c * rows * 4.
+ **/
+typedef struct {
+    char magic[8];
+    unsigned int format;
+    unsigned int pm_table_version;
+    unsigned int columns;           //Value columns, the time column is not counted
+    unsigned int chunk_rows;
+} columnar_header;
+
+typedef struct {
+    char name[COLUMNAR_NAME_LEN];   //As in pm_tables.h, or the derived metric name
+    float min, max;                 //NAN when the column holds no value
+    unsigned long long count;       //Values that are not NAN
+} columnar_column;
+
+typedef struct {
+    unsigned long long offset;
+    unsigned long long t_min, t_max;
+    unsigned int rows;
+    unsigned int reserved;
+} columnar_chunk;
+
+typedef struct {
+    float min, max;
+} columnar_range;
+
+typedef struct {
+    unsigned long long footer_offset;
+    unsigned long long rows;
+    unsigned int chunks;
+    unsigned int crc;
+    char magic[8];
+} columnar_trailer;
+
+int columnar_convert(const char *in, unsigned int version, const char *out, int chunk_rows);
+int columnar_query(const char *path, const char *select, const char *where, int print_rows);
+
+#endif
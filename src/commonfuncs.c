@@ -34,6 +34,9 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/select.h>    
+#ifdef __SSE4_2__
+#include <nmmintrin.h>
+#endif
 #include "commonfuncs.h"
 
 void print_line(const char* label, const char* value_format, ...) {
@@ -78,6 +81,48 @@ int msleep(long msec)
     return res;
 }
 
+/* get_time_ns(): Monotonic clock in nanoseconds, for measuring intervals. */
+unsigned long long get_time_ns()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* crc32c(): CRC-32C (Castagnoli) of buf, pass 0 to start or the previous result to continue. */
+unsigned int crc32c(unsigned int crc, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+#ifdef __SSE4_2__
+    unsigned long long c = ~crc & 0xffffffffU, v;
+
+    for (; len >= sizeof(v); p += sizeof(v), len -= sizeof(v)) {
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+    }
+    crc = (unsigned int)c;
+    while (len--)
+        crc = _mm_crc32_u8(crc, *p++);
+    return ~crc;
+#else
+    static unsigned int table[256];
+    unsigned int i, k, r;
+
+    if (!table[1]) {
+        for (i = 0; i < 256; i++) {
+            for (r = i, k = 0; k < 8; k++)
+                r = (r >> 1) ^ (0x82F63B78U & -(r & 1));
+            table[i] = r;
+        }
+    }
+    crc = ~crc;
+    while (len--)
+        crc = table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+#endif
+}
+
 unsigned int count_set_bits(unsigned int v) {
     unsigned int result = 0;
 
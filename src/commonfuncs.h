@@ -24,8 +24,12 @@
 #ifndef COMMONFUNCS_H
 #define COMMONFUNCS_H
 
+#include <stddef.h>
+
 unsigned int count_set_bits(unsigned int v);
 int msleep(long msec);
+unsigned long long get_time_ns();
+unsigned int crc32c(unsigned int crc, const void *buf, size_t len);
 void append_u32_to_str(char* buffer, unsigned int val);
 void reset_terminal_mode();
 void set_conio_terminal_mode();
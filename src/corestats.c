@@ -0,0 +1,221 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Per-core aggregation shared by the screen and the export.
+ *
+ * The per-core PM table fields are gathered into flat arrays, missing
+ * fields read as 0, and the disable map becomes a lane mask. All the
+ * reductions then run in one pass, 8 cores per step with AVX2, 4 with SSE
+ * or one at a time without either. The derived metrics decide what goes
+ * in between, like the average voltage the CC6 weighting is based on.
+ **/
+
+#include <string.h>
+#include <math.h>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+#include "corestats.h"
+
+const char* core_stats_kernel() {
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(__SSE2__)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+#if defined(__AVX2__)
+static float hmax8(__m256 v) {
+    __m128 m = _mm_max_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+static float hsum8(__m256 v) {
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#elif defined(__SSE2__)
+static float hmax4(__m128 m) {
+    m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+    m = _mm_max_ss(m, _mm_shuffle_ps(m, m, 1));
+    return _mm_cvtss_f32(m);
+}
+
+static float hsum4(__m128 s) {
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+#endif
+
+//Sum of a field over the enabled cores divided by their number
+float core_lanes_mean(const core_lanes *l, const float *field) {
+    int i = 0;
+#if defined(__AVX2__)
+    __m256 acc = _mm256_setzero_ps();
+
+    for (; i < l->lanes; i += 8)
+        acc = _mm256_add_ps(acc, _mm256_and_ps(_mm256_load_ps(&field[i]), _mm256_load_ps((const float *)&l->mask[i])));
+    return l->enabled ? hsum8(acc) / l->enabled : NAN;
+#elif defined(__SSE2__)
+    __m128 acc = _mm_setzero_ps();
+
+    for (; i < l->lanes; i += 4)
+        acc = _mm_add_ps(acc, _mm_and_ps(_mm_load_ps(&field[i]), _mm_load_ps((const float *)&l->mask[i])));
+    return l->enabled ? hsum4(acc) / l->enabled : NAN;
+#else
+    float acc = 0;
+
+    for (; i < l->lanes; i++)
+        if (l->mask[i]) acc += field[i];
+    return l->enabled ? acc / l->enabled : NAN;
+#endif
+}
+
+void core_stats_reduce(const core_lanes *l, float avg, core_stats *cs) {
+    int i = 0, n = l->lanes;
+
+#if defined(__AVX2__)
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.f), sleep_v = _mm256_set1_ps(0.2f);
+    const __m256 pct = _mm256_set1_ps(0.01f), mhz = _mm256_set1_ps(1000.f), vavg = _mm256_set1_ps(avg);
+    __m256 pf = zero, pt = zero, pv = zero, sv = zero, sp = zero, su = zero, sc = zero;
+    //The CC6 weighting needs a sane average, otherwise the raw voltage is kept
+    const __m256 use_avg = avg < 2 ? _mm256_castsi256_ps(_mm256_set1_epi32(-1)) : zero;
+
+    for (; i < n; i += 8) {
+        __m256 m = _mm256_load_ps((const float *)&l->mask[i]);
+        __m256 cc6 = _mm256_load_ps(&l->cc6[i]);
+        __m256 s = _mm256_mul_ps(cc6, pct);
+        __m256 weighted = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(one, s), vavg), _mm256_mul_ps(sleep_v, s));
+        __m256 adj = _mm256_and_ps(_mm256_cmp_ps(s, zero, _CMP_GT_OQ), use_avg);
+        __m256 v = _mm256_blendv_ps(_mm256_load_ps(&l->volt[i]), weighted, adj);
+
+        _mm256_store_ps(&cs->voltage[i], v);
+        //Second operand wins on NaN, a NaN field never becomes a peak
+        pf = _mm256_max_ps(_mm256_and_ps(_mm256_mul_ps(_mm256_load_ps(&l->freq[i]), mhz), m), pf);
+        pt = _mm256_max_ps(_mm256_and_ps(_mm256_load_ps(&l->temp[i]), m), pt);
+        pv = _mm256_max_ps(_mm256_and_ps(v, m), pv);
+        sv = _mm256_add_ps(sv, _mm256_and_ps(v, m));
+        sp = _mm256_add_ps(sp, _mm256_and_ps(_mm256_load_ps(&l->power[i]), m));
+        su = _mm256_add_ps(su, _mm256_and_ps(_mm256_load_ps(&l->c0[i]), m));
+        sc = _mm256_add_ps(sc, _mm256_and_ps(cc6, m));
+    }
+    cs->peak_frequency = hmax8(pf);
+    cs->peak_temp = hmax8(pt);
+    cs->peak_voltage = hmax8(pv);
+    cs->total_voltage = hsum8(sv);
+    cs->total_power = hsum8(sp);
+    cs->total_usage = hsum8(su);
+    cs->total_cc6 = hsum8(sc);
+#elif defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1.f), sleep_v = _mm_set1_ps(0.2f);
+    const __m128 pct = _mm_set1_ps(0.01f), mhz = _mm_set1_ps(1000.f), vavg = _mm_set1_ps(avg);
+    __m128 pf = zero, pt = zero, pv = zero, sv = zero, sp = zero, su = zero, sc = zero;
+    const __m128 use_avg = avg < 2 ? _mm_castsi128_ps(_mm_set1_epi32(-1)) : zero;
+
+    for (; i < n; i += 4) {
+        __m128 m = _mm_load_ps((const float *)&l->mask[i]);
+        __m128 cc6 = _mm_load_ps(&l->cc6[i]);
+        __m128 s = _mm_mul_ps(cc6, pct);
+        __m128 weighted = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(one, s), vavg), _mm_mul_ps(sleep_v, s));
+        __m128 adj = _mm_and_ps(_mm_cmpgt_ps(s, zero), use_avg);
+        __m128 v = _mm_or_ps(_mm_and_ps(adj, weighted), _mm_andnot_ps(adj, _mm_load_ps(&l->volt[i])));
+
+        _mm_store_ps(&cs->voltage[i], v);
+        pf = _mm_max_ps(_mm_and_ps(_mm_mul_ps(_mm_load_ps(&l->freq[i]), mhz), m), pf);
+        pt = _mm_max_ps(_mm_and_ps(_mm_load_ps(&l->temp[i]), m), pt);
+        pv = _mm_max_ps(_mm_and_ps(v, m), pv);
+        sv = _mm_add_ps(sv, _mm_and_ps(v, m));
+        sp = _mm_add_ps(sp, _mm_and_ps(_mm_load_ps(&l->power[i]), m));
+        su = _mm_add_ps(su, _mm_and_ps(_mm_load_ps(&l->c0[i]), m));
+        sc = _mm_add_ps(sc, _mm_and_ps(cc6, m));
+    }
+    cs->peak_frequency = hmax4(pf);
+    cs->peak_temp = hmax4(pt);
+    cs->peak_voltage = hmax4(pv);
+    cs->total_voltage = hsum4(sv);
+    cs->total_power = hsum4(sp);
+    cs->total_usage = hsum4(su);
+    cs->total_cc6 = hsum4(sc);
+#else
+    float v, s, f;
+
+    cs->peak_frequency = cs->peak_temp = cs->peak_voltage = 0;
+    cs->total_voltage = cs->total_power = cs->total_usage = cs->total_cc6 = 0;
+    for (; i < n; i++) {
+        s = l->cc6[i] / 100.f;
+        v = (s > 0 && avg < 2) ? ((1.0 - s) * avg) + (0.2 * s) : l->volt[i];
+        cs->voltage[i] = v;
+        if (!l->mask[i])
+            continue;
+        f = l->freq[i] * 1000.f;
+        if (cs->peak_frequency < f) cs->peak_frequency = f;
+        if (cs->peak_temp < l->temp[i]) cs->peak_temp = l->temp[i];
+        if (cs->peak_voltage < v) cs->peak_voltage = v;
+        cs->total_voltage += v;
+        cs->total_power += l->power[i];
+        cs->total_usage += l->c0[i];
+        cs->total_cc6 += l->cc6[i];
+    }
+#endif
+}
+
+//Per-core fields are consecutive in every known table, a single copy then does
+static void gather(float **src, int n, float *dst) {
+    int i;
+
+    if (src[0] && src[n - 1] == src[0] + (n - 1)) {
+        memcpy(dst, src[0], n * sizeof(float));
+        return;
+    }
+    for (i = 0; i < n; i++)
+        dst[i] = src[i] ? *src[i] : 0;
+}
+
+void core_lanes_gather(pm_table *pmt, unsigned int disable_map, core_lanes *l) {
+    int i, n = pmt->max_cores, lanes = (n + 7) & ~7;
+
+    l->count = n;
+    l->lanes = lanes;
+    l->enabled = 0;
+    l->has_voltage = n > 0 && pmt->CORE_VOLTAGE[0];
+    if (n > 0) {
+        gather(pmt->CORE_FREQEFF, n, l->freq);
+        gather(pmt->CORE_VOLTAGE, n, l->volt);
+        gather(pmt->CORE_TEMP, n, l->temp);
+        gather(pmt->CORE_POWER, n, l->power);
+        gather(pmt->CORE_C0, n, l->c0);
+        gather(pmt->CORE_CC6, n, l->cc6);
+    }
+    for (i = n; i < lanes; i++)
+        l->freq[i] = l->volt[i] = l->temp[i] = l->power[i] = l->c0[i] = l->cc6[i] = 0;
+    for (i = 0; i < lanes; i++) {
+        l->mask[i] = i < n && !((disable_map >> i) & 0x01) ? ~0u : 0;
+        if (l->mask[i]) l->enabled++;
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef CORESTATS_H
+#define CORESTATS_H
+
+#include "pm_tables.h"
+
+#define CORE_STATS_CAP  ((PMT_MAX_NUM_CORES + 7) & ~7)  //Whole AVX vectors
+
+//Per-core fields as flat arrays, padding lanes are disabled cores with all fields 0
+typedef struct {
+    float freq[CORE_STATS_CAP] __attribute__((aligned(32)));
+    float volt[CORE_STATS_CAP] __attribute__((aligned(32)));
+    float temp[CORE_STATS_CAP] __attribute__((aligned(32)));
+    float power[CORE_STATS_CAP] __attribute__((aligned(32)));
+    float c0[CORE_STATS_CAP] __attribute__((aligned(32)));
+    float cc6[CORE_STATS_CAP] __attribute__((aligned(32)));
+    unsigned int mask[CORE_STATS_CAP] __attribute__((aligned(32)));  //All ones for enabled cores
+    int count;              //Cores in the PM table
+    int lanes;              //count rounded up to whole vectors
+    int enabled;
+    int has_voltage;        //The table has per-core voltages
+} core_lanes;
+
+typedef struct {
+    float peak_frequency;   //MHz
+    float peak_temp;
+    float peak_voltage;
+    float total_voltage;
+    float total_power;
+    float total_usage;      //Sum of C0 %
+    float total_cc6;
+    float voltage[CORE_STATS_CAP] __attribute__((aligned(32)));  //CC6 weighted voltage of every core
+} core_stats;
+
+void core_lanes_gather(pm_table *pmt, unsigned int disable_map, core_lanes *l);
+float core_lanes_mean(const core_lanes *l, const float *field);
+void core_stats_reduce(const core_lanes *l, float average_voltage, core_stats *cs);
+const char* core_stats_kernel();
+
+#endif
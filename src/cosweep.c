@@ -0,0 +1,223 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Per core Curve Optimizer sweep.
+ *
+ * Every selected core is walked down from its current CO count in fixed
+ * steps. At each step the verify kernel runs pinned to the core for the step
+ * time while the PM table is sampled; any result that differs from the
+ * reference computed at start marks the step as failed. The core is put back
+ * to the last count that passed before moving on and the counts found are
+ * written as a profile file.
+ * A hard hang or reboot can't be caught here, run the sweep on a node that
+ * can afford it.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "setinfo.h"
+#include "cosweep.h"
+
+extern smu_obj_t obj;
+extern const int TEST_INT;
+
+static volatile sig_atomic_t sweep_running = 0;
+static volatile sig_atomic_t sweep_stop = 0;
+
+void cosweep_defaults(cosweep_config *cfg) {
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->load.kernel = LOAD_KERNEL_VERIFY;
+    cfg->load.duty = 100;
+    cfg->load.phase_s = 30;
+    cfg->step = 5;
+    cfg->min_count = -30;
+    cfg->out_path = NULL;
+}
+
+int cosweep_active() {
+    return sweep_running;
+}
+
+void cosweep_stop() {
+    sweep_stop = 1;
+}
+
+//Runs the verify kernel on one core, returns 1 if it produced a wrong result
+static int sweep_step(pm_table *pmt, unsigned char *pm_buf, cosweep_config *cfg, int cpu,
+                      int core, loadgen_core_stats *stats) {
+    loadgen_core_stats phase[PMT_MAX_NUM_CORES];
+
+    if (loadgen_sample_phase(pmt, pm_buf, &cfg->load, &cpu, 1, phase) != 0)
+        return -1;
+    *stats = phase[core];
+    return loadgen_errors() ? 1 : 0;
+}
+
+static int sweep_core(pm_table *pmt, unsigned char *pm_buf, system_info *sysinfo,
+                      cosweep_config *cfg, cosweep_result *res) {
+    loadgen_core_stats stats;
+    int cpu, count, ret, logical;
+
+    //res->core is the physical PM table index, the CO commands take the logical one
+    res->first_fail = COSWEEP_NONE;
+    if ((logical = core_logical_index(sysinfo, res->core)) < 0) {
+        fprintf(stderr, "co-sweep: core %d is disabled, skipped\n", res->core);
+        return 1;
+    }
+    res->start = res->stable = op_get_cocount(sysinfo, logical, 1);
+    if (res->start <= -100) {
+        fprintf(stderr, "co-sweep: can't read the CO count of core %d\n", res->core);
+        return -1;
+    }
+    if ((cpu = loadgen_cpu_for_core(sysinfo, res->core, 0)) < 0) {
+        fprintf(stderr, "co-sweep: no CPU found for core %d\n", res->core);
+        return -1;
+    }
+
+    fprintf(stderr, "co-sweep: core %d baseline at %+d\n", res->core, res->start);
+    ret = sweep_step(pmt, pm_buf, cfg, cpu, res->core, &res->base);
+    if (ret < 0)
+        return -1;
+    res->best = res->base;
+    if (ret) {
+        //Already unstable, nothing below can be trusted
+        res->first_fail = res->start;
+        fprintf(stderr, "co-sweep: core %d fails at its current count, skipped\n", res->core);
+        return 0;
+    }
+
+    for (count = res->start - cfg->step; count >= cfg->min_count && !sweep_stop; count -= cfg->step) {
+        if (op_set_cocount(sysinfo, logical, count) <= -100) {
+            fprintf(stderr, "co-sweep: failed to set core %d to %+d\n", res->core, count);
+            break;
+        }
+        ret = sweep_step(pmt, pm_buf, cfg, cpu, res->core, &stats);
+        if (ret < 0)
+            break;
+        fprintf(stderr, "co-sweep: core %d at %+d %s, %.0f MHz %.4f V %.2f W\n", res->core, count,
+            ret ? "FAILED" : "ok", stats.freq, stats.voltage, stats.power);
+        if (ret) {
+            res->first_fail = count;
+            break;
+        }
+        res->stable = count;
+        res->best = stats;
+    }
+
+    if (op_set_cocount(sysinfo, logical, res->stable) <= -100) {
+        fprintf(stderr, "co-sweep: failed to restore core %d to %+d\n", res->core, res->stable);
+        return -1;
+    }
+    return 0;
+}
+
+int cosweep_write_profile(const char *path, cosweep_config *cfg, cosweep_result *results, int count) {
+    char date[32];
+    time_t now = time(NULL);
+    FILE *fp;
+    int i;
+
+    if (!(fp = fopen(path, "w"))) {
+        fprintf(stderr, "co-sweep: can't write profile %s\n", path);
+        return -1;
+    }
+
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&now));
+    fprintf(fp, "# ryzen_monitor_ng profile\n");
+    fprintf(fp, "# CO sweep on %s, step %d down to %+d, %d s per step\n\n", date, cfg->step, cfg->min_count, cfg->load.phase_s);
+    for (i = 0; i < count; i++) {
+        if (results[i].first_fail == COSWEEP_NONE)
+            fprintf(fp, "# core %d: start %+d, no failure down to %+d", results[i].core, results[i].start, results[i].stable);
+        else
+            fprintf(fp, "# core %d: start %+d, first failure at %+d", results[i].core, results[i].start, results[i].first_fail);
+        fprintf(fp, ", %.0f -> %.0f MHz, %.4f -> %.4f V, %.2f -> %.2f W\n",
+            results[i].base.freq, results[i].best.freq, results[i].base.voltage, results[i].best.voltage,
+            results[i].base.power, results[i].best.power);
+        fprintf(fp, "co.%d = %d\n", results[i].core, results[i].stable);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int cosweep_run(pm_table *pmt, system_info *sysinfo, cosweep_config *cfg) {
+    cosweep_result results[PMT_MAX_NUM_CORES];
+    unsigned char *pm_buf;
+    double eff_base, eff_best;
+    int i, ret, done = 0, err = 0;
+
+    if (op_set_cocount(sysinfo, 0, TEST_INT) != 0 || op_get_cocount(sysinfo, 0, 1) <= -100) {
+        fprintf(stderr, "co-sweep: Curve Optimizer control is not available on this processor.\n");
+        return -100;
+    }
+    if (cfg->step < 1) cfg->step = 1;
+    if (cfg->min_count < -30) cfg->min_count = -30;
+
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(obj.pm_table_version, pmt, pm_buf)) {
+        fprintf(stderr, "co-sweep: the PM table is needed to sample the cores\n");
+        free(pm_buf);
+        return -1;
+    }
+
+    sweep_stop = 0;
+    sweep_running = 1;
+
+    for (i = 0; i < cfg->load.core_count && !sweep_stop; i++) {
+        memset(&results[done], 0, sizeof(cosweep_result));
+        results[done].core = cfg->load.cores[i];
+        ret = sweep_core(pmt, pm_buf, sysinfo, cfg, &results[done]);
+        if (ret < 0) {
+            err = -2;
+            break;
+        }
+        if (ret == 0)
+            done++;
+    }
+
+    sweep_running = 0;
+    loadgen_stop();
+
+    if (done) {
+        fprintf(stdout, "Core | start stable  fail |  MHz base  stable |  V base  stable |  MHz/W base  stable\n");
+        for (i = 0; i < done; i++) {
+            eff_base = results[i].base.power > 0 ? results[i].base.freq / results[i].base.power : 0;
+            eff_best = results[i].best.power > 0 ? results[i].best.freq / results[i].best.power : 0;
+            fprintf(stdout, "%4d | %+5d %+6d ", results[i].core, results[i].start, results[i].stable);
+            if (results[i].first_fail == COSWEEP_NONE)
+                fprintf(stdout, "    - |");
+            else
+                fprintf(stdout, "%+5d |", results[i].first_fail);
+            fprintf(stdout, " %9.0f %7.0f | %7.4f %7.4f | %11.1f %7.1f\n",
+                results[i].base.freq, results[i].best.freq, results[i].base.voltage, results[i].best.voltage,
+                eff_base, eff_best);
+        }
+        if (cfg->out_path && cosweep_write_profile(cfg->out_path, cfg, results, done) == 0)
+            fprintf(stdout, "Profile written to %s\n", cfg->out_path);
+    }
+
+    free(pm_buf);
+    return err;
+}
@@ -0,0 +1,51 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef COSWEEP_H
+#define COSWEEP_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+#include "loadgen.h"
+
+#define COSWEEP_NONE    -1000   //No failing step was found
+
+typedef struct {
+    loadgen_config load;    //Cores to sweep, phase_s is the time spent at every step
+    int step;               //CO counts between steps
+    int min_count;          //Lowest count tried
+    const char *out_path;   //Profile file, NULL to skip it
+} cosweep_config;
+
+typedef struct {
+    int core;
+    int start;              //Count found before the sweep
+    int stable;             //Lowest count that passed, applied when the sweep ends
+    int first_fail;         //Highest count that failed or COSWEEP_NONE
+    loadgen_core_stats base;
+    loadgen_core_stats best;
+} cosweep_result;
+
+void cosweep_defaults(cosweep_config *cfg);
+int cosweep_active();
+void cosweep_stop();
+int cosweep_run(pm_table *pmt, system_info *sysinfo, cosweep_config *cfg);
+int cosweep_write_profile(const char *path, cosweep_config *cfg, cosweep_result *results, int count);
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Derived metrics, evaluated once per sample.
+ *
+ * Every metric is declared with the metrics it reads, derived_init() puts
+ * them in dependency order once and derived_update() evaluates them in that
+ * order after each PM table read. The screen and the export only read the
+ * results, so both show the same numbers. derived_compute() does the same
+ * into a caller's buffer for the library.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include "derived.h"
+
+#define pmta(elem) ((pmt->elem)?(*pmt->elem):NAN)
+#define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
+
+#define DEP(id) (1ULL << (id))
+
+typedef float (*derived_eval)(pm_table *pmt, system_info *sysinfo, derived_values *d);
+
+typedef struct {
+    enum derived_id id;
+    const char *name;
+    unsigned long long deps;
+    derived_eval eval;
+} derived_def;
+
+static derived_values values;
+static int order[DERIVED_COUNT];
+static int order_ready = 0;
+static pthread_once_t order_once = PTHREAD_ONCE_INIT;
+
+static float eval_core_lanes(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    core_lanes_gather(pmt, sysinfo->core_disable_map, &d->lanes);
+    return NAN;
+}
+
+static float eval_avg_voltage(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float v = d->lanes.has_voltage ? core_lanes_mean(&d->lanes, d->lanes.volt) : NAN;
+
+    return v > 0 ? v : pmta(CPU_TELEMETRY_VOLTAGE);
+}
+
+//Sleeping cores sit at about 0.2 V, package C6 pulls the average down by that share
+static float eval_eff_voltage(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float pc6;
+
+    if (!pmt->PC6)
+        return d->v[DERIVED_AVG_VOLTAGE];
+    pc6 = pmta(PC6) / 100.f;
+    return (d->v[DERIVED_AVG_VOLTAGE] - (0.2 * pc6)) / (1.0 - pc6);
+}
+
+static float eval_core_stats(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    core_stats_reduce(&d->lanes, d->v[DERIVED_EFF_VOLTAGE], &d->cores);
+    return NAN;
+}
+
+static float eval_cores_avg_voltage(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    return d->lanes.enabled ? d->cores.total_voltage / d->lanes.enabled : 0;
+}
+
+static float eval_cores_avg_cc6(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    return d->lanes.enabled ? d->cores.total_cc6 / d->lanes.enabled : 0;
+}
+
+static float eval_peak_voltage_smu(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float svi2 = pmta0(CPU_TELEMETRY_VOLTAGE), peak = d->cores.peak_voltage;
+
+    return svi2 < peak ? peak : svi2 < 2 ? svi2 : peak;
+}
+
+static float eval_thm(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float thm = 0;
+    int i;
+
+    if (pmt->THM_VALUE)
+        return pmta(THM_VALUE);
+    for (i = 0; i < pmt->max_cores; i++) {
+        if (pmta0(THM_VALUE_CORES[i]) > thm)
+            thm = pmta0(THM_VALUE_CORES[i]);
+    }
+    return thm;
+}
+
+static float eval_edc(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float edc = d->lanes.enabled ? pmta0(EDC_VALUE) * (d->cores.total_usage / d->lanes.enabled / 100) : 0;
+
+    return edc < pmta0(TDC_VALUE) ? pmta0(TDC_VALUE) : edc;
+}
+
+static float eval_l3_logic_power(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float sum = 0;
+    int i;
+
+    for (i = 0; i < pmt->max_l3; i++)
+        sum += pmta0(L3_LOGIC_POWER[i]);
+    return sum;
+}
+
+static float eval_l3_vddm_power(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    float sum = 0;
+    int i;
+
+    for (i = 0; i < pmt->max_l3; i++)
+        sum += pmta0(L3_VDDM_POWER[i]);
+    return sum;
+}
+
+//Higher than PPT and SOCKET_POWER, confirmed by measuring the actual current draw on the mainboard
+static float eval_thermal_output(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    if (pmt->powersum_unclear)
+        return NAN;
+    return d->cores.total_power + pmta0(VDDCR_SOC_POWER) + pmta0(GMI2_VDDG_POWER)
+        + d->v[DERIVED_L3_LOGIC_POWER] + d->v[DERIVED_L3_VDDM_POWER]
+        + pmta0(VDDIO_MEM_POWER) + pmta0(IOD_VDDIO_MEM_POWER) + pmta0(DDR_VDDP_POWER) + pmta0(VDD18_POWER);
+}
+
+//Declaration order doesn't matter, derived_init() sorts by dependencies
+static const derived_def defs[DERIVED_COUNT] = {
+    { DERIVED_THERMAL_OUTPUT,   "thermal_output",   DEP(DERIVED_CORE_STATS) | DEP(DERIVED_L3_LOGIC_POWER) | DEP(DERIVED_L3_VDDM_POWER), eval_thermal_output },
+    { DERIVED_EDC,              "edc",              DEP(DERIVED_CORE_STATS), eval_edc },
+    { DERIVED_PEAK_VOLTAGE_SMU, "peak_voltage_smu", DEP(DERIVED_CORE_STATS), eval_peak_voltage_smu },
+    { DERIVED_CORES_AVG_VOLTAGE,"cores_avg_voltage",DEP(DERIVED_CORE_STATS), eval_cores_avg_voltage },
+    { DERIVED_CORES_AVG_CC6,    "cores_avg_cc6",    DEP(DERIVED_CORE_STATS), eval_cores_avg_cc6 },
+    { DERIVED_CORE_STATS,       "core_stats",       DEP(DERIVED_CORE_LANES) | DEP(DERIVED_EFF_VOLTAGE), eval_core_stats },
+    { DERIVED_EFF_VOLTAGE,      "eff_voltage",      DEP(DERIVED_AVG_VOLTAGE), eval_eff_voltage },
+    { DERIVED_AVG_VOLTAGE,      "avg_voltage",      DEP(DERIVED_CORE_LANES), eval_avg_voltage },
+    { DERIVED_CORE_LANES,       "core_lanes",       0, eval_core_lanes },
+    { DERIVED_THM,              "thm",              0, eval_thm },
+    { DERIVED_L3_LOGIC_POWER,   "l3_logic_power",   0, eval_l3_logic_power },
+    { DERIVED_L3_VDDM_POWER,    "l3_vddm_power",    0, eval_l3_vddm_power },
+};
+
+//Topological order of defs, -1 on a missing metric or a dependency cycle
+int derived_init() {
+    unsigned long long done = 0;
+    int i, count = 0, progress = 1;
+
+    while (count < DERIVED_COUNT && progress) {
+        progress = 0;
+        for (i = 0; i < DERIVED_COUNT; i++) {
+            if ((done & DEP(defs[i].id)) || (defs[i].deps & ~done))
+                continue;
+            order[count++] = i;
+            done |= DEP(defs[i].id);
+            progress = 1;
+        }
+    }
+    if (count < DERIVED_COUNT) {
+        fprintf(stderr, "derived: dependency cycle between derived metrics\n");
+        return -1;
+    }
+    order_ready = 1;
+    return 0;
+}
+
+static void derived_init_once() {
+    derived_init();
+}
+
+//Reentrant, the caller owns d
+void derived_compute(pm_table *pmt, system_info *sysinfo, derived_values *d) {
+    const derived_def *def;
+    int i;
+
+    pthread_once(&order_once, derived_init_once);
+    if (!order_ready)
+        return;
+    for (i = 0; i < DERIVED_COUNT; i++) {
+        def = &defs[order[i]];
+        d->v[def->id] = def->eval(pmt, sysinfo, d);
+    }
+}
+
+void derived_update(pm_table *pmt, system_info *sysinfo) {
+    derived_compute(pmt, sysinfo, &values);
+}
+
+const derived_values* derived_get() {
+    return &values;
+}
+
+const char* derived_name(enum derived_id id) {
+    int i;
+
+    for (i = 0; i < DERIVED_COUNT; i++) {
+        if (defs[i].id == id)
+            return defs[i].name;
+    }
+    return "unknown";
+}
@@ -0,0 +1,56 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef DERIVED_H
+#define DERIVED_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+#include "corestats.h"
+
+enum derived_id {
+    DERIVED_CORE_LANES,         //Per-core fields gathered for the kernels, no value
+    DERIVED_AVG_VOLTAGE,        //Mean voltage of the enabled cores, SVI2 telemetry without one
+    DERIVED_EFF_VOLTAGE,        //Average voltage with the package C6 residency taken out
+    DERIVED_CORE_STATS,         //CC6 weighted core voltages, peaks and sums, no value
+    DERIVED_CORES_AVG_VOLTAGE,  //Mean of the CC6 weighted core voltages
+    DERIVED_CORES_AVG_CC6,
+    DERIVED_PEAK_VOLTAGE_SMU,   //Peak core voltage checked against the SVI2 telemetry
+    DERIVED_THM,                //THM_VALUE, hottest core without one
+    DERIVED_EDC,                //EDC_VALUE scaled by the mean C0 residency, at least TDC
+    DERIVED_L3_LOGIC_POWER,
+    DERIVED_L3_VDDM_POWER,
+    DERIVED_THERMAL_OUTPUT,     //Sum of every power rail the package draws
+    DERIVED_COUNT
+};
+
+typedef struct {
+    core_lanes lanes;
+    core_stats cores;
+    float v[DERIVED_COUNT];
+} derived_values;
+
+int derived_init();
+void derived_compute(pm_table *pmt, system_info *sysinfo, derived_values *d);
+void derived_update(pm_table *pmt, system_info *sysinfo);
+const derived_values* derived_get();
+const char* derived_name(enum derived_id id);
+
+#endif
@@ -0,0 +1,297 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * PM table layout discovery.
+ *
+ * The raw table is sampled while the load generator walks through an idle
+ * phase, one phase per core with only that core loaded and an all-cores
+ * phase. Every offset gets its statistics in a single streaming pass:
+ * Welford mean and variance, min/max, co-moments with the number of loaded
+ * cores and with the loaded core index, plus the mean of each phase.
+ * The result is printed as a pm_tables.c skeleton with the same legend.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "loadgen.h"
+#include "discover.h"
+
+extern smu_obj_t obj;
+
+#define DISCOVER_SIGNIFICANT_R  0.7     //Correlation to call an offset load dependent
+
+typedef struct {
+    int core;           //PM table core loaded alone, -1 for idle and all cores
+    int cpu_count;
+    int cpus[LOADGEN_MAX_WORKERS];
+} discover_phase;
+
+typedef struct {
+    unsigned long n;
+    double mean, m2;
+} discover_x;
+
+static void x_update(discover_x *x, double v, double *dx) {
+    x->n++;
+    *dx = v - x->mean;
+    x->mean += *dx / x->n;
+    x->m2 += *dx * (v - x->mean);
+}
+
+static double correlation(double c, double m2x, double m2y) {
+    if (m2x <= 0 || m2y <= 0)
+        return 0;
+    return c / sqrt(m2x * m2y);
+}
+
+static int build_phases(system_info *sysinfo, int cores, discover_phase *phases) {
+    int i, cpu, count = 0;
+    discover_phase *all;
+
+    memset(&phases[count], 0, sizeof(discover_phase));
+    phases[count++].core = -1;
+
+    for (i = 0; i < cores; i++) {
+        if ((sysinfo->core_disable_map >> i) & 1)
+            continue;
+        cpu = loadgen_cpu_for_core(sysinfo, i, 0);
+        if (cpu < 0)
+            continue;
+        memset(&phases[count], 0, sizeof(discover_phase));
+        phases[count].core = i;
+        phases[count].cpus[0] = cpu;
+        phases[count].cpu_count = 1;
+        count++;
+    }
+
+    all = &phases[count];
+    memset(all, 0, sizeof(discover_phase));
+    all->core = -1;
+    for (i = 0; i < cores; i++) {
+        if ((sysinfo->core_disable_map >> i) & 1)
+            continue;
+        cpu = loadgen_cpu_for_core(sysinfo, i, 0);
+        if (cpu >= 0 && all->cpu_count < LOADGEN_MAX_WORKERS)
+            all->cpus[all->cpu_count++] = cpu;
+    }
+    if (all->cpu_count > 1)
+        count++;
+
+    return count;
+}
+
+int discover_run(system_info *sysinfo, int phase_s, int rate_hz) {
+    int count, cores, phase_count, p, i, k, run_start, run_len, peak;
+    unsigned long long phase_ns, settle_ns, interval_ns, start, next, now;
+    discover_phase *phases;
+    discover_stat *stats, *s;
+    discover_x x_load, x_core;
+    double *phase_sum, *phase_mean, dx, dxc, y, dy, best, other, r_load, r_core;
+    unsigned long *phase_n;
+    unsigned char *pm_buf;
+    int *peak_core;
+    float *table;
+    char cls[48];
+    int err = 0;
+
+    if (!smu_pm_tables_supported(&obj)) {
+        fprintf(stderr, "PM Tables are not supported for this processor.\n");
+        return -1;
+    }
+    if (phase_s < 1) phase_s = 1;
+    if (rate_hz < 1) rate_hz = 1;
+    if (rate_hz > 1000) rate_hz = 1000;
+
+    //Phases are per physical core, the table version may be unknown so the fuses decide
+    cores = physical_core_count(NULL, sysinfo);
+    count = obj.pm_table_size / sizeof(float);
+    phases = calloc(cores + 2, sizeof(discover_phase));
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    stats = calloc(count, sizeof(discover_stat));
+    peak_core = calloc(count, sizeof(int));
+    phase_n = calloc(cores + 2, sizeof(unsigned long));
+    phase_sum = calloc((size_t)(cores + 2) * count, sizeof(double));
+    phase_mean = calloc(cores + 2, sizeof(double));
+    if (!phases || !pm_buf || !stats || !peak_core || !phase_n || !phase_sum || !phase_mean) {
+        fprintf(stderr, "discover: out of memory\n");
+        err = -1;
+        goto _FREE;
+    }
+    table = (float *)pm_buf;
+
+    phase_count = build_phases(sysinfo, cores, phases);
+    memset(&x_load, 0, sizeof(x_load));
+    memset(&x_core, 0, sizeof(x_core));
+    for (i = 0; i < count; i++) {
+        stats[i].min = INFINITY;
+        stats[i].max = -INFINITY;
+    }
+
+    phase_ns = phase_s * 1000000000ULL;
+    settle_ns = phase_ns / 5;
+    interval_ns = 1000000000ULL / rate_hz;
+
+    for (p = 0; p < phase_count; p++) {
+        if (phases[p].cpu_count && loadgen_start(phases[p].cpus, phases[p].cpu_count, LOAD_KERNEL_SCALAR, 100) != 0) {
+            err = -2;
+            break;
+        }
+        if (phases[p].core >= 0)
+            fprintf(stderr, "discover: phase %d/%d, core %d loaded (CPU %d)\n", p + 1, phase_count, phases[p].core, phases[p].cpus[0]);
+        else
+            fprintf(stderr, "discover: phase %d/%d, %d cores loaded\n", p + 1, phase_count, phases[p].cpu_count);
+
+        start = next = get_time_ns();
+        while ((now = get_time_ns()) - start < phase_ns) {
+            next += interval_ns;
+            if (now - start >= settle_ns && smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+                x_update(&x_load, phases[p].cpu_count, &dx);
+                if (phases[p].core >= 0)
+                    x_update(&x_core, phases[p].core, &dxc);
+                phase_n[p]++;
+
+                for (i = 0; i < count; i++) {
+                    s = &stats[i];
+                    y = table[i];
+                    if (!isfinite(y)) {
+                        s->nonfinite++;
+                        y = 0;
+                    }
+                    if (y < s->min) s->min = y;
+                    if (y > s->max) s->max = y;
+
+                    s->n++;
+                    dy = y - s->mean;
+                    s->mean += dy / s->n;
+                    s->m2 += dy * (y - s->mean);
+                    s->c_load += dx * (y - s->mean);
+
+                    if (phases[p].core >= 0) {
+                        s->n_core++;
+                        dy = y - s->mean_core;
+                        s->mean_core += dy / s->n_core;
+                        s->m2_core += dy * (y - s->mean_core);
+                        s->c_core += dxc * (y - s->mean_core);
+                    }
+                    phase_sum[(size_t)p * count + i] += y;
+                }
+            }
+            now = get_time_ns();
+            if (next > now)
+                msleep((next - now) / 1000000);
+        }
+        loadgen_stop();
+    }
+
+    if (err || x_load.n == 0) {
+        if (!err) fprintf(stderr, "discover: no PM table samples collected\n");
+        err = err ? err : -3;
+        goto _FREE;
+    }
+
+    fprintf(stdout, "    // Discovered layout for PM table 0x%06x, %lu samples over %d phases, %d offsets\n",
+        obj.pm_table_version, x_load.n, phase_count, count);
+    fprintf(stdout, "    /* Legend for notes in comments:\n");
+    fprintf(stdout, "     * s = static. Does not change unter load.\n");
+    fprintf(stdout, "     * z = always zero\n");
+    fprintf(stdout, "     * c = changes under load. Don't know if the value is correct.\n");
+    fprintf(stdout, "     * L = follows the number of loaded cores (|r| >= %.1f)\n", DISCOVER_SIGNIFICANT_R);
+    fprintf(stdout, "     * kN = peaks when only core N is loaded\n");
+    fprintf(stdout, "     */\n\n");
+
+    for (i = 0; i < count; i++) {
+        s = &stats[i];
+        peak_core[i] = -1;
+
+        //Single core phase with the highest mean against the mean of the others
+        best = -INFINITY;
+        peak = -1;
+        for (p = 0; p < phase_count; p++) {
+            phase_mean[p] = phase_n[p] ? phase_sum[(size_t)p * count + i] / phase_n[p] : 0;
+            if (phases[p].core >= 0 && phase_n[p] && phase_mean[p] > best) {
+                best = phase_mean[p];
+                peak = p;
+            }
+        }
+        if (peak >= 0 && s->max > s->min) {
+            other = 0;
+            k = 0;
+            for (p = 0; p < phase_count; p++) {
+                if (p != peak && phases[p].core >= 0 && phase_n[p]) {
+                    other += phase_mean[p];
+                    k++;
+                }
+            }
+            other = k ? other / k : best;
+            if (k && best - other > 0.25 * (s->max - s->min))
+                peak_core[i] = phases[peak].core;
+        }
+
+        r_load = correlation(s->c_load, x_load.m2, s->m2);
+        r_core = correlation(s->c_core, x_core.m2, s->m2_core);
+
+        if (s->max == 0 && s->min == 0)
+            snprintf(cls, sizeof(cls), "z");
+        else if (s->max == s->min)
+            snprintf(cls, sizeof(cls), "s");
+        else
+            snprintf(cls, sizeof(cls), "c%s", fabs(r_load) >= DISCOVER_SIGNIFICANT_R ? " L" : "");
+        if (peak_core[i] >= 0)
+            snprintf(cls + strlen(cls), sizeof(cls) - strlen(cls), " k%d", peak_core[i]);
+
+        fprintf(stdout, "    pmt->UNKNOWN_%04d              = pm_element(%3d); //%-8s mean=%.4f sd=%.4f min=%.4f max=%.4f r_load=%+.2f r_core=%+.2f%s\n",
+            i, i, cls, s->mean, s->n > 1 ? sqrt(s->m2 / (s->n - 1)) : 0, s->min, s->max, r_load, r_core,
+            s->nonfinite ? " nonfinite" : "");
+    }
+
+    //Consecutive offsets peaking on consecutive cores are per core array candidates
+    fprintf(stdout, "\n    // Per core array candidates:\n");
+    k = 0;
+    for (i = 0; i < count; i = run_start + run_len) {
+        run_start = i;
+        run_len = 1;
+        if (peak_core[i] >= 0) {
+            while (i + run_len < count && peak_core[i + run_len] == peak_core[i + run_len - 1] + 1)
+                run_len++;
+            if (run_len >= 2) {
+                fprintf(stdout, "    //   offsets %d-%d, cores %d-%d\n",
+                    run_start, run_start + run_len - 1, peak_core[run_start], peak_core[run_start + run_len - 1]);
+                k++;
+            }
+        }
+    }
+    if (!k)
+        fprintf(stdout, "    //   none found\n");
+
+_FREE:
+    loadgen_stop();
+    free(phases);
+    free(pm_buf);
+    free(stats);
+    free(peak_core);
+    free(phase_n);
+    free(phase_sum);
+    free(phase_mean);
+    return err;
+}
@@ -0,0 +1,38 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef DISCOVER_H
+#define DISCOVER_H
+
+#include "readinfo.h"
+
+typedef struct {
+    unsigned long n;
+    double mean, m2;        //Welford running mean and sum of squared deviations
+    double min, max;
+    double c_load;          //Co-moment with the number of loaded cores
+    unsigned long n_core;   //Samples taken while a single core was loaded
+    double mean_core, m2_core;
+    double c_core;          //Co-moment with the loaded core index
+    unsigned long nonfinite;
+} discover_stat;
+
+int discover_run(system_info *sysinfo, int phase_s, int rate_hz);
+
+#endif
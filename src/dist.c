@@ -0,0 +1,299 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Per-core distribution summaries.
+ *
+ * Frequency, voltage, temperature and power of every enabled core go into
+ * a DDSketch for the quantiles and into fixed buckets for the time spent in
+ * each range, both sized at compile time. A sample costs one log per value
+ * and a bucket increment, the sketch window only moves when a value falls
+ * outside of it. Summaries cover a window of --dist-window seconds: the
+ * export prints a window once when it closes, the monitor pane shows the
+ * last closed one.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "commonfuncs.h"
+#include "derived.h"
+#include "dist.h"
+
+typedef struct {
+    const char *name;
+    const char *unit;
+    float width;            //Of a residency bucket, the first one starts at 0
+} dist_metric_def;
+
+static const dist_metric_def metric_defs[DIST_METRICS] = {
+    { "frequency",   "MHz", 100.f },
+    { "voltage",     "V",   0.025f },
+    { "temperature", "C",   2.f },
+    { "power",       "W",   0.5f },
+};
+
+static int enabled = 0;
+static unsigned long long window_ns = 60000000000ULL;
+static dist_window windows[2];
+static int cur = 0;
+static int have_last = 0;
+static int export_pending = 0;
+static unsigned long long last_ns = 0;
+static int have_prev = 0;
+static float log_gamma;
+
+void dist_enable(int enable, unsigned int window_s) {
+    if (window_s)
+        window_ns = window_s * 1000000000ULL;
+    if (enable && !enabled) {
+        log_gamma = logf((1 + DIST_ALPHA) / (1 - DIST_ALPHA));
+        memset(windows, 0, sizeof(windows));
+        cur = have_last = export_pending = 0;
+        have_prev = 0;
+    }
+    enabled = enable;
+}
+
+int dist_enabled() {
+    return enabled;
+}
+
+static void sketch_shift(dist_sketch *s, int offset) {
+    unsigned int old[DIST_SKETCH_BINS];
+    int i, j;
+
+    memcpy(old, s->bins, sizeof(old));
+    memset(s->bins, 0, sizeof(s->bins));
+    for (i = 0; i < DIST_SKETCH_BINS; i++) {
+        if (!old[i])
+            continue;
+        j = s->offset + i - offset;
+        s->bins[j < 0 ? 0 : j] += old[i];
+    }
+    s->offset = offset;
+}
+
+static void sketch_add(dist_sketch *s, float x) {
+    int k;
+
+    if (!s->n || x < s->min) s->min = x;
+    if (!s->n || x > s->max) s->max = x;
+    s->n++;
+    s->sum += x;
+
+    if (!(x > DIST_MIN_VALUE)) {
+        s->zero++;
+        return;
+    }
+    k = (int)ceilf(logf(x) / log_gamma);
+    if (!s->used) {
+        s->offset = k - DIST_SKETCH_BINS / 2;
+        s->hi = k;
+        s->used = 1;
+    }
+    if (k >= s->offset + DIST_SKETCH_BINS)
+        sketch_shift(s, k - DIST_SKETCH_BINS + 1);
+    else if (k < s->offset && s->hi - k < DIST_SKETCH_BINS)
+        sketch_shift(s, k);
+    if (k > s->hi) s->hi = k;
+    //Still below the window, goes to the lowest bin
+    if (k < s->offset) k = s->offset;
+    s->bins[k - s->offset]++;
+}
+
+float dist_quantile(const dist_sketch *s, float q) {
+    unsigned int rank, seen;
+    float v;
+    int i;
+
+    if (!s->n)
+        return NAN;
+    rank = (unsigned int)(q * (s->n - 1));
+    seen = s->zero;
+    if (rank < seen)
+        return s->min;
+    for (i = 0; i < DIST_SKETCH_BINS; i++) {
+        seen += s->bins[i];
+        if (rank < seen)
+            break;
+    }
+    //Midpoint of the bucket keeps the relative error within alpha
+    v = expf((s->offset + i) * log_gamma) * 2.f / (1.f + expf(log_gamma));
+    return v < s->min ? s->min : v > s->max ? s->max : v;
+}
+
+float dist_bucket_low(enum dist_metric metric, int bucket) {
+    return bucket * metric_defs[metric].width;
+}
+
+static void summary_add(dist_summary *sm, enum dist_metric metric, float x, unsigned long long dt) {
+    int b = (int)(x / metric_defs[metric].width);
+
+    sketch_add(&sm->sketch, x);
+    if (b < 0) b = 0;
+    if (b >= DIST_BUCKETS) b = DIST_BUCKETS - 1;
+    sm->residency_ns[b] += dt;
+}
+
+//PM table values are averages since the previous read, so the interval before a sample is credited to it
+void dist_update(unsigned long long now_ns) {
+    const derived_values *d = derived_get();
+    const core_lanes *l = &d->lanes;
+    unsigned long long dt;
+    dist_window *w;
+    int i;
+
+    if (!enabled)
+        return;
+
+    w = &windows[cur];
+    if (!w->samples) {
+        w->start_ns = now_ns;
+    } else if (now_ns - w->start_ns >= window_ns) {
+        w->end_ns = now_ns;
+        cur ^= 1;
+        w = &windows[cur];
+        memset(w, 0, sizeof(dist_window));
+        w->start_ns = now_ns;
+        have_last = export_pending = 1;
+    }
+    dt = have_prev && now_ns > last_ns ? now_ns - last_ns : 0;
+    have_prev = 1;
+    last_ns = now_ns;
+
+    for (i = 0; i < l->count && i < PMT_MAX_NUM_CORES; i++) {
+        if (!l->mask[i])
+            continue;
+        summary_add(&w->m[i][DIST_FREQUENCY], DIST_FREQUENCY, l->freq[i] * 1000.f, dt);
+        summary_add(&w->m[i][DIST_VOLTAGE], DIST_VOLTAGE, d->cores.voltage[i], dt);
+        summary_add(&w->m[i][DIST_TEMPERATURE], DIST_TEMPERATURE, l->temp[i], dt);
+        summary_add(&w->m[i][DIST_POWER], DIST_POWER, l->power[i], dt);
+        w->core_mask |= 1U << i;
+    }
+    w->samples++;
+    w->end_ns = now_ns;
+}
+
+const dist_window* dist_current() {
+    return &windows[cur];
+}
+
+const dist_window* dist_last() {
+    return have_last ? &windows[cur ^ 1] : NULL;
+}
+
+static int bucket_decimals(enum dist_metric metric) {
+    return metric == DIST_VOLTAGE ? 3 : metric == DIST_POWER ? 1 : 0;
+}
+
+//Prints a window once, when it closes
+void draw_dist_export(const char *hostname, int number_disabled, unsigned int disable_map) {
+    const dist_window *w = dist_last();
+    const dist_summary *sm;
+    const dist_sketch *s;
+    int i, m, b, fields, core_number = 0;
+
+    if (!enabled || !w || !export_pending)
+        return;
+    export_pending = 0;
+
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if ((disable_map >> i) & 1) {
+            if (number_disabled) core_number++;
+            continue;
+        }
+        if (!((w->core_mask >> i) & 1)) {
+            core_number++;
+            continue;
+        }
+        for (m = 0; m < DIST_METRICS; m++) {
+            sm = &w->m[i][m];
+            s = &sm->sketch;
+            fprintf(stdout,
+                "ryzen_monitor_ng_dist,host=%s,name=Core%d,metric=%s window_s=%.1f,n=%ui,min=%.3f,p50=%.3f,p90=%.3f,p99=%.3f,max=%.3f,mean=%.3f\n",
+                hostname, core_number, metric_defs[m].name,
+                (w->end_ns - w->start_ns) / 1e9, s->n, s->min, dist_quantile(s, 0.5f), dist_quantile(s, 0.9f),
+                dist_quantile(s, 0.99f), s->max, s->n ? s->sum / s->n : 0);
+
+            //Seconds per bucket, fields are named by the lower bound, empty buckets are left out
+            fprintf(stdout, "ryzen_monitor_ng_residency,host=%s,name=Core%d,metric=%s,unit=%s ",
+                hostname, core_number, metric_defs[m].name, metric_defs[m].unit);
+            for (b = 0, fields = 0; b < DIST_BUCKETS; b++) {
+                if (!sm->residency_ns[b])
+                    continue;
+                fprintf(stdout, "%sb%.*f=%.3f", fields++ ? "," : "", bucket_decimals(m), dist_bucket_low(m, b), sm->residency_ns[b] / 1e9);
+            }
+            if (!fields)
+                fprintf(stdout, "total=0");
+            fprintf(stdout, "\n");
+        }
+        core_number++;
+    }
+}
+
+//Bucket with the most time in it
+static int residency_mode(const dist_summary *sm, double *share) {
+    unsigned long long total = 0;
+    int b, best = 0;
+
+    for (b = 0; b < DIST_BUCKETS; b++) {
+        total += sm->residency_ns[b];
+        if (sm->residency_ns[b] > sm->residency_ns[best])
+            best = b;
+    }
+    *share = total ? sm->residency_ns[best] * 100.0 / total : 0;
+    return best;
+}
+
+void draw_dist_pane(unsigned int disable_map) {
+    const dist_window *w = dist_last();
+    const dist_sketch *f, *t;
+    double share;
+    char label[48];
+    int i, b, core_number = 0;
+
+    if (!enabled)
+        return;
+
+    fprintf(stdout, "╭── Distributions ──────────────────────────────┬────────────────────────────────────────────────╮\n");
+    if (w)
+        snprintf(label, sizeof(label), "Last %.0f s window", (w->end_ns - w->start_ns) / 1e9);
+    else {
+        w = dist_current();
+        snprintf(label, sizeof(label), "First window, %.0f of %.0f s", (w->end_ns - w->start_ns) / 1e9, window_ns / 1e9);
+    }
+    print_line(label, "  MHz p50/p99 |   C p50/p99 |  Most time at");
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if ((disable_map >> i) & 1)
+            continue;
+        if ((w->core_mask >> i) & 1) {
+            f = &w->m[i][DIST_FREQUENCY].sketch;
+            t = &w->m[i][DIST_TEMPERATURE].sketch;
+            b = residency_mode(&w->m[i][DIST_FREQUENCY], &share);
+            snprintf(label, sizeof(label), "Core %d", core_number);
+            print_line(label, "%6.0f/%6.0f | %5.1f/%5.1f | %4.0f MHz %3.0f%%",
+                dist_quantile(f, 0.5f), dist_quantile(f, 0.99f),
+                dist_quantile(t, 0.5f), dist_quantile(t, 0.99f),
+                dist_bucket_low(DIST_FREQUENCY, b), share);
+        }
+        core_number++;
+    }
+    fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
+}
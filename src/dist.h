@@ -0,0 +1,73 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef DIST_H
+#define DIST_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define DIST_SKETCH_BINS    256     //Log buckets per sketch, about 166x between lowest and highest at 1%
+#define DIST_ALPHA          0.01    //Relative accuracy of the quantiles
+#define DIST_MIN_VALUE      1e-3f   //Values at or below count as 0
+#define DIST_BUCKETS        64      //Fixed residency buckets per metric
+
+enum dist_metric {
+    DIST_FREQUENCY,         //MHz, effective
+    DIST_VOLTAGE,           //V, CC6 weighted
+    DIST_TEMPERATURE,       //C
+    DIST_POWER,             //W
+    DIST_METRICS
+};
+
+//DDSketch with a fixed number of bins, the lowest ones collapse when the range grows
+typedef struct {
+    unsigned int bins[DIST_SKETCH_BINS];
+    int offset;             //Key of bins[0]
+    int hi;                 //Highest key seen
+    unsigned int zero;
+    unsigned int n;
+    int used;
+    float min, max;
+    double sum;
+} dist_sketch;
+
+typedef struct {
+    dist_sketch sketch;                             //Over samples
+    unsigned long long residency_ns[DIST_BUCKETS];  //Over time
+} dist_summary;
+
+typedef struct {
+    dist_summary m[PMT_MAX_NUM_CORES][DIST_METRICS];
+    unsigned int core_mask;     //Cores with samples
+    unsigned int samples;
+    unsigned long long start_ns, end_ns;
+} dist_window;
+
+void dist_enable(int enable, unsigned int window_s);
+int dist_enabled();
+void dist_update(unsigned long long now_ns);
+float dist_quantile(const dist_sketch *s, float q);
+float dist_bucket_low(enum dist_metric metric, int bucket);
+const dist_window* dist_current();
+const dist_window* dist_last();
+void draw_dist_export(const char *hostname, int number_disabled, unsigned int disable_map);
+void draw_dist_pane(unsigned int disable_map);
+
+#endif
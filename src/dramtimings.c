@@ -0,0 +1,319 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * DRAM timings decoder, driven by the UMC register map below.
+ *
+ * Every UMC instance sits DRAM_CHANNEL_STRIDE apart in the SMN address space.
+ * A channel is reported when it's not fused off and at least one chip select
+ * is enabled, all the registers of a channel are read in a single batch.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <libsmu.h>
+#include "setinfo.h"
+#include "dramtimings.h"
+
+#define UMC_CS_BASE_0       0x50000
+#define UMC_CS_BASE_1       0x50008
+#define UMC_CONFIG          0x50DF0     //Bit 19 set when the channel is disabled
+
+struct dram_field;
+typedef double (*dram_decode_fn)(const dram_channel *ch, const struct dram_field *f);
+
+typedef struct dram_field {
+    const char *name;       //Text output
+    const char *key;        //JSON and Influx output
+    unsigned int reg;
+    unsigned int shift;
+    unsigned int mask;
+    enum dram_unit unit;
+    dram_decode_fn decode;  //NULL for a plain bit field
+} dram_field;
+
+//Registers read for every channel, fields can only reference these
+static const unsigned int dram_regs[] = {
+    UMC_CS_BASE_0, UMC_CS_BASE_1, UMC_CONFIG,
+    0x50050, 0x50058, 0x500D0, 0x500D4,
+    0x50200, 0x50204, 0x50208, 0x5020C, 0x50210, 0x50214, 0x50218,
+    0x50220, 0x50224, 0x50228, 0x50254, 0x50260, 0x50264,
+};
+#define DRAM_REG_COUNT ((int)(sizeof(dram_regs) / sizeof(dram_regs[0])))
+
+static unsigned int dram_reg(const dram_channel *ch, unsigned int reg) {
+    int i;
+
+    for (i = 0; i < DRAM_REG_COUNT; i++)
+        if (dram_regs[i] == reg)
+            return ch->regs[i];
+    return 0;
+}
+
+static double decode_bits(const dram_channel *ch, const dram_field *f) {
+    return (dram_reg(ch, f->reg) >> f->shift) & f->mask;
+}
+
+static double decode_memclk(const dram_channel *ch, const dram_field *f) {
+    return decode_bits(ch, f) / 3.f * 100.f;
+}
+
+//Swap is disabled when both address hash registers hold the default mapping
+static double decode_bgs(const dram_channel *ch, const dram_field *f) {
+    unsigned int v1 = dram_reg(ch, 0x50050), v2 = dram_reg(ch, 0x50058);
+    return !(v1 == v2 && v1 == 0x87654321);
+}
+
+static double decode_bgs_alt(const dram_channel *ch, const dram_field *f) {
+    return ((dram_reg(ch, 0x500D0) >> 4 & 0x7F) != 0 || (dram_reg(ch, 0x500D4) >> 4 & 0x7F) != 0);
+}
+
+static const dram_field dram_fields[] = {
+    { "BankGroupSwap",    "bgs",      0x50050,  0, 0x1,   DRAM_UNIT_BOOL,    decode_bgs },
+    { "BankGroupSwapAlt", "bgs_alt",  0x500D0,  0, 0x1,   DRAM_UNIT_BOOL,    decode_bgs_alt },
+    { "Memory Clock",     "memclk",   0x50200,  0, 0x7f,  DRAM_UNIT_MHZ,     decode_memclk },
+    { "GDM",              "gdm",      0x50200, 11, 0x1,   DRAM_UNIT_BOOL,    NULL },
+    { "CR",               "cr",       0x50200, 10, 0x1,   DRAM_UNIT_CMDRATE, NULL },
+    { "Tcl",              "tcl",      0x50204,  0, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Tras",             "tras",     0x50204,  8, 0x7f,  DRAM_UNIT_CLK,     NULL },
+    { "Trcdrd",           "trcdrd",   0x50204, 16, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Trcdwr",           "trcdwr",   0x50204, 24, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Trc",              "trc",      0x50208,  0, 0xff,  DRAM_UNIT_CLK,     NULL },
+    { "Trp",              "trp",      0x50208, 16, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Trrds",            "trrds",    0x5020C,  0, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Trrdl",            "trrdl",    0x5020C,  8, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Trtp",             "trtp",     0x5020C, 24, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Tfaw",             "tfaw",     0x50210,  0, 0xff,  DRAM_UNIT_CLK,     NULL },
+    { "Tcwl",             "tcwl",     0x50214,  0, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Twtrs",            "twtrs",    0x50214,  8, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Twtrl",            "twtrl",    0x50214, 16, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Twr",              "twr",      0x50218,  0, 0xff,  DRAM_UNIT_CLK,     NULL },
+    { "Trdrddd",          "trdrddd",  0x50220,  0, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Trdrdsd",          "trdrdsd",  0x50220,  8, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Trdrdsc",          "trdrdsc",  0x50220, 16, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Trdrdscl",         "trdrdscl", 0x50220, 24, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Twrwrdd",          "twrwrdd",  0x50224,  0, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Twrwrsd",          "twrwrsd",  0x50224,  8, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Twrwrsc",          "twrwrsc",  0x50224, 16, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Twrwrscl",         "twrwrscl", 0x50224, 24, 0x3f,  DRAM_UNIT_CLK,     NULL },
+    { "Twrrd",            "twrrd",    0x50228,  0, 0xf,   DRAM_UNIT_CLK,     NULL },
+    { "Trdwr",            "trdwr",    0x50228,  8, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Tcke",             "tcke",     0x50254, 24, 0x1f,  DRAM_UNIT_CLK,     NULL },
+    { "Trfc",             "trfc",     0x50260,  0, 0x3ff, DRAM_UNIT_CLK,     NULL },
+    { "Trfc2",            "trfc2",    0x50260, 11, 0x3ff, DRAM_UNIT_CLK,     NULL },
+    { "Trfc4",            "trfc4",    0x50260, 22, 0x3ff, DRAM_UNIT_CLK,     NULL },
+};
+#define DRAM_FIELD_COUNT ((int)(sizeof(dram_fields) / sizeof(dram_fields[0])))
+
+static int read_channel(smu_obj_t *smu, dram_channel *ch, int umc) {
+    unsigned int addrs[DRAM_MAX_REGS];
+    int i;
+
+    for (i = 0; i < DRAM_REG_COUNT; i++)
+        addrs[i] = dram_regs[i] + umc * DRAM_CHANNEL_STRIDE;
+
+    if (smu_read_smn_addr_batch(smu, addrs, ch->regs, DRAM_REG_COUNT) != SMU_Return_OK)
+        return -1;
+
+    ch->umc = umc;
+
+    //Trfc is in the second register when the first still holds the reset default
+    for (i = 0; i < DRAM_REG_COUNT; i++) {
+        if (dram_regs[i] == 0x50260 && ch->regs[i] == 0x21060138 && ch->regs[i] != ch->regs[i+1])
+            ch->regs[i] = ch->regs[i+1];
+    }
+
+    for (i = 0; i < DRAM_FIELD_COUNT; i++)
+        ch->values[i] = dram_fields[i].decode ? dram_fields[i].decode(ch, &dram_fields[i])
+                                              : decode_bits(ch, &dram_fields[i]);
+    return 0;
+}
+
+int dram_timings_read(dram_timings *t) {
+    unsigned int addrs[3], regs[3];
+    smu_obj_t *smu = smu_target();
+    int umc;
+
+    memset(t, 0, sizeof(*t));
+    if (!smu)
+        return -1;
+
+    for (umc = 0; umc < DRAM_MAX_CHANNELS; umc++) {
+        addrs[0] = UMC_CONFIG + umc * DRAM_CHANNEL_STRIDE;
+        addrs[1] = UMC_CS_BASE_0 + umc * DRAM_CHANNEL_STRIDE;
+        addrs[2] = UMC_CS_BASE_1 + umc * DRAM_CHANNEL_STRIDE;
+        if (smu_read_smn_addr_batch(smu, addrs, regs, 3) != SMU_Return_OK) {
+            if (umc == 0)
+                return -1;
+            break;
+        }
+        if ((regs[0] >> 19 & 1) || !((regs[1] | regs[2]) & 1))
+            continue;
+        if (read_channel(smu, &t->channels[t->channel_count], umc) != 0)
+            return -1;
+        t->channel_count++;
+    }
+
+    //Nothing looked populated, fall back to the first channel with a configured clock
+    if (t->channel_count == 0) {
+        if (smu_read_smn_addr(smu, 0x50200, &regs[0]) != SMU_Return_OK)
+            return -1;
+        if (read_channel(smu, &t->channels[0], regs[0] == 0x300 ? 1 : 0) != 0)
+            return -1;
+        t->channel_count = 1;
+    }
+
+    return 0;
+}
+
+int dram_timings_field_count() {
+    return DRAM_FIELD_COUNT;
+}
+
+//Key of a decoded field as in the JSON and Influx output, NULL past the last one
+const char* dram_timings_field_key(int i) {
+    return i >= 0 && i < DRAM_FIELD_COUNT ? dram_fields[i].key : NULL;
+}
+
+static void format_text(char *buf, size_t len, const dram_field *f, double v) {
+    switch (f->unit) {
+        case DRAM_UNIT_MHZ:     snprintf(buf, len, "%.0f MHz", v); break;
+        case DRAM_UNIT_BOOL:    snprintf(buf, len, "%s", v != 0 ? "Enabled" : "Disabled"); break;
+        case DRAM_UNIT_CMDRATE: snprintf(buf, len, "%s", v != 0 ? "2T" : "1T"); break;
+        default:                snprintf(buf, len, "%d", (int)v); break;
+    }
+}
+
+static void format_json(char *buf, size_t len, const dram_field *f, double v) {
+    switch (f->unit) {
+        case DRAM_UNIT_MHZ:     snprintf(buf, len, "%.0f", v); break;
+        case DRAM_UNIT_BOOL:    snprintf(buf, len, "%s", v != 0 ? "true" : "false"); break;
+        case DRAM_UNIT_CMDRATE: snprintf(buf, len, "\"%s\"", v != 0 ? "2T" : "1T"); break;
+        default:                snprintf(buf, len, "%d", (int)v); break;
+    }
+}
+
+static void format_influx(char *buf, size_t len, const dram_field *f, double v) {
+    switch (f->unit) {
+        case DRAM_UNIT_MHZ:     snprintf(buf, len, "%.0f", v); break;
+        case DRAM_UNIT_CMDRATE: snprintf(buf, len, "\"%s\"", v != 0 ? "2T" : "1T"); break;
+        default:                snprintf(buf, len, "%di", (int)v); break;
+    }
+}
+
+//Prints the fields set in mask, all of them if mask is NULL
+static void print_channel(const dram_channel *ch, const char *mask, enum dram_format format,
+                          const char *hostname, int multi, int first) {
+    char value[32];
+    int i, n = 0;
+
+    switch (format) {
+        case DRAM_FORMAT_JSON:
+            fprintf(stdout, "%s{\"umc\":%d", first ? "" : ",", ch->umc);
+            for (i = 0; i < DRAM_FIELD_COUNT; i++) {
+                if (mask && !mask[i]) continue;
+                format_json(value, sizeof(value), &dram_fields[i], ch->values[i]);
+                fprintf(stdout, ",\"%s\":%s", dram_fields[i].key, value);
+            }
+            fprintf(stdout, "}");
+            break;
+        case DRAM_FORMAT_INFLUX:
+            fprintf(stdout, "ryzen_monitor_ng,host=%s,name=DRAM,channel=%d ", hostname, ch->umc);
+            for (i = 0; i < DRAM_FIELD_COUNT; i++) {
+                if (mask && !mask[i]) continue;
+                format_influx(value, sizeof(value), &dram_fields[i], ch->values[i]);
+                fprintf(stdout, "%s%s=%s", n++ ? "," : "", dram_fields[i].key, value);
+            }
+            fprintf(stdout, "\n");
+            break;
+        default:
+            if (multi)
+                fprintf(stdout, "Channel %d:\n", ch->umc);
+            for (i = 0; i < DRAM_FIELD_COUNT; i++) {
+                if (mask && !mask[i]) continue;
+                format_text(value, sizeof(value), &dram_fields[i], ch->values[i]);
+                fprintf(stdout, "%s: %s\n", dram_fields[i].name, value);
+            }
+            break;
+    }
+}
+
+void dram_timings_print(const dram_timings *t, enum dram_format format, const char *hostname) {
+    int i;
+
+    if (format == DRAM_FORMAT_JSON)
+        fprintf(stdout, "{\"channels\":[");
+    for (i = 0; i < t->channel_count; i++)
+        print_channel(&t->channels[i], NULL, format, hostname, t->channel_count > 1, i == 0);
+    if (format == DRAM_FORMAT_JSON)
+        fprintf(stdout, "]}\n");
+}
+
+int dram_timings_print_changes(const dram_timings *prev, const dram_timings *cur, enum dram_format format, const char *hostname) {
+    char mask[DRAM_MAX_FIELDS], from[32], to[32];
+    const dram_channel *p, *c;
+    int i, j, changed, total = 0;
+
+    //Channel layout changed, nothing sensible to compare against
+    if (prev->channel_count != cur->channel_count) {
+        dram_timings_print(cur, format, hostname);
+        return DRAM_FIELD_COUNT * cur->channel_count;
+    }
+
+    for (i = 0; i < cur->channel_count; i++) {
+        p = &prev->channels[i];
+        c = &cur->channels[i];
+        changed = 0;
+        for (j = 0; j < DRAM_FIELD_COUNT; j++) {
+            mask[j] = p->values[j] != c->values[j];
+            changed += mask[j];
+        }
+        if (!changed)
+            continue;
+        total += changed;
+
+        if (format == DRAM_FORMAT_TEXT) {
+            for (j = 0; j < DRAM_FIELD_COUNT; j++) {
+                if (!mask[j]) continue;
+                format_text(from, sizeof(from), &dram_fields[j], p->values[j]);
+                format_text(to, sizeof(to), &dram_fields[j], c->values[j]);
+                fprintf(stdout, "Channel %d %s: %s -> %s\n", c->umc, dram_fields[j].name, from, to);
+            }
+        } else {
+            print_channel(c, mask, format, hostname, 1, 1);
+            if (format == DRAM_FORMAT_JSON)
+                fprintf(stdout, "\n");
+        }
+    }
+
+    return total;
+}
+
+int dram_timings_parse_format(const char *str, enum dram_format *format) {
+    if (!str || !strcmp(str, "text"))
+        *format = DRAM_FORMAT_TEXT;
+    else if (!strcmp(str, "json"))
+        *format = DRAM_FORMAT_JSON;
+    else if (!strcmp(str, "influx"))
+        *format = DRAM_FORMAT_INFLUX;
+    else
+        return -1;
+    return 0;
+}
@@ -0,0 +1,59 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef DRAMTIMINGS_H
+#define DRAMTIMINGS_H
+
+#define DRAM_MAX_CHANNELS       8
+#define DRAM_CHANNEL_STRIDE     0x100000    //SMN distance between UMC instances
+#define DRAM_MAX_REGS           24
+#define DRAM_MAX_FIELDS         48
+
+enum dram_unit {
+    DRAM_UNIT_CLK,      //Memory clock cycles
+    DRAM_UNIT_MHZ,
+    DRAM_UNIT_BOOL,     //Enabled/Disabled
+    DRAM_UNIT_CMDRATE,  //1T/2T
+};
+
+enum dram_format {
+    DRAM_FORMAT_TEXT,
+    DRAM_FORMAT_JSON,
+    DRAM_FORMAT_INFLUX,
+};
+
+typedef struct {
+    int umc;                                //UMC instance number
+    unsigned int regs[DRAM_MAX_REGS];       //Raw registers, same order as the register map
+    double values[DRAM_MAX_FIELDS];         //Decoded fields, same order as the field map
+} dram_channel;
+
+typedef struct {
+    int channel_count;
+    dram_channel channels[DRAM_MAX_CHANNELS];
+} dram_timings;
+
+int dram_timings_read(dram_timings *t);
+int dram_timings_field_count();
+const char* dram_timings_field_key(int i);
+void dram_timings_print(const dram_timings *t, enum dram_format format, const char *hostname);
+int dram_timings_print_changes(const dram_timings *prev, const dram_timings *cur, enum dram_format format, const char *hostname);
+int dram_timings_parse_format(const char *str, enum dram_format *format);
+
+#endif
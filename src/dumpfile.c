@@ -0,0 +1,194 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Self-describing PM table dumps, written by -w and read back by -t and
+ * --replay. The header records what is needed to decode the table without
+ * asking the user: table version and size, SMU firmware, codename, CPUID
+ * family/model and the fused core map. Every snapshot carries a CRC32C so
+ * a damaged copy is refused instead of decoded into nonsense.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <time.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "dumpfile.h"
+
+extern smu_obj_t obj;
+
+//0 for a v2 dump, 1 for a legacy raw dump (rewound), -1 for a damaged header
+int dumpfile_read_header(FILE *fp, dumpfile_header *hdr) {
+    memset(hdr, 0, sizeof(*hdr));
+    if (fread(hdr->magic, sizeof(hdr->magic), 1, fp) != 1 || memcmp(hdr->magic, DUMPFILE_MAGIC, sizeof(hdr->magic))) {
+        rewind(fp);
+        return 1;
+    }
+
+    if (fread((char *)hdr + sizeof(hdr->magic), sizeof(*hdr) - sizeof(hdr->magic), 1, fp) != 1) {
+        fprintf(stderr, "dumpfile: truncated header\n");
+        return -1;
+    }
+    if (hdr->format != DUMPFILE_VERSION || hdr->header_size < sizeof(*hdr)) {
+        fprintf(stderr, "dumpfile: unsupported format %u\n", hdr->format);
+        return -1;
+    }
+    if (crc32c(0, hdr, offsetof(dumpfile_header, crc)) != hdr->crc) {
+        fprintf(stderr, "dumpfile: header checksum mismatch\n");
+        return -1;
+    }
+    //Fields added by newer versions follow the checksum
+    if (hdr->header_size > sizeof(*hdr) && fseek(fp, hdr->header_size, SEEK_SET) != 0)
+        return -1;
+
+    hdr->codename[sizeof(hdr->codename) - 1] = '\0';
+    return 0;
+}
+
+//1 when a snapshot was read, 0 at the end of the file, -1 on a truncated snapshot, -2 on a checksum mismatch
+int dumpfile_read_snapshot(FILE *fp, const dumpfile_header *hdr, unsigned long long *time_ns, unsigned char *table) {
+    dumpfile_snapshot snap;
+
+    if (fread(&snap, sizeof(snap), 1, fp) != 1)
+        return 0;
+    if (snap.table_size != hdr->table_size || fread(table, 1, hdr->table_size, fp) != hdr->table_size)
+        return -1;
+    if (crc32c(0, table, hdr->table_size) != snap.crc)
+        return -2;
+
+    *time_ns = snap.time_ns;
+    return 1;
+}
+
+//The fused core map is more reliable than the guess made from the table
+void dumpfile_apply_sysinfo(const dumpfile_header *hdr, system_info *sysinfo) {
+    sysinfo->codename = hdr->codename;
+    sysinfo->smu_codename = hdr->smu_codename;
+    sysinfo->family = hdr->cpuid_family;
+    sysinfo->model = hdr->cpuid_model;
+    if (hdr->cores && hdr->cores <= sysinfo->cores) {
+        sysinfo->core_disable_map = hdr->core_disable_map;
+        sysinfo->enabled_cores_count = sysinfo->cores - count_set_bits(hdr->core_disable_map & ((1U << sysinfo->cores) - 1));
+    }
+}
+
+void dumpfile_print_header(const dumpfile_header *hdr, const char *path) {
+    time_t created = hdr->created_ns / 1000000000ULL;
+    char when[32], fw[32];
+    struct tm tm;
+
+    if (hdr->smu_version & 0xff000000)
+        snprintf(fw, sizeof(fw), "%u.%u.%u.%u", (hdr->smu_version >> 24) & 0xff, (hdr->smu_version >> 16) & 0xff,
+            (hdr->smu_version >> 8) & 0xff, hdr->smu_version & 0xff);
+    else
+        snprintf(fw, sizeof(fw), "%u.%u.%u", (hdr->smu_version >> 16) & 0xff, (hdr->smu_version >> 8) & 0xff,
+            hdr->smu_version & 0xff);
+    if (!localtime_r(&created, &tm) || !strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm))
+        snprintf(when, sizeof(when), "unknown");
+
+    fprintf(stderr, "\"%s\": PM Table 0x%X, %u bytes, %s (family 0x%X model 0x%X), SMU FW %s, %u cores, disable map 0x%X, taken %s\n",
+        path, hdr->pm_table_version, hdr->table_size, hdr->codename, hdr->cpuid_family, hdr->cpuid_model,
+        fw, hdr->cores, hdr->core_disable_map, when);
+}
+
+//Writes count snapshots interval_ms apart
+int dumpfile_write(const char *path, system_info *sysinfo, int count, int interval_ms) {
+    unsigned long long next, now;
+    dumpfile_header hdr;
+    dumpfile_snapshot snap;
+    unsigned char *pm_buf;
+    struct timespec ts;
+    int n = 0, err = 0;
+    FILE *fp;
+
+    if (!smu_pm_tables_supported(&obj)) {
+        fprintf(stderr, "PM Tables are not supported for this processor.\n");
+        return -1;
+    }
+    if (count < 1)
+        count = 1;
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, DUMPFILE_MAGIC, sizeof(hdr.magic));
+    hdr.format = DUMPFILE_VERSION;
+    hdr.header_size = sizeof(hdr);
+    hdr.pm_table_version = obj.pm_table_version;
+    hdr.table_size = obj.pm_table_size;
+    hdr.smu_version = obj.smu_version;
+    hdr.cpuid_family = sysinfo->family;
+    hdr.cpuid_model = sysinfo->model;
+    hdr.core_disable_map = sysinfo->core_disable_map;
+    hdr.cores = sysinfo->cores;
+    hdr.smu_codename = obj.codename;
+    snprintf(hdr.codename, sizeof(hdr.codename), "%s", smu_codename_to_str(&obj));
+    clock_gettime(CLOCK_REALTIME, &ts);
+    hdr.created_ns = (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+    hdr.crc = crc32c(0, &hdr, offsetof(dumpfile_header, crc));
+
+    if (!(pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char))))
+        return -1;
+    if (!(fp = fopen(path, "wb"))) {
+        fprintf(stderr, "Could not create the dumpfile (\"%s\").\n", path);
+        free(pm_buf);
+        return -4;
+    }
+    if (fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+        fprintf(stderr, "Could not write to the dumpfile (\"%s\").\n", path);
+        err = -4;
+    }
+
+    next = get_time_ns();
+    while (!err && n < count) {
+        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK) {
+            fprintf(stderr, "Could not read the PM table from kernel.\n");
+            err = -4;
+            break;
+        }
+        snap.time_ns = get_time_ns();
+        snap.table_size = obj.pm_table_size;
+        snap.crc = crc32c(0, pm_buf, obj.pm_table_size);
+        if (fwrite(&snap, sizeof(snap), 1, fp) != 1 || fwrite(pm_buf, 1, obj.pm_table_size, fp) != obj.pm_table_size) {
+            fprintf(stderr, "Could not write to the dumpfile (\"%s\").\n", path);
+            err = -4;
+            break;
+        }
+        //Keep what was written so far if the run is interrupted
+        fflush(fp);
+        if (++n < count) {
+            next += interval_ms * 1000000ULL;
+            now = get_time_ns();
+            if (next > now)
+                msleep((next - now) / 1000000);
+        }
+    }
+
+    if (fclose(fp) != 0 && !err) {
+        fprintf(stderr, "Could not write to the dumpfile (\"%s\").\n", path);
+        err = -4;
+    }
+    if (n)
+        fprintf(stdout, "Written %d snapshot%s of PM Table 0x%X (%u bytes) in dumpfile (\"%s\").\n",
+            n, n > 1 ? "s" : "", obj.pm_table_version, obj.pm_table_size, path);
+    free(pm_buf);
+    return err;
+}
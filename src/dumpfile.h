@@ -0,0 +1,69 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef DUMPFILE_H
+#define DUMPFILE_H
+
+#include <stdio.h>
+#include "readinfo.h"
+
+#define DUMPFILE_MAGIC      "RMNGDMP2"
+#define DUMPFILE_VERSION    2
+
+/**
+ * File layout, native endianness:
+ *   header     dumpfile_header, crc covers everything before it
+ *   snapshots  dumpfile_snapshot followed by table_size bytes of raw PM table
+ * Snapshots are appended one after the other, their count is not stored so
+ * a dump cut short keeps everything before the damaged snapshot.
+ * A file without the magic is a legacy dump written by older versions:
+ * a single raw PM table whose version must be given with -f.
+ **/
+typedef struct {
+    char magic[8];
+    unsigned int format;            //DUMPFILE_VERSION
+    unsigned int header_size;       //sizeof(dumpfile_header), newer fields go after crc
+    unsigned int pm_table_version;
+    unsigned int table_size;
+    unsigned int smu_version;       //Raw, as reported by the SMU
+    unsigned int cpuid_family;
+    unsigned int cpuid_model;
+    unsigned int core_disable_map;
+    unsigned int cores;
+    int smu_codename;
+    char codename[32];
+    unsigned long long created_ns;  //CLOCK_REALTIME
+    unsigned int reserved;
+    unsigned int crc;               //CRC32C of the header up to this field
+} dumpfile_header;
+
+typedef struct {
+    unsigned long long time_ns;     //CLOCK_MONOTONIC
+    unsigned int table_size;
+    unsigned int crc;               //CRC32C of the table that follows
+} dumpfile_snapshot;
+
+int dumpfile_read_header(FILE *fp, dumpfile_header *hdr);
+int dumpfile_read_snapshot(FILE *fp, const dumpfile_header *hdr, unsigned long long *time_ns, unsigned char *table);
+void dumpfile_apply_sysinfo(const dumpfile_header *hdr, system_info *sysinfo);
+void dumpfile_print_header(const dumpfile_header *hdr, const char *path);
+int dumpfile_write(const char *path, system_info *sysinfo, int count, int interval_ms);
+
+#endif
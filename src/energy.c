@@ -0,0 +1,562 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Per-cgroup and per-process energy attribution.
+ *
+ * Every sample the on-CPU time of each workload is collected per logical CPU.
+ * The power of a core is split between the workloads that ran on its SMT
+ * siblings, in proportion to their share of the busy time of the core as
+ * reported by /proc/stat. Whatever is left is accounted as unattributed.
+ * SoC and L3 power is split in proportion to the total busy time of the package.
+ *
+ * Only cgroup v1 cpuacct reports the time per CPU. Everywhere else the time of
+ * a task goes to the CPU it ran on last (field 39 of /proc/<tid>/stat), so a
+ * task that migrated within a sample is charged to one CPU only. For cgroup v2
+ * the amount comes from usage_usec in cpu.stat, which counts descendants and
+ * tasks that already exited; the task walk only places it on CPUs, and what
+ * the walk missed is spread over the CPUs by their busy time. A PID workload
+ * has no such total, a thread that starts and exits between two samples is
+ * not charged.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "energy.h"
+
+#define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
+
+#define ENERGY_CGROUP_DEPTH 16  //Descendant cgroups walked below a v2 cgroup
+
+static energy_workload workloads[ENERGY_MAX_WORKLOADS];
+static int workload_count = 0;
+
+static int ncpus = 0;
+static unsigned long long *last_busy_ns = NULL;
+static double *delta_busy_ns = NULL;
+static double unattributed_core_joules = 0, unattributed_uncore_joules = 0;
+static struct timespec last_ts;
+static int primed = 0;
+
+static double ns_per_tick;
+
+static int file_exists(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+//Influx line protocol needs spaces, commas and equal signs escaped in tag values
+static void escape_tag(char *dst, size_t len, const char *src) {
+    size_t j = 0;
+    for (; *src && j + 2 < len; src++) {
+        if (*src == ' ' || *src == ',' || *src == '=')
+            dst[j++] = '\\';
+        dst[j++] = *src;
+    }
+    dst[j] = 0;
+}
+
+static int add_workload(const char *name, enum energy_source source, const char *path) {
+    energy_workload *w;
+
+    if (workload_count >= ENERGY_MAX_WORKLOADS) {
+        fprintf(stderr, "Too many energy workloads, max is %d.\n", ENERGY_MAX_WORKLOADS);
+        return -1;
+    }
+
+    w = &workloads[workload_count];
+    memset(w, 0, sizeof(*w));
+    snprintf(w->name, sizeof(w->name), "%s", name);
+    snprintf(w->path, sizeof(w->path), "%s", path);
+    w->source = source;
+    w->delta_cpu_ns = (double *)calloc(ncpus, sizeof(double));
+    if (source == ENERGY_CGROUP_V1)
+        w->last_cpu_ns = (unsigned long long *)calloc(ncpus, sizeof(unsigned long long));
+
+    workload_count++;
+    return 0;
+}
+
+static int add_cgroup(const char *cgroup) {
+    char path[512];
+    const char *roots[] = { "", "/sys/fs/cgroup/", "/sys/fs/cgroup/unified/", "/sys/fs/cgroup/cpuacct/", "/sys/fs/cgroup/cpu,cpuacct/", NULL };
+    int i;
+
+    for (i = 0; roots[i]; i++) {
+        if (i == 0 && cgroup[0] != '/')
+            continue;
+        if (i > 0 && cgroup[0] == '/' && strncmp(cgroup, "/sys/", 5) == 0)
+            break;
+        snprintf(path, sizeof(path), "%s%s/cpuacct.usage_percpu", roots[i], cgroup);
+        if (file_exists(path)) {
+            snprintf(path, sizeof(path), "%s%s", roots[i], cgroup);
+            return add_workload(cgroup, ENERGY_CGROUP_V1, path);
+        }
+        snprintf(path, sizeof(path), "%s%s/cgroup.threads", roots[i], cgroup);
+        if (file_exists(path)) {
+            snprintf(path, sizeof(path), "%s%s", roots[i], cgroup);
+            return add_workload(cgroup, ENERGY_CGROUP_V2, path);
+        }
+    }
+
+    fprintf(stderr, "Can't find cgroup \"%s\" (cpuacct or cgroup v2).\n", cgroup);
+    return -1;
+}
+
+static int add_pid(const char *pidstr) {
+    char path[512], name[64];
+    char *leftover;
+    long pid = strtol(pidstr, &leftover, 10);
+
+    if (leftover == pidstr || *leftover != '\0' || pid <= 0) {
+        fprintf(stderr, "Invalid PID \"%s\".\n", pidstr);
+        return -1;
+    }
+    snprintf(path, sizeof(path), "/proc/%ld/task", pid);
+    if (!file_exists(path)) {
+        fprintf(stderr, "PID %ld does not exist.\n", pid);
+        return -1;
+    }
+    snprintf(name, sizeof(name), "pid%ld", pid);
+    return add_workload(name, ENERGY_PID, path);
+}
+
+static int add_list(const char *list, int (*add)(const char *)) {
+    char *copy, *tok, *rest;
+    int err = 0;
+
+    if (!list)
+        return 0;
+    copy = strdup(list);
+    for (tok = strtok_r(copy, ",", &rest); tok && !err; tok = strtok_r(NULL, ",", &rest))
+        err = add(tok);
+    free(copy);
+    return err;
+}
+
+//Sum of the non-idle time of every CPU in /proc/stat
+static int read_cpu_busy(unsigned long long *busy_ns) {
+    char line[512];
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    int cpu;
+    FILE *fp = fopen("/proc/stat", "r");
+
+    if (!fp)
+        return -1;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "cpu", 3) != 0 || line[3] < '0' || line[3] > '9')
+            continue;
+        steal = 0;
+        if (sscanf(line, "cpu%d %llu %llu %llu %llu %llu %llu %llu %llu", &cpu,
+                   &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal) < 8)
+            continue;
+        if (cpu >= 0 && cpu < ncpus)
+            busy_ns[cpu] = (unsigned long long)((user + nice + system + irq + softirq + steal) * ns_per_tick);
+    }
+    fclose(fp);
+    return 0;
+}
+
+//A failed read leaves no usage for the period and the next read only sets the baseline,
+//the previous period must not be attributed again
+static int read_percpu_usage(energy_workload *w, int initial) {
+    char path[600];
+    unsigned long long v;
+    int cpu = 0;
+    FILE *fp;
+
+    memset(w->delta_cpu_ns, 0, ncpus * sizeof(double));
+    snprintf(path, sizeof(path), "%s/cpuacct.usage_percpu", w->path);
+    fp = fopen(path, "r");
+    if (!fp) {
+        w->stale = 1;
+        return -1;
+    }
+    initial |= w->stale;
+    while (cpu < ncpus && fscanf(fp, "%llu", &v) == 1) {
+        w->delta_cpu_ns[cpu] = initial || v < w->last_cpu_ns[cpu] ? 0 : (double)(v - w->last_cpu_ns[cpu]);
+        w->last_cpu_ns[cpu] = v;
+        cpu++;
+    }
+    fclose(fp);
+    w->stale = 0;
+    return 0;
+}
+
+//Index of the first task with a tid not below tid
+static int task_lower_bound(energy_workload *w, int tid) {
+    int lo = 0, hi = w->task_count, mid;
+
+    while (lo < hi) {
+        mid = (lo + hi) / 2;
+        if (w->tasks[mid].tid < tid)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+//Runtime and last CPU of a single task from schedstat and stat
+static int read_task(int tid, unsigned long long *runtime, int *cpu) {
+    char path[64], buf[1024], *p;
+    int field;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "/proc/%d/schedstat", tid);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    if (fscanf(fp, "%llu", runtime) != 1) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", tid);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    p = fgets(buf, sizeof(buf), fp);
+    fclose(fp);
+    if (!p || !(p = strrchr(buf, ')')))
+        return -1;
+
+    //The command name can contain anything, fields are counted after it.
+    //Field 3 (state) follows the closing parenthesis, processor is field 39.
+    for (field = 2; field < 39 && p; field++)
+        p = strchr(p + 1, ' ');
+    if (!p)
+        return -1;
+    *cpu = atoi(p + 1);
+    return 0;
+}
+
+static void account_task(energy_workload *w, int tid, int initial) {
+    energy_task *t, *grown;
+    unsigned long long runtime;
+    int cpu, pos, alloc;
+
+    if (read_task(tid, &runtime, &cpu) != 0)
+        return;
+
+    pos = task_lower_bound(w, tid);
+    if (pos == w->task_count || w->tasks[pos].tid != tid) {
+        if (w->task_count >= w->task_alloc) {
+            alloc = w->task_alloc ? w->task_alloc * 2 : 64;
+            grown = (energy_task *)realloc(w->tasks, alloc * sizeof(energy_task));
+            if (!grown)
+                return;
+            w->tasks = grown;
+            w->task_alloc = alloc;
+        }
+        //Inserted in place, the array stays sorted for the lookups
+        memmove(&w->tasks[pos + 1], &w->tasks[pos], (w->task_count - pos) * sizeof(energy_task));
+        w->task_count++;
+        t = &w->tasks[pos];
+        t->tid = tid;
+        t->seen = 0;
+        //A thread can't join a process, so a new one started after the last sample and all of
+        //its runtime is new. A task in a cgroup may have migrated in with a long history, its
+        //runtime is the baseline and cpu.stat accounts for the rest.
+        t->runtime_ns = initial || w->source != ENERGY_PID ? runtime : 0;
+    } else {
+        t = &w->tasks[pos];
+    }
+
+    if (!initial && runtime > t->runtime_ns && cpu >= 0 && cpu < ncpus)
+        w->delta_cpu_ns[cpu] += (double)(runtime - t->runtime_ns);
+    t->runtime_ns = runtime;
+    t->seen = 1;
+}
+
+//cgroup.threads only lists the threads of the cgroup itself, the descendants are walked too
+static int read_cgroup_threads(energy_workload *w, const char *cgroup, int initial, int depth) {
+    char path[PATH_MAX];
+    struct dirent *de;
+    DIR *dir;
+    FILE *fp;
+    int tid;
+
+    snprintf(path, sizeof(path), "%s/cgroup.threads", cgroup);
+    fp = fopen(path, "r");
+    if (!fp)
+        return -1;
+    while (fscanf(fp, "%d", &tid) == 1)
+        account_task(w, tid, initial);
+    fclose(fp);
+
+    if (depth >= ENERGY_CGROUP_DEPTH || !(dir = opendir(cgroup)))
+        return 0;
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_type != DT_DIR || de->d_name[0] == '.')
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", cgroup, de->d_name);
+        read_cgroup_threads(w, path, initial, depth + 1);
+    }
+    closedir(dir);
+    return 0;
+}
+
+//usage_usec of a v2 cgroup, it counts the descendants and the tasks that already exited.
+//Like the cgroup v1 counters a failed read leaves the next one to set the baseline.
+static int read_cgroup_usage(energy_workload *w, int initial, double *total_ns) {
+    char path[600], key[64];
+    unsigned long long v;
+    int found = 0;
+    FILE *fp;
+
+    snprintf(path, sizeof(path), "%s/cpu.stat", w->path);
+    fp = fopen(path, "r");
+    if (fp) {
+        while (!found && fscanf(fp, "%63s %llu", key, &v) == 2)
+            found = strcmp(key, "usage_usec") == 0;
+        fclose(fp);
+    }
+    if (!found) {
+        w->stale = 1;
+        return -1;
+    }
+    v *= 1000;
+    *total_ns = initial || w->stale || v < w->last_usage_ns ? 0 : (double)(v - w->last_usage_ns);
+    w->last_usage_ns = v;
+    w->stale = 0;
+    return 0;
+}
+
+//Brings the per CPU runtime of the task walk to the cgroup total. What the walk missed goes
+//to the CPUs by their busy time, an excess from the reads not being atomic is scaled away.
+static void spread_usage(energy_workload *w, double total_ns) {
+    double walked = 0, busy = 0;
+    int cpu;
+
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        walked += w->delta_cpu_ns[cpu];
+        busy += delta_busy_ns[cpu];
+    }
+    if (walked >= total_ns) {
+        for (cpu = 0; cpu < ncpus; cpu++)
+            w->delta_cpu_ns[cpu] = walked > 0 ? w->delta_cpu_ns[cpu] * total_ns / walked : 0;
+        return;
+    }
+    for (cpu = 0; cpu < ncpus && busy > 0; cpu++)
+        w->delta_cpu_ns[cpu] += (total_ns - walked) * delta_busy_ns[cpu] / busy;
+}
+
+static int read_task_usage(energy_workload *w, int initial) {
+    double total_ns;
+    int i, j;
+    struct dirent *de;
+    DIR *dir;
+
+    memset(w->delta_cpu_ns, 0, ncpus * sizeof(double));
+    for (i = 0; i < w->task_count; i++)
+        w->tasks[i].seen = 0;
+
+    if (w->source == ENERGY_CGROUP_V2) {
+        if (read_cgroup_threads(w, w->path, initial, 0) != 0)
+            return -1;
+        if (read_cgroup_usage(w, initial, &total_ns) == 0)
+            spread_usage(w, total_ns);
+    } else {
+        dir = opendir(w->path);
+        if (!dir)
+            return -1;
+        while ((de = readdir(dir)) != NULL) {
+            if (de->d_name[0] < '0' || de->d_name[0] > '9')
+                continue;
+            account_task(w, atoi(de->d_name), initial);
+        }
+        closedir(dir);
+    }
+
+    //Forget tasks that exited
+    for (i = 0, j = 0; i < w->task_count; i++) {
+        if (w->tasks[i].seen)
+            w->tasks[j++] = w->tasks[i];
+    }
+    w->task_count = j;
+    return 0;
+}
+
+int energy_init(system_info *sysinfo, const char *cgroups, const char *pids) {
+    int err;
+
+    if (!cgroups && !pids)
+        return 0;
+
+    if (!sysinfo->cpumap && get_cpu_topology_map(sysinfo) != 0) {
+        fprintf(stderr, "Can't read the CPU topology for energy attribution.\n");
+        return -1;
+    }
+    ncpus = sysinfo->cpumap_count;
+    ns_per_tick = 1e9 / sysconf(_SC_CLK_TCK);
+
+    last_busy_ns = (unsigned long long *)calloc(ncpus, sizeof(unsigned long long));
+    delta_busy_ns = (double *)calloc(ncpus, sizeof(double));
+
+    err = add_list(cgroups, add_cgroup);
+    if (!err)
+        err = add_list(pids, add_pid);
+    if (err) {
+        energy_free();
+        return -1;
+    }
+    return 0;
+}
+
+int energy_enabled() {
+    return workload_count > 0;
+}
+
+void energy_update(pm_table *pmt, system_info *sysinfo) {
+    unsigned long long *busy;
+    struct timespec now;
+    double dt, core_energy, uncore_energy, core_busy, core_run, total_busy, total_run, run, share, attributed;
+    int i, c, cpu, initial;
+
+    if (!workload_count)
+        return;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    initial = !primed;
+    dt = (now.tv_sec - last_ts.tv_sec) + (now.tv_nsec - last_ts.tv_nsec) / 1e9;
+    last_ts = now;
+
+    busy = (unsigned long long *)calloc(ncpus, sizeof(unsigned long long));
+    read_cpu_busy(busy);
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        delta_busy_ns[cpu] = initial || busy[cpu] < last_busy_ns[cpu] ? 0 : (double)(busy[cpu] - last_busy_ns[cpu]);
+        last_busy_ns[cpu] = busy[cpu];
+    }
+    free(busy);
+
+    for (i = 0; i < workload_count; i++) {
+        if (workloads[i].source == ENERGY_CGROUP_V1)
+            read_percpu_usage(&workloads[i], initial);
+        else
+            read_task_usage(&workloads[i], initial);
+    }
+
+    primed = 1;
+    if (initial || dt <= 0)
+        return;
+
+    //Core power goes to the workloads that ran on the SMT siblings of the core
+    for (c = 0; c < pmt->max_cores; c++) {
+        if ((sysinfo->core_disable_map >> c) & 0x01)
+            continue;
+        core_energy = pmta0(CORE_POWER[c]) * dt;
+        core_busy = core_run = 0;
+        for (cpu = 0; cpu < ncpus; cpu++) {
+            if (sysinfo->cpumap[cpu] != c)
+                continue;
+            core_busy += delta_busy_ns[cpu];
+            for (i = 0; i < workload_count; i++)
+                core_run += workloads[i].delta_cpu_ns[cpu];
+        }
+        //Tick based busy time can lag behind the nanosecond runtime of the tasks
+        if (core_run > core_busy)
+            core_busy = core_run;
+
+        attributed = 0;
+        if (core_busy > 0) {
+            for (i = 0; i < workload_count; i++) {
+                run = 0;
+                for (cpu = 0; cpu < ncpus; cpu++) {
+                    if (sysinfo->cpumap[cpu] == c)
+                        run += workloads[i].delta_cpu_ns[cpu];
+                }
+                share = run / core_busy;
+                workloads[i].core_joules += share * core_energy;
+                attributed += share * core_energy;
+            }
+        }
+        unattributed_core_joules += core_energy - attributed;
+    }
+
+    //SoC and L3 power is shared by the whole package
+    uncore_energy = pmta0(VDDCR_SOC_POWER);
+    for (i = 0; i < pmt->max_l3; i++)
+        uncore_energy += pmta0(L3_LOGIC_POWER[i]) + pmta0(L3_VDDM_POWER[i]);
+    uncore_energy *= dt;
+
+    total_busy = total_run = 0;
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        total_busy += delta_busy_ns[cpu];
+        for (i = 0; i < workload_count; i++)
+            total_run += workloads[i].delta_cpu_ns[cpu];
+    }
+    if (total_run > total_busy)
+        total_busy = total_run;
+
+    attributed = 0;
+    for (i = 0; i < workload_count; i++) {
+        run = 0;
+        for (cpu = 0; cpu < ncpus; cpu++)
+            run += workloads[i].delta_cpu_ns[cpu];
+        workloads[i].cpu_time_s += run / 1e9;
+        if (total_busy > 0) {
+            share = run / total_busy;
+            workloads[i].uncore_joules += share * uncore_energy;
+            attributed += share * uncore_energy;
+        }
+    }
+    unattributed_uncore_joules += uncore_energy - attributed;
+}
+
+void draw_energy_export(const char *hostname) {
+    char tag[520];
+    int i;
+
+    for (i = 0; i < workload_count; i++) {
+        escape_tag(tag, sizeof(tag), workloads[i].name);
+        fprintf(stdout,
+                "ryzen_monitor_ng,host=%s,name=Energy,workload=%s energy_core_j=%.3f,energy_uncore_j=%.3f,energy_total_j=%.3f,cpu_time_s=%.3f\n",
+                hostname, tag, workloads[i].core_joules, workloads[i].uncore_joules,
+                workloads[i].core_joules + workloads[i].uncore_joules, workloads[i].cpu_time_s);
+    }
+    fprintf(stdout,
+            "ryzen_monitor_ng,host=%s,name=Energy,workload=unattributed energy_core_j=%.3f,energy_uncore_j=%.3f,energy_total_j=%.3f\n",
+            hostname, unattributed_core_joules, unattributed_uncore_joules,
+            unattributed_core_joules + unattributed_uncore_joules);
+}
+
+void energy_free() {
+    int i;
+
+    for (i = 0; i < workload_count; i++) {
+        free(workloads[i].last_cpu_ns);
+        free(workloads[i].tasks);
+        free(workloads[i].delta_cpu_ns);
+    }
+    workload_count = 0;
+    free(last_busy_ns);
+    free(delta_busy_ns);
+    last_busy_ns = NULL;
+    delta_busy_ns = NULL;
+    primed = 0;
+}
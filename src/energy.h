@@ -0,0 +1,64 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define ENERGY_MAX_WORKLOADS 64
+
+enum energy_source {
+    ENERGY_CGROUP_V1,   //cpuacct.usage_percpu, per CPU nanoseconds
+    ENERGY_CGROUP_V2,   //cpu.stat usage_usec, placed on CPUs by walking cgroup.threads of it and its descendants
+    ENERGY_PID,         ///proc/<pid>/task, walked per task
+};
+
+typedef struct {
+    int tid;
+    unsigned long long runtime_ns;
+    int seen;
+} energy_task;
+
+typedef struct {
+    char name[256];
+    char path[512];
+    enum energy_source source;
+
+    unsigned long long *last_cpu_ns;    //cgroup v1 only
+    unsigned long long last_usage_ns;   //cgroup v2 only
+    int stale;                          //cgroup v1 and v2, the last read failed
+    energy_task *tasks;                 //cgroup v2 and pid
+    int task_count;
+    int task_alloc;
+
+    double *delta_cpu_ns;               //Runtime of the last sample per logical CPU
+    double cpu_time_s;
+    double core_joules;
+    double uncore_joules;
+} energy_workload;
+
+int energy_init(system_info *sysinfo, const char *cgroups, const char *pids);
+int energy_enabled();
+void energy_update(pm_table *pmt, system_info *sysinfo);
+void draw_energy_export(const char *hostname);
+void energy_free();
+
+#endif
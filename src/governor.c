@@ -0,0 +1,243 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Closed loop PPT governor.
+ *
+ * Holds socket power, package power or temperature at a setpoint moving the
+ * PPT limit with an incremental PI controller. Every correction is clamped to
+ * [min_ppt, max_ppt] and to max_step W per interval, inside the hysteresis
+ * band the limit is left alone. The limits found at start are written back
+ * when the loop ends, governor_stop() is safe to call from a signal handler.
+ * Limit writes go through the SMU queue so a slow mailbox doesn't hold up
+ * the next sample, a newer limit replaces one that is still waiting.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <math.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "setinfo.h"
+#include "smuqueue.h"
+#include "governor.h"
+
+extern smu_obj_t obj;
+extern int debuglog;
+extern const int TEST_INT;
+
+#define pmta(elem) ((pmt->elem)?(*pmt->elem):NAN)
+
+static volatile sig_atomic_t gov_running = 0;
+static volatile sig_atomic_t gov_stop = 0;
+static volatile int gov_write_errors = 0;
+
+static const char *target_name[] = { "none", "socket power", "package power", "temperature" };
+static const char *target_unit[] = { "", "W", "W", "C" };
+
+void governor_defaults(governor_config *cfg) {
+    cfg->target = GOV_TARGET_NONE;
+    cfg->setpoint = 0;
+    cfg->hysteresis = 2.f;
+    cfg->kp = 0.5f;
+    cfg->ki = 0.2f;
+    cfg->min_ppt = 30;
+    cfg->max_ppt = 0;
+    cfg->max_step = 5;
+    cfg->scale_current = 0;
+    cfg->interval_ms = 1000;
+}
+
+int governor_active() {
+    return gov_running;
+}
+
+void governor_stop() {
+    gov_stop = 1;
+}
+
+static float governor_measure(pm_table *pmt, enum governor_target target) {
+    switch (target) {
+        case GOV_TARGET_SOCKET_POWER:   return pmta(SOCKET_POWER);
+        case GOV_TARGET_PACKAGE_POWER:  return pmta(PPT_VALUE);
+        case GOV_TARGET_TEMPERATURE:    return pmta(THM_VALUE);
+        default:                        return NAN;
+    }
+}
+
+//Runs on the queue worker
+static void governor_write_done(smu_request *req) {
+    if (req->ret)
+        __sync_fetch_and_add(&gov_write_errors, 1);
+}
+
+static int governor_apply(system_info *sysinfo, governor_config *cfg, int ppt,
+                          int orig_ppt, int orig_tdc, int orig_edc) {
+    smu_batch batch;
+    int tdc, edc, i, err = 0;
+
+    smu_batch_init(&batch);
+    smu_batch_record(&batch);
+
+    if (op_set_ppt(sysinfo, ppt) <= -100)
+        err = -1;
+
+    if (!err && cfg->scale_current && orig_ppt > 0) {
+        tdc = (int)((float)orig_tdc * ppt / orig_ppt + 0.5f);
+        edc = (int)((float)orig_edc * ppt / orig_ppt + 0.5f);
+        if (tdc > orig_tdc) tdc = orig_tdc;
+        if (edc > orig_edc) edc = orig_edc;
+        if (orig_tdc > 0 && tdc > 0) op_set_tdc(sysinfo, tdc);
+        if (orig_edc > 0 && edc > 0) op_set_edc(sysinfo, edc);
+    }
+    smu_batch_record(NULL);
+    if (err)
+        return err;
+
+    if (!smu_queue_running())
+        return smu_batch_run(&batch) && batch.cmds[0].ret ? -1 : 0;
+
+    //A limit still waiting in the queue is stale, the new one replaces it
+    for (i = 0; i < batch.count; i++) {
+        if (smu_queue_post(&batch.cmds[i], SMU_QUEUE_PRIO_NORMAL, SMU_REQ_MERGE, 0, governor_write_done, NULL) != 0)
+            err = -1;
+    }
+    return err;
+}
+
+static void governor_restore(system_info *sysinfo, governor_config *cfg, int orig_ppt, int orig_tdc, int orig_edc) {
+    int err = 0;
+
+    if (op_set_ppt(sysinfo, orig_ppt) <= -100) err = 1;
+    if (cfg->scale_current) {
+        if (orig_tdc > 0 && op_set_tdc(sysinfo, orig_tdc) <= -100) err = 1;
+        if (orig_edc > 0 && op_set_edc(sysinfo, orig_edc) <= -100) err = 1;
+    }
+
+    if (err)
+        fprintf(stderr, "governor: failed to restore the original limits (PPT %d W, TDC %d A, EDC %d A)\n",
+            orig_ppt, orig_tdc, orig_edc);
+    else
+        fprintf(stdout, "governor: restored PPT %d W\n", orig_ppt);
+}
+
+int governor_run(pm_table *pmt, system_info *sysinfo, governor_config *cfg) {
+    unsigned char *pm_buf;
+    int orig_ppt, orig_tdc, orig_edc, ppt, next;
+    float measured, error, prev_error = 0, out;
+    float dt = cfg->interval_ms / 1000.f;
+    int have_prev = 0;
+
+    if (cfg->target == GOV_TARGET_NONE)
+        return -1;
+
+    if (!pmt->zen_version || !pmt->PPT_LIMIT || op_set_ppt(sysinfo, TEST_INT) <= -100) {
+        fprintf(stderr, "governor: PPT control is not available on this processor.\n");
+        return -100;
+    }
+
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    select_pm_table_version(obj.pm_table_version, pmt, pm_buf);
+    if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK ||
+        isnan(governor_measure(pmt, cfg->target))) {
+        fprintf(stderr, "governor: %s is not available in this PM table.\n", target_name[cfg->target]);
+        free(pm_buf);
+        return -101;
+    }
+
+    orig_ppt = op_get_ppt(pmt);
+    orig_tdc = op_get_tdc(pmt);
+    orig_edc = op_get_edc(pmt);
+    if (cfg->max_ppt <= 0) cfg->max_ppt = orig_ppt;
+    if (cfg->min_ppt > cfg->max_ppt) cfg->min_ppt = cfg->max_ppt;
+    if (cfg->max_step < 1) cfg->max_step = 1;
+
+    ppt = orig_ppt < cfg->min_ppt ? cfg->min_ppt : orig_ppt > cfg->max_ppt ? cfg->max_ppt : orig_ppt;
+    out = ppt;
+
+    fprintf(stdout, "governor: holding %s at %.1f %s (+/- %.1f), PPT %d-%d W, started at PPT %d W\n",
+        target_name[cfg->target], cfg->setpoint, target_unit[cfg->target], cfg->hysteresis,
+        cfg->min_ppt, cfg->max_ppt, orig_ppt);
+    fflush(stdout);
+
+    gov_stop = 0;
+    gov_running = 1;
+    gov_write_errors = 0;
+    if (smu_queue_start() != 0 && debuglog)
+        fprintf(stderr, "governor: SMU queue not available, writing limits synchronously\n");
+
+    if (ppt != orig_ppt && governor_apply(sysinfo, cfg, ppt, orig_ppt, orig_tdc, orig_edc) != 0)
+        gov_stop = 1;
+
+    while (!gov_stop) {
+        msleep(cfg->interval_ms);
+        if (gov_stop)
+            break;
+        if (gov_write_errors) {
+            fprintf(stderr, "governor: %d limit writes failed\n", gov_write_errors);
+            gov_write_errors = 0;
+        }
+        if (smu_queue_read_pm_table(pm_buf) != 0)
+            continue;
+
+        measured = governor_measure(pmt, cfg->target);
+        if (isnan(measured))
+            continue;
+
+        //Positive error means headroom, the limit can go up
+        error = cfg->setpoint - measured;
+        if (fabsf(error) <= cfg->hysteresis) {
+            prev_error = error;
+            have_prev = 1;
+            continue;
+        }
+
+        //Incremental form, clamping the output is enough to avoid wind-up
+        out += cfg->ki * error * dt + (have_prev ? cfg->kp * (error - prev_error) : cfg->kp * error);
+        prev_error = error;
+        have_prev = 1;
+
+        if (out > ppt + cfg->max_step) out = ppt + cfg->max_step;
+        if (out < ppt - cfg->max_step) out = ppt - cfg->max_step;
+        if (out > cfg->max_ppt) out = cfg->max_ppt;
+        if (out < cfg->min_ppt) out = cfg->min_ppt;
+
+        next = (int)(out + 0.5f);
+        if (next == ppt)
+            continue;
+
+        if (governor_apply(sysinfo, cfg, next, orig_ppt, orig_tdc, orig_edc) != 0) {
+            if (debuglog) fprintf(stderr, "governor: failed to set PPT %d W\n", next);
+            continue;
+        }
+        fprintf(stdout, "governor: %s %.1f %s, PPT %d -> %d W\n",
+            target_name[cfg->target], measured, target_unit[cfg->target], ppt, next);
+        fflush(stdout);
+        ppt = next;
+    }
+
+    //Drop the writes still waiting, the original limits go out right after
+    smu_queue_stop();
+    governor_restore(sysinfo, cfg, orig_ppt, orig_tdc, orig_edc);
+    gov_running = 0;
+
+    free(pm_buf);
+    return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef GOVERNOR_H
+#define GOVERNOR_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+enum governor_target {
+    GOV_TARGET_NONE,
+    GOV_TARGET_SOCKET_POWER,    //SOCKET_POWER, W
+    GOV_TARGET_PACKAGE_POWER,   //PPT_VALUE, W
+    GOV_TARGET_TEMPERATURE,     //THM_VALUE, degree C
+};
+
+typedef struct {
+    enum governor_target target;
+    float setpoint;
+    float hysteresis;       //No correction while the error is within +/- this band
+    float kp;               //W of PPT per unit of error
+    float ki;               //W of PPT per unit of error per second
+    int min_ppt;            //W
+    int max_ppt;            //W, 0 for the limit found at start
+    int max_step;           //W of PPT change per interval
+    int scale_current;      //Scale TDC and EDC with the PPT ratio
+    int interval_ms;
+} governor_config;
+
+void governor_defaults(governor_config *cfg);
+int governor_run(pm_table *pmt, system_info *sysinfo, governor_config *cfg);
+int governor_active();
+void governor_stop();
+
+#endif
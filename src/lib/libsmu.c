@@ -20,6 +20,7 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <fcntl.h>
+#include <time.h>
 
 #include "libsmu.h"
 
@@ -169,6 +170,72 @@ static smu_return_val smu_init_parse(smu_obj_t* obj) {
     return SMU_Return_OK;
 }
 
+static unsigned long long stats_now_ns() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned int stats_bucket(unsigned long long ns) {
+    unsigned int exp, index;
+
+    if (ns < SMU_STATS_SUB_BUCKETS)
+        return ns;
+
+    // Position of the leading bit, the next two bits select the sub-bucket.
+    exp = 63 - __builtin_clzll(ns);
+    index = (exp - 1) * SMU_STATS_SUB_BUCKETS + ((ns >> (exp - 2)) & (SMU_STATS_SUB_BUCKETS - 1));
+
+    return index < SMU_STATS_BUCKETS ? index : SMU_STATS_BUCKETS - 1;
+}
+
+static unsigned long long stats_bucket_max(unsigned int index) {
+    unsigned int exp, sub;
+
+    if (index < SMU_STATS_SUB_BUCKETS)
+        return index;
+
+    exp = index / SMU_STATS_SUB_BUCKETS + 1;
+    sub = index % SMU_STATS_SUB_BUCKETS;
+    return ((unsigned long long)(SMU_STATS_SUB_BUCKETS + sub + 1) << (exp - 2)) - 1;
+}
+
+static void stats_record(smu_stats_entry* entry, smu_return_val ret, unsigned long long start) {
+    unsigned long long ns = stats_now_ns() - start;
+
+    entry->calls++;
+    entry->total_ns += ns;
+    if (ns > entry->max_ns)
+        entry->max_ns = ns;
+    entry->status[smu_stats_status_index(ret)]++;
+    entry->latency[stats_bucket(ns)]++;
+}
+
+// Called with SMU_MUTEX_CMD held.
+static smu_stats_entry* stats_cmd_entry(smu_obj_t* obj, unsigned int op, enum smu_mailbox mailbox) {
+    smu_stats_t* stats = obj->stats;
+    smu_stats_entry* entry;
+    unsigned int i;
+
+    for (i = 0; i < stats->cmd_count; i++) {
+        if (stats->cmds[i].op == op && stats->cmds[i].mailbox == mailbox)
+            return &stats->cmds[i];
+    }
+
+    if (stats->cmd_count == SMU_STATS_MAX_CMDS) {
+        stats->cmd_dropped++;
+        return NULL;
+    }
+
+    entry = &stats->cmds[stats->cmd_count++];
+    entry->source = SMU_STATS_CMD;
+    entry->mailbox = mailbox;
+    entry->op = op;
+
+    return entry;
+}
+
 smu_return_val smu_init(smu_obj_t* obj) {
     int i, ret;
 
@@ -197,6 +264,10 @@ smu_return_val smu_init(smu_obj_t* obj) {
     for (i = 0; i < SMU_MUTEX_COUNT; i++)
         pthread_mutex_init(&obj->lock[i], NULL);
 
+    // Statistics are optional, everything works without them.
+    obj->stats = calloc(1, sizeof(smu_stats_t));
+    smu_reset_stats(obj);
+
     obj->init = 1;
 
     return SMU_Return_OK;
@@ -229,6 +300,8 @@ void smu_free(smu_obj_t* obj) {
     for (i = 0; i < SMU_MUTEX_COUNT; i++)
         pthread_mutex_destroy(&obj->lock[i]);
 
+    free(obj->stats);
+
     memset(obj, 0, sizeof(*obj));
 }
 
@@ -253,6 +326,7 @@ const char* smu_get_fw_version(smu_obj_t* obj) {
 }
 
 smu_return_val smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int* result) {
+    unsigned long long start = stats_now_ns();
     unsigned int ret;
 
     // Don't attempt to execute without initialization.
@@ -271,9 +345,47 @@ smu_return_val smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned
     ret = read(obj->fd_smn, result, sizeof(*result));
 
 BREAK_OUT:
+    ret = ret == sizeof(unsigned int) ? SMU_Return_OK : SMU_Return_RWError;
+    if (obj->stats)
+        stats_record(&obj->stats->smn_read, ret, start);
+
+    pthread_mutex_unlock(&obj->lock[SMU_MUTEX_SMN]);
+
+    return ret;
+}
+
+smu_return_val smu_read_smn_addr_batch(smu_obj_t* obj, const unsigned int* addresses,
+    unsigned int* results, unsigned int count) {
+    unsigned long long start = stats_now_ns();
+    unsigned int i, ret = sizeof(unsigned int);
+
+    // Don't attempt to execute without initialization.
+    if (!obj->init)
+        return SMU_Return_Failed;
+
+    pthread_mutex_lock(&obj->lock[SMU_MUTEX_SMN]);
+
+    for (i = 0; i < count; i++) {
+        lseek(obj->fd_smn, 0, SEEK_SET);
+        ret = write(obj->fd_smn, &addresses[i], sizeof(addresses[i]));
+
+        if (ret != sizeof(addresses[i]))
+            break;
+
+        lseek(obj->fd_smn, 0, SEEK_SET);
+        ret = read(obj->fd_smn, &results[i], sizeof(results[i]));
+
+        if (ret != sizeof(unsigned int))
+            break;
+    }
+
+    ret = ret == sizeof(unsigned int) ? SMU_Return_OK : SMU_Return_RWError;
+    if (obj->stats)
+        stats_record(&obj->stats->smn_batch, ret, start);
+
     pthread_mutex_unlock(&obj->lock[SMU_MUTEX_SMN]);
 
-    return ret == sizeof(unsigned int) ? SMU_Return_OK : SMU_Return_RWError;
+    return ret;
 }
 
 smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int value) {
@@ -300,7 +412,9 @@ smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned
 
 smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t* args,
     enum smu_mailbox mailbox) {
+    unsigned long long start = stats_now_ns();
     unsigned int ret, status, fd_smu_cmd;
+    smu_stats_entry* entry;
 
     // Don't attempt to execute without initialization.
     if (!obj->init)
@@ -361,12 +475,16 @@ smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t* args
     }
 
 BREAK_OUT:
+    if (obj->stats && (entry = stats_cmd_entry(obj, op, mailbox)))
+        stats_record(entry, ret, start);
+
     pthread_mutex_unlock(&obj->lock[SMU_MUTEX_CMD]);
 
     return ret;
 }
 
 smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len) {
+    unsigned long long start = stats_now_ns();
     int ret;
 
     // Don't attempt to execute without initialization.
@@ -386,11 +504,77 @@ smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_
     else
         ret = SMU_Return_OK;
 
+    if (obj->stats)
+        stats_record(&obj->stats->pm_read, ret, start);
+
     pthread_mutex_unlock(&obj->lock[SMU_MUTEX_PM]);
 
     return ret;
 }
 
+const smu_stats_t* smu_get_stats(smu_obj_t* obj) {
+    return obj->stats;
+}
+
+void smu_reset_stats(smu_obj_t* obj) {
+    int i;
+
+    if (!obj->stats)
+        return;
+
+    // Hold every lock so no call records into a half cleared table.
+    for (i = 0; i < SMU_MUTEX_COUNT; i++)
+        if (obj->init) pthread_mutex_lock(&obj->lock[i]);
+
+    memset(obj->stats, 0, sizeof(smu_stats_t));
+    obj->stats->pm_read.source = SMU_STATS_PM_READ;
+    obj->stats->smn_read.source = SMU_STATS_SMN_READ;
+    obj->stats->smn_batch.source = SMU_STATS_SMN_BATCH;
+
+    for (i = SMU_MUTEX_COUNT - 1; i >= 0; i--)
+        if (obj->init) pthread_mutex_unlock(&obj->lock[i]);
+}
+
+unsigned long long smu_stats_percentile(const smu_stats_entry* entry, double q) {
+    unsigned long long target, seen = 0, max;
+    unsigned int i;
+
+    if (!entry->calls)
+        return 0;
+
+    target = (unsigned long long)(q * entry->calls + 0.5);
+    if (target < 1) target = 1;
+    if (target > entry->calls) target = entry->calls;
+
+    for (i = 0; i < SMU_STATS_BUCKETS; i++) {
+        seen += entry->latency[i];
+        if (seen >= target) {
+            max = stats_bucket_max(i);
+            return max < entry->max_ns ? max : entry->max_ns;
+        }
+    }
+
+    return entry->max_ns;
+}
+
+unsigned int smu_stats_status_index(smu_return_val val) {
+    if (val == SMU_Return_OK)
+        return 0;
+    if (val >= SMU_Return_DriverVersion && val <= SMU_Return_Failed)
+        return val - SMU_Return_DriverVersion + 1;
+
+    return SMU_STATS_STATUS_COUNT - 1;
+}
+
+smu_return_val smu_stats_status_value(unsigned int index) {
+    if (index == 0)
+        return SMU_Return_OK;
+    if (index < SMU_STATS_STATUS_COUNT - 1)
+        return SMU_Return_DriverVersion + index - 1;
+
+    return 0;
+}
+
 const char* smu_return_to_str(smu_return_val val) {
     switch (val) {
         case SMU_Return_OK:
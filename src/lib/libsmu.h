@@ -120,6 +120,44 @@ enum SMU_MUTEX_LOCK {
     SMU_MUTEX_COUNT
 };
 
+/**
+ * Mailbox and table access statistics.
+ * Latencies are kept in a log-linear histogram: values below
+ * SMU_STATS_SUB_BUCKETS ns have their own bucket, every power of two above
+ * is split in SMU_STATS_SUB_BUCKETS buckets.
+ */
+#define SMU_STATS_MAX_CMDS          64
+#define SMU_STATS_SUB_BUCKETS       4
+#define SMU_STATS_BUCKETS           (36 * SMU_STATS_SUB_BUCKETS)
+#define SMU_STATS_STATUS_COUNT      26
+
+enum smu_stats_source {
+    SMU_STATS_CMD,
+    SMU_STATS_PM_READ,
+    SMU_STATS_SMN_READ,
+    SMU_STATS_SMN_BATCH,
+};
+
+typedef struct {
+    enum smu_stats_source       source;
+    enum smu_mailbox            mailbox;    // SMU_STATS_CMD only
+    unsigned int                op;         // SMU_STATS_CMD only
+    unsigned long long          calls;
+    unsigned long long          total_ns;
+    unsigned long long          max_ns;
+    unsigned long long          status[SMU_STATS_STATUS_COUNT];
+    unsigned long long          latency[SMU_STATS_BUCKETS];
+} smu_stats_entry;
+
+typedef struct {
+    smu_stats_entry             pm_read;
+    smu_stats_entry             smn_read;
+    smu_stats_entry             smn_batch;
+    smu_stats_entry             cmds[SMU_STATS_MAX_CMDS];
+    unsigned int                cmd_count;
+    unsigned long long          cmd_dropped;    // Commands not recorded, the table was full
+} smu_stats_t;
+
 typedef struct {
     /* Accessible To Users, Read-Only. */
     unsigned int                init;
@@ -140,6 +178,7 @@ typedef struct {
     int                         fd_pm_table;
 
     pthread_mutex_t             lock[SMU_MUTEX_COUNT];
+    smu_stats_t*                stats;
 } smu_obj_t;
 
 typedef union {
@@ -189,6 +228,15 @@ const char* smu_get_fw_version(smu_obj_t* obj);
 smu_return_val smu_read_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int* result);
 smu_return_val smu_write_smn_addr(smu_obj_t* obj, unsigned int address, unsigned int value);
 
+/**
+ * Reads count 32 bit words from the SMN address space holding the lock once.
+ * Stops at the first failing address.
+ *
+ * Returns SMU_Return_OK if all the addresses have been read.
+ */
+smu_return_val smu_read_smn_addr_batch(smu_obj_t* obj, const unsigned int* addresses,
+    unsigned int* results, unsigned int count);
+
 /**
  * Sends a command to the SMU.
  * Arguments are sent in the args buffer and are also returned in it.
@@ -205,6 +253,28 @@ smu_return_val smu_send_command(smu_obj_t* obj, unsigned int op, smu_arg_t *args
  */
 smu_return_val smu_read_pm_table(smu_obj_t* obj, unsigned char* dst, size_t dst_len);
 
+/**
+ * Statistics of every command, PM table and SMN read since smu_init().
+ * Commands are counted per mailbox and opcode, only calls that reached the
+ * driver are recorded. Latency includes the wait for the lock.
+ *
+ * Returns NULL if the statistics couldn't be allocated.
+ */
+const smu_stats_t* smu_get_stats(smu_obj_t* obj);
+void smu_reset_stats(smu_obj_t* obj);
+
+/**
+ * Upper bound in ns of the bucket holding quantile q (0-1) of an entry.
+ */
+unsigned long long smu_stats_percentile(const smu_stats_entry* entry, double q);
+
+/**
+ * Index of a return value in smu_stats_entry.status and back.
+ * Index 0 is SMU_Return_OK, the last index collects unknown values.
+ */
+unsigned int smu_stats_status_index(smu_return_val val);
+smu_return_val smu_stats_status_value(unsigned int index);
+
 /** HELPER METHODS **/
 
 /**
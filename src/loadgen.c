@@ -0,0 +1,413 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Load generator, one worker thread pinned to each requested logical CPU.
+ *
+ * Workers run the selected kernel in short chunks and, below 100% duty,
+ * sleep for the rest of every LOADGEN_PERIOD_MS window.
+ *
+ * loadgen_characterize() loads one core at a time and then all of them
+ * together, sampling frequency, power, voltage and temperature of every
+ * core from the PM table for each phase.
+ **/
+
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <math.h>
+#include <immintrin.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "loadgen.h"
+
+extern smu_obj_t obj;
+
+#define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
+
+typedef struct {
+    pthread_t thread;
+    int cpu;
+    double *buf;            //Streaming kernels only
+    size_t buf_len;         //In doubles
+    size_t pos;
+} loadgen_worker;
+
+static const char *kernel_names[] = { "scalar", "fma", "l3", "dram", "verify" };
+
+static loadgen_worker workers[LOADGEN_MAX_WORKERS];
+static int worker_count = 0;
+static volatile int load_running = 0;
+static enum loadgen_kernel load_kernel;
+static int load_duty;
+
+static volatile uint64_t load_sink;
+static uint64_t verify_reference;
+static volatile unsigned long verify_errors = 0;
+
+//Dependent integer multiply/xor chain, keeps the ALUs busy without touching memory
+static void kernel_scalar(uint64_t iterations) {
+    uint64_t x = 0x9E3779B97F4A7C15ULL, y = 1;
+
+    while (iterations--) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        y = y * 6364136223846793005ULL + x;
+    }
+    load_sink = y;
+}
+
+//Eight independent FMA chains on 256 bit vectors, enough to fill both FMA pipes
+__attribute__((target("avx2,fma")))
+static void kernel_fma(uint64_t iterations) {
+    __m256d a0 = _mm256_set1_pd(1.0), a1 = a0, a2 = a0, a3 = a0, a4 = a0, a5 = a0, a6 = a0, a7 = a0;
+    const __m256d m = _mm256_set1_pd(0.999999), c = _mm256_set1_pd(1e-6);
+    double out[4];
+
+    while (iterations--) {
+        a0 = _mm256_fmadd_pd(a0, m, c); a1 = _mm256_fmadd_pd(a1, m, c);
+        a2 = _mm256_fmadd_pd(a2, m, c); a3 = _mm256_fmadd_pd(a3, m, c);
+        a4 = _mm256_fmadd_pd(a4, m, c); a5 = _mm256_fmadd_pd(a5, m, c);
+        a6 = _mm256_fmadd_pd(a6, m, c); a7 = _mm256_fmadd_pd(a7, m, c);
+    }
+    a0 = _mm256_add_pd(_mm256_add_pd(_mm256_add_pd(a0, a1), _mm256_add_pd(a2, a3)),
+                       _mm256_add_pd(_mm256_add_pd(a4, a5), _mm256_add_pd(a6, a7)));
+    _mm256_storeu_pd(out, a0);
+    load_sink = (uint64_t)(out[0] + out[1] + out[2] + out[3]);
+}
+
+//Read-modify-write stream over the worker buffer, chunk doubles per call
+static void kernel_stream(loadgen_worker *w, size_t chunk) {
+    double *p, sum = 0;
+    size_t i;
+
+    if (w->pos + chunk > w->buf_len)
+        w->pos = 0;
+    p = w->buf + w->pos;
+    for (i = 0; i < chunk; i++) {
+        sum += p[i];
+        p[i] = p[i] * 0.5 + 1.0;
+    }
+    w->pos += chunk;
+    load_sink = (uint64_t)sum;
+}
+
+//Mixed FP and integer chain, bit exact on a healthy core so any difference is an error
+static uint64_t kernel_verify_block() {
+    double a = 1.0, b = 0.5;
+    uint64_t h = 0xCBF29CE484222325ULL, bits;
+    int i;
+
+    for (i = 0; i < 8192; i++) {
+        a = a * 1.0000001 + i * 1e-9;
+        b = b * 0.9999999 + a * 1e-7;
+        h = (h ^ (uint64_t)(a * 1e6) ^ ((uint64_t)i << 32)) * 0x100000001B3ULL;
+    }
+    memcpy(&bits, &b, sizeof(bits));
+    return h ^ bits;
+}
+
+static void kernel_verify() {
+    if (kernel_verify_block() != verify_reference)
+        __sync_fetch_and_add(&verify_errors, 1);
+}
+
+static void run_kernel(loadgen_worker *w) {
+    switch (load_kernel) {
+        case LOAD_KERNEL_VERIFY:
+            kernel_verify();
+            break;
+        case LOAD_KERNEL_FMA:
+            kernel_fma(1 << 14);
+            break;
+        case LOAD_KERNEL_L3:
+        case LOAD_KERNEL_DRAM:
+            kernel_stream(w, 1 << 15);
+            break;
+        case LOAD_KERNEL_SCALAR:
+        default:
+            kernel_scalar(1 << 16);
+            break;
+    }
+}
+
+static void *loadgen_worker_main(void *arg) {
+    loadgen_worker *w = (loadgen_worker *)arg;
+    unsigned long long period_ns = LOADGEN_PERIOD_MS * 1000000ULL, busy_ns, start, now;
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(w->cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+        fprintf(stderr, "loadgen: can't pin worker to CPU %d\n", w->cpu);
+
+    //Allocated after pinning so the pages are local to the worker
+    if (load_kernel == LOAD_KERNEL_L3 || load_kernel == LOAD_KERNEL_DRAM) {
+        w->buf_len = (load_kernel == LOAD_KERNEL_L3 ? LOADGEN_L3_BYTES : LOADGEN_DRAM_BYTES) / sizeof(double);
+        w->buf = malloc(w->buf_len * sizeof(double));
+        if (!w->buf) {
+            fprintf(stderr, "loadgen: out of memory on CPU %d\n", w->cpu);
+            return NULL;
+        }
+        memset(w->buf, 0, w->buf_len * sizeof(double));
+        w->pos = 0;
+    }
+
+    busy_ns = period_ns * load_duty / 100;
+
+    while (load_running) {
+        start = get_time_ns();
+        do {
+            run_kernel(w);
+            now = get_time_ns();
+        } while (load_running && now - start < busy_ns);
+
+        if (load_duty < 100 && load_running)
+            msleep((period_ns - (now - start < period_ns ? now - start : period_ns)) / 1000000);
+    }
+
+    free(w->buf);
+    w->buf = NULL;
+    return NULL;
+}
+
+int loadgen_start(const int *cpus, int count, enum loadgen_kernel kernel, int duty) {
+    int i;
+
+    if (load_running)
+        loadgen_stop();
+
+    if (count > LOADGEN_MAX_WORKERS)
+        count = LOADGEN_MAX_WORKERS;
+
+    if (kernel == LOAD_KERNEL_FMA && !(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))) {
+        fprintf(stderr, "loadgen: no AVX2/FMA on this CPU, using the scalar kernel\n");
+        kernel = LOAD_KERNEL_SCALAR;
+    }
+
+    //Reference computed by the calling thread before any worker runs
+    if (kernel == LOAD_KERNEL_VERIFY) {
+        verify_reference = kernel_verify_block();
+        verify_errors = 0;
+    }
+
+    load_kernel = kernel;
+    load_duty = duty < 1 ? 1 : duty > 100 ? 100 : duty;
+    load_running = 1;
+    worker_count = 0;
+
+    for (i = 0; i < count; i++) {
+        memset(&workers[worker_count], 0, sizeof(loadgen_worker));
+        workers[worker_count].cpu = cpus[i];
+        if (pthread_create(&workers[worker_count].thread, NULL, loadgen_worker_main, &workers[worker_count]) != 0) {
+            fprintf(stderr, "loadgen: can't start worker for CPU %d\n", cpus[i]);
+            loadgen_stop();
+            return -1;
+        }
+        worker_count++;
+    }
+
+    return 0;
+}
+
+void loadgen_stop() {
+    int i;
+
+    load_running = 0;
+    for (i = 0; i < worker_count; i++)
+        pthread_join(workers[i].thread, NULL);
+    worker_count = 0;
+}
+
+int loadgen_running() {
+    return load_running;
+}
+
+//Mismatches of the verify kernel since its last start
+unsigned long loadgen_errors() {
+    return verify_errors;
+}
+
+//Logical CPU running the given PM table core, sibling selects the SMT thread.
+//Returns -1 if the core has no such logical CPU.
+int loadgen_cpu_for_core(system_info *sysinfo, int core, int sibling) {
+    int cpu, n = 0;
+
+    if (!sysinfo->cpumap && get_cpu_topology_map(sysinfo) != 0)
+        return -1;
+
+    for (cpu = 0; cpu < sysinfo->cpumap_count; cpu++) {
+        if (sysinfo->cpumap[cpu] == core && n++ == sibling)
+            return cpu;
+    }
+    return -1;
+}
+
+int loadgen_parse_kernel(const char *str, enum loadgen_kernel *kernel) {
+    int i;
+
+    for (i = 0; i < (int)(sizeof(kernel_names) / sizeof(kernel_names[0])); i++) {
+        if (!strcmp(str, kernel_names[i])) {
+            *kernel = (enum loadgen_kernel)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const char* loadgen_kernel_name(enum loadgen_kernel kernel) {
+    return kernel_names[kernel];
+}
+
+//Comma separated PM table core indexes, NULL or "all" for every enabled core
+//Cores are physical PM table indices, sysinfo->cores only counts the enabled ones
+int loadgen_parse_cores(const char *str, pm_table *pmt, system_info *sysinfo, loadgen_config *cfg) {
+    char buf[256], *tok, *rest, *end;
+    int i, cores = physical_core_count(pmt, sysinfo);
+    long core;
+
+    cfg->core_count = 0;
+    if (!str || !strcmp(str, "all")) {
+        for (i = 0; i < cores; i++) {
+            if (!((sysinfo->core_disable_map >> i) & 1))
+                cfg->cores[cfg->core_count++] = i;
+        }
+        return cfg->core_count ? 0 : -1;
+    }
+
+    snprintf(buf, sizeof(buf), "%s", str);
+    for (tok = strtok_r(buf, ",", &rest); tok; tok = strtok_r(NULL, ",", &rest)) {
+        core = strtol(tok, &end, 10);
+        if (end == tok || *end || core < 0 || core >= cores ||
+            ((sysinfo->core_disable_map >> core) & 1)) {
+            fprintf(stderr, "loadgen: invalid or disabled core \"%s\"\n", tok);
+            return -1;
+        }
+        if (cfg->core_count < PMT_MAX_NUM_CORES)
+            cfg->cores[cfg->core_count++] = (int)core;
+    }
+    return cfg->core_count ? 0 : -1;
+}
+
+int loadgen_phase_cpus(system_info *sysinfo, loadgen_config *cfg, const int *cores, int count, int *cpus) {
+    int i, n = 0, cpu;
+
+    for (i = 0; i < count; i++) {
+        if ((cpu = loadgen_cpu_for_core(sysinfo, cores[i], 0)) >= 0)
+            cpus[n++] = cpu;
+        if (cfg->smt && (cpu = loadgen_cpu_for_core(sysinfo, cores[i], 1)) >= 0)
+            cpus[n++] = cpu;
+    }
+    return n;
+}
+
+//Runs one load phase and averages every core of the PM table over it
+int loadgen_sample_phase(pm_table *pmt, unsigned char *pm_buf, loadgen_config *cfg,
+                     const int *cpus, int cpu_count, loadgen_core_stats *stats) {
+    unsigned long long start, now;
+    int i;
+
+    memset(stats, 0, PMT_MAX_NUM_CORES * sizeof(loadgen_core_stats));
+    if (loadgen_start(cpus, cpu_count, cfg->kernel, cfg->duty) != 0)
+        return -1;
+
+    msleep(LOADGEN_SETTLE_MS);
+    start = get_time_ns();
+    while ((now = get_time_ns()) - start < cfg->phase_s * 1000000000ULL) {
+        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+            for (i = 0; i < pmt->max_cores; i++) {
+                stats[i].n++;
+                stats[i].freq    += pmta0(CORE_FREQEFF[i]) * 1000.f;
+                stats[i].power   += pmta0(CORE_POWER[i]);
+                stats[i].voltage += pmta0(CORE_VOLTAGE[i]);
+                stats[i].temp    += pmta0(CORE_TEMP[i]);
+            }
+        }
+        msleep(LOADGEN_SAMPLE_MS);
+    }
+    loadgen_stop();
+
+    for (i = 0; i < pmt->max_cores; i++) {
+        if (!stats[i].n) continue;
+        stats[i].freq    /= stats[i].n;
+        stats[i].power   /= stats[i].n;
+        stats[i].voltage /= stats[i].n;
+        stats[i].temp    /= stats[i].n;
+    }
+    return 0;
+}
+
+int loadgen_characterize(pm_table *pmt, system_info *sysinfo, loadgen_config *cfg) {
+    loadgen_core_stats alone[PMT_MAX_NUM_CORES], phase[PMT_MAX_NUM_CORES], all[PMT_MAX_NUM_CORES];
+    int cpus[LOADGEN_MAX_WORKERS], cpu_count, i, core, err = 0;
+    unsigned char *pm_buf;
+
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(obj.pm_table_version, pmt, pm_buf)) {
+        fprintf(stderr, "loadgen: the PM table is needed for characterization\n");
+        free(pm_buf);
+        return -1;
+    }
+
+    memset(alone, 0, sizeof(alone));
+    for (i = 0; i < cfg->core_count && !err; i++) {
+        core = cfg->cores[i];
+        cpu_count = loadgen_phase_cpus(sysinfo, cfg, &core, 1, cpus);
+        fprintf(stderr, "loadgen: core %d alone, %s kernel at %d%% duty\n", core, kernel_names[cfg->kernel], cfg->duty);
+        if (!cpu_count || loadgen_sample_phase(pmt, pm_buf, cfg, cpus, cpu_count, phase) != 0)
+            err = -2;
+        else
+            alone[core] = phase[core];
+    }
+
+    if (!err && cfg->core_count > 1) {
+        cpu_count = loadgen_phase_cpus(sysinfo, cfg, cfg->cores, cfg->core_count, cpus);
+        fprintf(stderr, "loadgen: %d cores together\n", cfg->core_count);
+        if (loadgen_sample_phase(pmt, pm_buf, cfg, cpus, cpu_count, all) != 0)
+            err = -2;
+    } else {
+        memset(all, 0, sizeof(all));
+    }
+
+    if (!err) {
+        fprintf(stdout, "Kernel %s, duty %d%%, %d s per phase%s\n", kernel_names[cfg->kernel], cfg->duty,
+            cfg->phase_s, cfg->smt ? ", SMT siblings loaded" : "");
+        fprintf(stdout, "      |------------ alone ------------|--------- all selected ----------|\n");
+        fprintf(stdout, "Core  |   MHz      W       V       C  |   MHz      W       V       C  |\n");
+        for (i = 0; i < cfg->core_count; i++) {
+            core = cfg->cores[i];
+            fprintf(stdout, "%4d  | %5.0f %6.2f %7.4f %6.1f  |", core,
+                alone[core].freq, alone[core].power, alone[core].voltage, alone[core].temp);
+            if (all[core].n)
+                fprintf(stdout, " %5.0f %6.2f %7.4f %6.1f  |\n",
+                    all[core].freq, all[core].power, all[core].voltage, all[core].temp);
+            else
+                fprintf(stdout, "     -      -       -      -  |\n");
+        }
+    }
+
+    free(pm_buf);
+    return err;
+}
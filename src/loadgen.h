@@ -0,0 +1,71 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef LOADGEN_H
+#define LOADGEN_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define LOADGEN_MAX_WORKERS 256
+#define LOADGEN_PERIOD_MS   100     //Duty cycle period
+#define LOADGEN_L3_BYTES    (2 << 20)   //Per worker, stays resident in L3
+#define LOADGEN_DRAM_BYTES  (64 << 20)  //Per worker, well beyond any L3
+#define LOADGEN_SETTLE_MS   1000    //Skipped at the start of every phase
+#define LOADGEN_SAMPLE_MS   100
+
+enum loadgen_kernel {
+    LOAD_KERNEL_SCALAR,     //Integer ALU, no memory traffic
+    LOAD_KERNEL_FMA,        //AVX2 FMA, falls back to scalar without AVX2
+    LOAD_KERNEL_L3,         //Streaming over an L3 resident buffer
+    LOAD_KERNEL_DRAM,       //Streaming over a buffer much larger than L3
+    LOAD_KERNEL_VERIFY,     //Deterministic compute checked against a reference
+};
+
+typedef struct {
+    enum loadgen_kernel kernel;
+    int duty;               //Percent of every LOADGEN_PERIOD_MS spent running the kernel
+    int phase_s;
+    int smt;                //Load both SMT siblings of a core
+    int cores[PMT_MAX_NUM_CORES];
+    int core_count;
+} loadgen_config;
+
+typedef struct {
+    unsigned long n;
+    double freq;            //MHz
+    double power;           //W
+    double voltage;         //V
+    double temp;            //C
+} loadgen_core_stats;
+
+int loadgen_start(const int *cpus, int count, enum loadgen_kernel kernel, int duty);
+void loadgen_stop();
+int loadgen_running();
+int loadgen_cpu_for_core(system_info *sysinfo, int core, int sibling);
+int loadgen_parse_kernel(const char *str, enum loadgen_kernel *kernel);
+const char* loadgen_kernel_name(enum loadgen_kernel kernel);
+int loadgen_parse_cores(const char *str, pm_table *pmt, system_info *sysinfo, loadgen_config *cfg);
+int loadgen_phase_cpus(system_info *sysinfo, loadgen_config *cfg, const int *cores, int count, int *cpus);
+int loadgen_sample_phase(pm_table *pmt, unsigned char *pm_buf, loadgen_config *cfg,
+                         const int *cpus, int cpu_count, loadgen_core_stats *stats);
+unsigned long loadgen_errors();
+int loadgen_characterize(pm_table *pmt, system_info *sysinfo, loadgen_config *cfg);
+
+#endif
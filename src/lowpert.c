@@ -0,0 +1,115 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Low-perturbation sampling.
+ *
+ * The monitor runs on one housekeeping CPU with a large timer slack so the
+ * kernel can fold its wakeup into other timers, and sleeps on an absolute
+ * CLOCK_MONOTONIC deadline once per sample. With a terminal on stdin the
+ * same wait also returns on a key press, there is no polling in between.
+ **/
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <signal.h>
+#include <time.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include "commonfuncs.h"
+#include "lowpert.h"
+
+static struct termios saved_tty;
+static volatile sig_atomic_t tty_saved = 0;
+
+int lowpert_setup(int cpu, unsigned long long period_ns) {
+    unsigned long long slack = LOWPERT_TIMERSLACK_NS;
+    cpu_set_t set;
+    int err = 0;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (cpu < 0 || cpu >= CPU_SETSIZE || sched_setaffinity(0, sizeof(set), &set) != 0) {
+        fprintf(stderr, "Could not pin the monitor to CPU %d.\n", cpu);
+        err = -1;
+    }
+
+    if (slack > period_ns / 10)
+        slack = period_ns / 10;
+    if (slack && prctl(PR_SET_TIMERSLACK, slack, 0, 0, 0) != 0) {
+        fprintf(stderr, "Could not set the timer slack.\n");
+        err = -1;
+    }
+    return err;
+}
+
+//Keys arrive one at a time without echo, returns 0 when stdin is not a terminal
+int lowpert_tty_begin() {
+    struct termios t;
+
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &saved_tty) != 0)
+        return 0;
+    t = saved_tty;
+    t.c_lflag &= ~(ICANON | ECHO);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    tty_saved = 1;
+    tcsetattr(STDIN_FILENO, TCSANOW, &t);
+    return 1;
+}
+
+//Safe to call from a signal handler
+void lowpert_tty_end() {
+    if (!tty_saved)
+        return;
+    tcsetattr(STDIN_FILENO, TCSANOW, &saved_tty);
+    tty_saved = 0;
+}
+
+//Sleeps until deadline_ns, returns the key pressed first or -1 at the deadline
+int lowpert_wait_until(unsigned long long deadline_ns, int tty) {
+    struct pollfd pfd = { STDIN_FILENO, POLLIN, 0 };
+    struct timespec ts;
+    unsigned long long now;
+    unsigned char ch;
+
+    if (!tty) {
+        ts.tv_sec = deadline_ns / 1000000000ULL;
+        ts.tv_nsec = deadline_ns % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+        return -1;
+    }
+
+    while ((now = get_time_ns()) < deadline_ns) {
+        ts.tv_sec = (deadline_ns - now) / 1000000000ULL;
+        ts.tv_nsec = (deadline_ns - now) % 1000000000ULL;
+        if (ppoll(&pfd, 1, &ts, NULL) > 0) {
+            if (read(STDIN_FILENO, &ch, 1) == 1)
+                return ch;
+            //EOF on the terminal, nothing to wait for anymore
+            return lowpert_wait_until(deadline_ns, 0);
+        }
+    }
+    return -1;
+}
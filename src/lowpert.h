@@ -0,0 +1,31 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef LOWPERT_H
+#define LOWPERT_H
+
+#define LOWPERT_TIMERSLACK_NS   50000000ULL     //Capped to a tenth of the sample period
+
+int lowpert_setup(int cpu, unsigned long long period_ns);
+int lowpert_tty_begin();
+void lowpert_tty_end();
+int lowpert_wait_until(unsigned long long deadline_ns, int tty);
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * APERF, MPERF and TSC of every logical CPU through /dev/cpu/N/msr.
+ *
+ * A read of a remote CPU's MSR waits for an IPI, so the CPUs are split in
+ * slices over a few workers that all read in the same sample. Deltas give
+ * the C0 frequency (APERF/MPERF times the TSC rate), the effective
+ * frequency over the interval (APERF/TSC) and the C0 share (MPERF/TSC).
+ * Each CPU is joined to its PM table core with the topology map. A plain
+ * file in place of the msr device holds register r at offset r * 8, so a
+ * tree of such files works as a fake /dev/cpu.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "commonfuncs.h"
+#include "msr.h"
+
+static msr_thread *threads = NULL;
+static int thread_count = 0;
+
+static pthread_t workers[MSR_MAX_WORKERS];
+static int worker_count = 0;
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static unsigned long generation = 0;
+static int pending = 0;
+static int stopping = 0;
+
+//The msr device takes the register number as the offset, a plain file holds register r at r * 8
+static int read_msr(const msr_thread *t, unsigned int reg, unsigned long long *value) {
+    return pread(t->fd, value, sizeof(*value), (off_t)reg * t->stride) == sizeof(*value) ? 0 : -1;
+}
+
+static void read_slice(int first, int end) {
+    msr_thread *t;
+    int i;
+
+    for (i = first; i < end; i++) {
+        t = &threads[i];
+        //APERF and MPERF back to back, their ratio is what matters most
+        t->ok = read_msr(t, MSR_APERF, &t->aperf) == 0
+             && read_msr(t, MSR_MPERF, &t->mperf) == 0
+             && read_msr(t, MSR_TSC, &t->tsc) == 0;
+        t->t_ns = get_time_ns();
+    }
+}
+
+static void* worker_main(void *arg) {
+    int idx = (int)(long)arg;
+    unsigned long seen = 0;
+    int stop;
+
+    for (;;) {
+        pthread_mutex_lock(&pool_lock);
+        while (generation == seen && !stopping)
+            pthread_cond_wait(&start_cond, &pool_lock);
+        seen = generation;
+        stop = stopping;
+        pthread_mutex_unlock(&pool_lock);
+        if (stop)
+            break;
+
+        read_slice(idx * thread_count / worker_count, (idx + 1) * thread_count / worker_count);
+
+        pthread_mutex_lock(&pool_lock);
+        if (--pending == 0)
+            pthread_cond_signal(&done_cond);
+        pthread_mutex_unlock(&pool_lock);
+    }
+    return NULL;
+}
+
+//Returns the number of CPUs with a readable msr file
+int msr_open(const char *root, system_info *sysinfo) {
+    system_info topo;
+    char path[PATH_MAX];
+    unsigned long long v;
+    struct stat st;
+    msr_thread *t;
+    int cpu, fd, i, ncpus, *cpumap;
+
+    if (!root) root = "";
+    memset(&topo, 0, sizeof(topo));
+    if (!sysinfo || *root)
+        sysinfo = &topo;
+    if (!sysinfo->cpumap && get_cpu_topology_map_at(sysinfo, root) != 0)
+        return 0;
+    ncpus = sysinfo->cpumap_count;
+    cpumap = sysinfo->cpumap;
+
+    threads = calloc(ncpus, sizeof(msr_thread));
+    if (!threads) {
+        if (sysinfo == &topo)
+            free(topo.cpumap);
+        return 0;
+    }
+    for (cpu = 0; cpu < ncpus; cpu++) {
+        snprintf(path, sizeof(path), "%s/dev/cpu/%d/msr", root, cpu);
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        t = &threads[thread_count];
+        t->fd = fd;
+        t->stride = fstat(fd, &st) == 0 && S_ISREG(st.st_mode) ? 8 : 1;
+        if (read_msr(t, MSR_APERF, &v) != 0) {
+            close(fd);
+            continue;
+        }
+        t->cpu = cpu;
+        t->core = cpumap[cpu];
+        t->mhz = t->eff_mhz = t->c0 = NAN;
+        for (i = 0; i < thread_count; i++) {
+            if (threads[i].core >= 0 && threads[i].core == t->core)
+                t->thread++;
+        }
+        thread_count++;
+    }
+    if (sysinfo == &topo)
+        free(topo.cpumap);
+    if (!thread_count) {
+        free(threads);
+        threads = NULL;
+        return 0;
+    }
+
+    worker_count = thread_count / MSR_CPUS_PER_WORKER;
+    if (worker_count > MSR_MAX_WORKERS) worker_count = MSR_MAX_WORKERS;
+    if (worker_count < 2) worker_count = 0;
+    stopping = 0;
+    for (i = 0; i < worker_count; i++) {
+        if (pthread_create(&workers[i], NULL, worker_main, (void *)(long)i) != 0) {
+            //Fewer workers than planned, none at all reads inline
+            worker_count = i;
+            break;
+        }
+    }
+    return thread_count;
+}
+
+int msr_sample() {
+    double dt, tsc_mhz;
+    msr_thread *t;
+    int i;
+
+    if (!thread_count)
+        return -1;
+
+    if (worker_count) {
+        pthread_mutex_lock(&pool_lock);
+        pending = worker_count;
+        generation++;
+        pthread_cond_broadcast(&start_cond);
+        while (pending)
+            pthread_cond_wait(&done_cond, &pool_lock);
+        pthread_mutex_unlock(&pool_lock);
+    } else {
+        read_slice(0, thread_count);
+    }
+
+    for (i = 0; i < thread_count; i++) {
+        t = &threads[i];
+        if (!t->ok) {
+            t->have_last = 0;
+            t->mhz = t->eff_mhz = t->c0 = NAN;
+            continue;
+        }
+        //Counters are 64 bit, unsigned differences survive a wrap
+        if (t->have_last && t->tsc != t->last_tsc && t->t_ns > t->last_t_ns) {
+            //MPERF and TSC both tick at the TSC rate, measured against the clock
+            dt = (double)(t->tsc - t->last_tsc);
+            tsc_mhz = dt * 1000.0 / (t->t_ns - t->last_t_ns);
+            t->c0 = (t->mperf - t->last_mperf) * 100.0 / dt;
+            t->eff_mhz = tsc_mhz * (t->aperf - t->last_aperf) / dt;
+            t->mhz = t->mperf != t->last_mperf ? tsc_mhz * (t->aperf - t->last_aperf) / (t->mperf - t->last_mperf) : 0;
+        }
+        t->last_aperf = t->aperf;
+        t->last_mperf = t->mperf;
+        t->last_tsc = t->tsc;
+        t->last_t_ns = t->t_ns;
+        t->have_last = 1;
+    }
+    return 0;
+}
+
+int msr_count() {
+    return thread_count;
+}
+
+msr_thread* msr_get(int i) {
+    return &threads[i];
+}
+
+void msr_close() {
+    int i;
+
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&pool_lock);
+    for (i = 0; i < worker_count; i++)
+        pthread_join(workers[i], NULL);
+    worker_count = 0;
+
+    for (i = 0; i < thread_count; i++)
+        close(threads[i].fd);
+    free(threads);
+    threads = NULL;
+    thread_count = 0;
+}
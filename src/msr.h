@@ -0,0 +1,52 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef MSR_H
+#define MSR_H
+
+#include "readinfo.h"
+
+#define MSR_TSC             0x10
+#define MSR_MPERF           0xE7
+#define MSR_APERF           0xE8
+#define MSR_MAX_WORKERS     4
+#define MSR_CPUS_PER_WORKER 16      //Below this a worker isn't worth the wakeup
+
+typedef struct {
+    int cpu;
+    int core;                   //PM table core from the topology map, -1 if unknown
+    int thread;                 //Sibling index within the core, lowest CPU first
+    int fd;
+    int stride;                 //Bytes per register number, 8 for a plain file standing in for the device
+    unsigned long long aperf, mperf, tsc;
+    unsigned long long last_aperf, last_mperf, last_tsc;
+    unsigned long long t_ns, last_t_ns;     //Right after the reads
+    int ok, have_last;
+    float mhz;                  //Average frequency while in C0
+    float eff_mhz;              //Over the whole interval, comparable to CORE_FREQEFF
+    float c0;                   //% of the interval in C0
+} msr_thread;
+
+int msr_open(const char *root, system_info *sysinfo);
+int msr_sample();
+int msr_count();
+msr_thread* msr_get(int i);
+void msr_close();
+
+#endif
@@ -0,0 +1,389 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Name and location of every PM table field, so fields can be looked up by
+ * the name they have in pm_tables.h. Keep in the same order as pm_table.
+ **/
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include "pmt_fields.h"
+
+#define PMT_FIELD(name)         { #name, offsetof(pm_table, name), 1 }
+#define PMT_ARRAY(name, count)  { #name, offsetof(pm_table, name), count }
+
+static const pmt_field fields[] = {
+    PMT_FIELD(STAPM_LIMIT),
+    PMT_FIELD(STAPM_VALUE),
+    PMT_FIELD(PPT_LIMIT),
+    PMT_FIELD(PPT_VALUE),
+    PMT_FIELD(PPT_LIMIT_FAST),
+    PMT_FIELD(PPT_VALUE_FAST),
+    PMT_FIELD(PPT_LIMIT_APU),
+    PMT_FIELD(PPT_VALUE_APU),
+    PMT_FIELD(TDC_LIMIT),
+    PMT_FIELD(TDC_VALUE),
+    PMT_FIELD(TDC_LIMIT_SOC),
+    PMT_FIELD(TDC_VALUE_SOC),
+    PMT_FIELD(THM_LIMIT),
+    PMT_FIELD(THM_VALUE),
+    PMT_ARRAY(THM_VALUE_CORES, PMT_MAX_NUM_CORES),
+    PMT_FIELD(THM_LIMIT_SOC),
+    PMT_FIELD(THM_VALUE_SOC),
+    PMT_FIELD(THM_LIMIT_GFX),
+    PMT_FIELD(THM_VALUE_GFX),
+    PMT_FIELD(STT_LIMIT_APU),
+    PMT_FIELD(STT_VALUE_APU),
+    PMT_FIELD(STT_LIMIT_DGPU),
+    PMT_FIELD(STT_VALUE_DGPU),
+    PMT_FIELD(FIT_LIMIT),
+    PMT_FIELD(FIT_VALUE),
+    PMT_FIELD(EDC_LIMIT),
+    PMT_FIELD(EDC_VALUE),
+    PMT_FIELD(EDC_LIMIT_SOC),
+    PMT_FIELD(EDC_VALUE_SOC),
+    PMT_FIELD(VID_LIMIT),
+    PMT_FIELD(VID_VALUE),
+    PMT_FIELD(PSI0_LIMIT_VDD),
+    PMT_FIELD(PSI0_RESIDENCY_VDD),
+    PMT_FIELD(PSI0_LIMIT_SOC),
+    PMT_FIELD(PSI0_RESIDENCY_SOC),
+    PMT_FIELD(PPT_WC),
+    PMT_FIELD(PPT_ACTUAL),
+    PMT_FIELD(TDC_WC),
+    PMT_FIELD(TDC_ACTUAL),
+    PMT_FIELD(THM_WC),
+    PMT_FIELD(THM_ACTUAL),
+    PMT_FIELD(FIT_WC),
+    PMT_FIELD(FIT_ACTUAL),
+    PMT_FIELD(EDC_WC),
+    PMT_FIELD(EDC_ACTUAL),
+    PMT_FIELD(VID_WC),
+    PMT_FIELD(VID_ACTUAL),
+    PMT_FIELD(VDDCR_CPU_POWER),
+    PMT_FIELD(VDDCR_SOC_POWER),
+    PMT_FIELD(VDDIO_MEM_POWER),
+    PMT_FIELD(VDD18_POWER),
+    PMT_FIELD(ROC_POWER),
+    PMT_FIELD(SOCKET_POWER),
+    PMT_FIELD(CCLK_GLOBAL_FREQ),
+    PMT_FIELD(GLOB_FREQUENCY),
+    PMT_FIELD(STAPM_FREQUENCY),
+    PMT_FIELD(PPT_FREQUENCY),
+    PMT_FIELD(PPT_FREQUENCY_FAST),
+    PMT_FIELD(PPT_FREQUENCY_APU),
+    PMT_FIELD(TDC_FREQUENCY),
+    PMT_FIELD(THM_FREQUENCY),
+    PMT_FIELD(HTFMAX_FREQUENCY),
+    PMT_FIELD(PROCHOT_FREQUENCY),
+    PMT_FIELD(VOLTAGE_FREQUENCY),
+    PMT_FIELD(CCA_FREQUENCY),
+    PMT_FIELD(FIT_VOLTAGE),
+    PMT_FIELD(FIT_PRE_VOLTAGE),
+    PMT_FIELD(LATCHUP_VOLTAGE),
+    PMT_FIELD(CPU_SET_VOLTAGE),
+    PMT_FIELD(CPU_TELEMETRY_VOLTAGE),
+    PMT_FIELD(CPU_TELEMETRY_VOLTAGE2),
+    PMT_FIELD(CPU_TELEMETRY_CURRENT),
+    PMT_FIELD(CPU_TELEMETRY_POWER),
+    PMT_FIELD(SOC_SET_VOLTAGE),
+    PMT_FIELD(SOC_TELEMETRY_VOLTAGE),
+    PMT_FIELD(SOC_TELEMETRY_CURRENT),
+    PMT_FIELD(SOC_TELEMETRY_POWER),
+    PMT_FIELD(FCLK_FREQ),
+    PMT_FIELD(FCLK_FREQ_EFF),
+    PMT_FIELD(UCLK_FREQ),
+    PMT_FIELD(UCLK_FREQ_EFF),
+    PMT_FIELD(MEMCLK_FREQ),
+    PMT_FIELD(MEMCLK_FREQ_EFF),
+    PMT_FIELD(FCLK_DRAM_SETPOINT),
+    PMT_FIELD(FCLK_DRAM_BUSY),
+    PMT_FIELD(FCLK_GMI_SETPOINT),
+    PMT_FIELD(FCLK_GMI_BUSY),
+    PMT_FIELD(FCLK_IOHC_SETPOINT),
+    PMT_FIELD(FCLK_IOHC_BUSY),
+    PMT_FIELD(FCLK_MEM_LATENCY_SETPOINT),
+    PMT_FIELD(FCLK_MEM_LATENCY),
+    PMT_FIELD(FCLK_CCLK_SETPOINT),
+    PMT_FIELD(FCLK_CCLK_FREQ),
+    PMT_FIELD(FCLK_XGMI_SETPOINT),
+    PMT_FIELD(FCLK_XGMI_BUSY),
+    PMT_FIELD(FCLK_GFX_SETPOINT),
+    PMT_FIELD(FCLK_GFX_BUSY),
+    PMT_FIELD(CCM_READS),
+    PMT_FIELD(CCM_WRITES),
+    PMT_FIELD(IOMS),
+    PMT_FIELD(XGMI),
+    PMT_FIELD(CS_UMC_READS),
+    PMT_FIELD(CS_UMC_WRITES),
+    PMT_ARRAY(FCLK_RESIDENCY, 4),
+    PMT_ARRAY(FCLK_FREQ_TABLE, 4),
+    PMT_ARRAY(UCLK_FREQ_TABLE, 4),
+    PMT_ARRAY(MEMCLK_FREQ_TABLE, 4),
+    PMT_ARRAY(FCLK_VOLTAGE, 4),
+    PMT_ARRAY(LCLK_SETPOINT, 4),
+    PMT_ARRAY(LCLK_BUSY, 4),
+    PMT_ARRAY(LCLK_FREQ, 4),
+    PMT_ARRAY(LCLK_FREQ_EFF, 4),
+    PMT_ARRAY(LCLK_MAX_DPM, 4),
+    PMT_ARRAY(LCLK_MIN_DPM, 4),
+    PMT_ARRAY(SOCCLK_FREQ_EFF, 4),
+    PMT_ARRAY(SHUBCLK_FREQ_EFF, 4),
+    PMT_FIELD(XGMI_SETPOINT),
+    PMT_FIELD(XGMI_BUSY),
+    PMT_FIELD(XGMI_LANE_WIDTH),
+    PMT_FIELD(XGMI_DATA_RATE),
+    PMT_FIELD(SOC_POWER),
+    PMT_FIELD(SOC_TEMP),
+    PMT_FIELD(DDR_VDDP_POWER),
+    PMT_FIELD(DDR_VDDIO_MEM_POWER),
+    PMT_FIELD(GMI2_VDDG_POWER),
+    PMT_FIELD(IO_VDDCR_SOC_POWER),
+    PMT_FIELD(IOD_VDDIO_MEM_POWER),
+    PMT_FIELD(IO_VDD18_POWER),
+    PMT_FIELD(TDP),
+    PMT_FIELD(DETERMINISM),
+    PMT_FIELD(P_VDDM),
+    PMT_FIELD(V_VDDM),
+    PMT_FIELD(V_VDDP),
+    PMT_FIELD(V_VDDG),
+    PMT_FIELD(V_VDDG_IOD),
+    PMT_FIELD(V_VDDG_CCD),
+    PMT_FIELD(SKIN_TEMP_MARGIN),
+    PMT_FIELD(PEAK_TEMP),
+    PMT_FIELD(PEAK_VOLTAGE),
+    PMT_FIELD(PEAK_CCLK_FREQ),
+    PMT_FIELD(unk_power),
+    PMT_FIELD(AVG_CORE_COUNT),
+    PMT_FIELD(CCLK_LIMIT),
+    PMT_FIELD(MAX_SOC_VOLTAGE),
+    PMT_FIELD(DVO_VOLTAGE),
+    PMT_FIELD(APML_POWER),
+    PMT_FIELD(CPU_DC_BTC),
+    PMT_FIELD(SOC_DC_BTC),
+    PMT_FIELD(DC_BTC),
+    PMT_FIELD(PACKAGE_POWER),
+    PMT_FIELD(CSTATE_BOOST),
+    PMT_FIELD(PROCHOT),
+    PMT_FIELD(PC6),
+    PMT_FIELD(SELF_REFRESH),
+    PMT_FIELD(PWM),
+    PMT_FIELD(SOCCLK),
+    PMT_FIELD(SHUBCLK),
+    PMT_FIELD(SMNCLK),
+    PMT_FIELD(SMNCLK_EFF),
+    PMT_FIELD(MP0CLK),
+    PMT_FIELD(MP0CLK_EFF),
+    PMT_FIELD(MP1CLK),
+    PMT_FIELD(MP1CLK_EFF),
+    PMT_FIELD(MP2CLK),
+    PMT_FIELD(MP2CLK_EFF),
+    PMT_FIELD(MP5CLK),
+    PMT_FIELD(TWIXCLK),
+    PMT_FIELD(WAFLCLK),
+    PMT_FIELD(DPM_BUSY),
+    PMT_FIELD(MP1_BUSY),
+    PMT_FIELD(DPM_Skipped),
+    PMT_FIELD(CORE_SETPOINT),
+    PMT_FIELD(CORE_BUSY),
+    PMT_ARRAY(CORE_POWER, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_VOLTAGE, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_TEMP, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_FIT, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_IDDMAX, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_FREQ, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_FREQEFF, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_C0, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CC1, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CC6, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CKS_FDD, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CI_FDD, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_IRM, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_PSTATE, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_FREQ_LIM_MAX, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_FREQ_LIM_MIN, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CPPC_MAX, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CPPC_MIN, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_CPPC_EPP, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_unk, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_SC_LIMIT, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_SC_CAC, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_SC_RESIDENCY, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_UOPS_CLK, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_UOPS, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(CORE_MEM_LATECY, PMT_MAX_NUM_CORES),
+    PMT_ARRAY(L3_LOGIC_POWER, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_VDDM_POWER, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_TEMP, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_FIT, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_IDDMAX, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_FREQ, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_FREQ_EFF, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_CKS_FDD, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_CCA_THRESHOLD, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_CCA_CAC, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_CCA_ACTIVATION, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_EDC_LIMIT, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_EDC_CAC, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_EDC_RESIDENCY, PMT_MAX_NUM_L3),
+    PMT_ARRAY(L3_FLL_BTC, PMT_MAX_NUM_L3),
+    PMT_ARRAY(MP5_BUSY, PMT_MAX_NUM_L3),
+    PMT_FIELD(GFX_GLOB_FREQUENCY),
+    PMT_FIELD(GFX_STAPM_FREQUENCY),
+    PMT_FIELD(GFX_PPT_FREQUENCY_FAST),
+    PMT_FIELD(GFX_PPT_FREQUENCY),
+    PMT_FIELD(GFX_PPT_FREQUENCY_APU),
+    PMT_FIELD(GFX_TDC_FREQUENCY),
+    PMT_FIELD(GFX_THM_FREQUENCY),
+    PMT_FIELD(GFX_HTFMAX_FREQUENCY),
+    PMT_FIELD(GFX_PROCHOT_FREQUENCY),
+    PMT_FIELD(GFX_VOLTAGE_FREQUENCY),
+    PMT_FIELD(GFX_CCA_FREQUENCY),
+    PMT_FIELD(GFX_DEM_FREQUENCY),
+    PMT_FIELD(GFX_VOLTAGE),
+    PMT_FIELD(GFX_TEMP),
+    PMT_FIELD(GFX_IDDMAX),
+    PMT_FIELD(GFX_FREQ),
+    PMT_FIELD(GFX_FREQEFF),
+    PMT_FIELD(GFX_SETPOINT),
+    PMT_FIELD(GFX_BUSY),
+    PMT_FIELD(GFX_CGPG),
+    PMT_FIELD(GFX_EDC_LIM),
+    PMT_FIELD(GFX_EDC_RESIDENCY),
+    PMT_FIELD(GFX_DEM_RESIDENCY),
+    PMT_FIELD(GFX_DUTY),
+    PMT_FIELD(DF_BUSY),
+    PMT_FIELD(IOHC_BUSY),
+    PMT_FIELD(MMHUB_BUSY),
+    PMT_FIELD(ATHUB_BUSY),
+    PMT_FIELD(OSSSYS_BUSY),
+    PMT_FIELD(HDP_BUSY),
+    PMT_FIELD(SDMA_BUSY),
+    PMT_FIELD(SHUB_BUSY),
+    PMT_FIELD(BIF_BUSY),
+    PMT_FIELD(ACP_BUSY),
+    PMT_FIELD(SST0_BUSY),
+    PMT_FIELD(SST1_BUSY),
+    PMT_FIELD(USB0_BUSY),
+    PMT_FIELD(USB1_BUSY),
+    PMT_FIELD(GCM_64B_READS),
+    PMT_FIELD(GCM_64B_WRITES),
+    PMT_FIELD(GCM_32B_READS_WRITES),
+    PMT_FIELD(MMHUB_READS),
+    PMT_FIELD(MMHUB_WRITES),
+    PMT_FIELD(DCE_READS),
+    PMT_FIELD(IO_READS_WRITES),
+    PMT_FIELD(MAX_DRAM_BANDWIDTH),
+    PMT_FIELD(VCN_BUSY),
+    PMT_FIELD(VCN_DECODE),
+    PMT_FIELD(VCN_ENCODE_GEN),
+    PMT_FIELD(VCN_ENCODE_LOW),
+    PMT_FIELD(VCN_ENCODE_REAL),
+    PMT_FIELD(VCN_PG),
+    PMT_FIELD(VCN_JPEG),
+    PMT_FIELD(VCLK_FREQ),
+    PMT_FIELD(VCLK_FREQ_EFF),
+    PMT_FIELD(DCLK_FREQ),
+    PMT_FIELD(DCLK_FREQ_EFF),
+    PMT_FIELD(DCF_FREQ),
+    PMT_FIELD(DCF_FREQ_EFF),
+    PMT_ARRAY(VCLK_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(DCLK_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(SOCCLK_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(LCLK_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(SHUB_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(MP0_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(DCFCLK_STATE, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(VCN_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(SOCCLK_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(LCLK_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(SHUB_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(MP0CLK_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(DCFCLK_STATE_RESIDENCY, PMT_MAX_NUM_CLKS),
+    PMT_ARRAY(VDDCR_SOC_VOLTAGE, PMT_MAX_NUM_CLKS),
+    PMT_FIELD(CPUOFF),
+    PMT_FIELD(CPUOFF_CNT),
+    PMT_FIELD(GFXOFF),
+    PMT_FIELD(GFXOFF_CNT),
+    PMT_FIELD(VDDOFF),
+    PMT_FIELD(VDDOFF_CNT),
+    PMT_FIELD(ULV),
+    PMT_FIELD(ULV_CNT),
+    PMT_FIELD(ULV_VOLTAGE),
+    PMT_FIELD(S0i2),
+    PMT_FIELD(S0i2_CNT),
+    PMT_FIELD(WHISPER),
+    PMT_FIELD(WHISPER_CNT),
+    PMT_FIELD(SELFREFRESH0),
+    PMT_FIELD(SELFREFRESH1),
+    PMT_FIELD(PLL_POWERDOWN_0),
+    PMT_FIELD(PLL_POWERDOWN_1),
+    PMT_FIELD(PLL_POWERDOWN_2),
+    PMT_FIELD(PLL_POWERDOWN_3),
+    PMT_FIELD(PLL_POWERDOWN_4),
+    PMT_FIELD(DGPU_POWER),
+    PMT_FIELD(DGPU_GFX_BUSY),
+    PMT_FIELD(DGPU_FREQ_TARGET),
+    PMT_FIELD(DISPLAY_COUNT),
+    PMT_FIELD(FPS),
+    PMT_FIELD(IO_DISPLAY_POWER),
+    PMT_FIELD(IO_USB_POWER),
+    PMT_FIELD(DDR_PHY_POWER),
+    PMT_FIELD(MAX_CORE_VOLTAGE),
+    PMT_FIELD(StapmTimeConstant),
+    PMT_FIELD(SlowPPTTimeConstant),
+    PMT_FIELD(ACLK),
+    PMT_FIELD(DISPCLK),
+    PMT_FIELD(DPREFCLK),
+    PMT_FIELD(DPPCLK),
+    PMT_FIELD(SMU_BUSY),
+    PMT_FIELD(SMU_SKIP_COUNTER),
+};
+
+int pmt_field_count() {
+    return sizeof(fields) / sizeof(fields[0]);
+}
+
+const pmt_field* pmt_field_at(int i) {
+    return i >= 0 && i < pmt_field_count() ? &fields[i] : NULL;
+}
+
+const pmt_field* pmt_field_find(const char *name, size_t len) {
+    size_t i;
+
+    for (i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (strlen(fields[i].name) == len && !strncmp(fields[i].name, name, len))
+            return &fields[i];
+    }
+    return NULL;
+}
+
+float* pmt_field_ptr(pm_table *pmt, const pmt_field *field, int index) {
+    if (index < 0 || index >= field->count)
+        return NULL;
+    return ((float **)((char *)pmt + field->offset))[index];
+}
+
+float pmt_field_value(pm_table *pmt, const pmt_field *field, int index) {
+    float *p = pmt_field_ptr(pmt, field, index);
+
+    return p ? *p : NAN;
+}
@@ -0,0 +1,38 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PMT_FIELDS_H
+#define PMT_FIELDS_H
+
+#include <stddef.h>
+#include "pm_tables.h"
+
+typedef struct {
+    const char *name;       //As in pm_tables.h
+    size_t offset;          //Of the first float pointer in pm_table
+    int count;              //1, or the length of a per core, L3 or clock array
+} pmt_field;
+
+int pmt_field_count();
+const pmt_field* pmt_field_at(int i);
+const pmt_field* pmt_field_find(const char *name, size_t len);
+float* pmt_field_ptr(pm_table *pmt, const pmt_field *field, int index);
+float pmt_field_value(pm_table *pmt, const pmt_field *field, int index);
+
+#endif
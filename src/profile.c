@@ -0,0 +1,365 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Tuning profiles.
+ *
+ * A profile is a text file of "key = value" lines, # starts a comment:
+ *
+ *   ppt = 142        PPT limit (W)
+ *   tdc = 95         TDC limit (A)
+ *   edc = 140        EDC limit (A)
+ *   thm = 90         Thermal limit (C)
+ *   scalar = 10      PBO scalar
+ *   oc-mode = 1      1 enables, 0 disables OC mode
+ *   co.3 = -15       CO count of core 3, the physical PM table index
+ *   co-all = -10     CO count of every enabled core, co.N lines win
+ *
+ * Applying it is a transaction: the current value of every key in the
+ * profile is read first, all the commands go out as one SMU batch and the
+ * limits are checked with a single PM table read afterwards. Scalar and CO
+ * counts are read back from the SMU. If a command fails or a value doesn't
+ * stick, the values read at start are sent back the same way.
+ *
+ * co.N uses the physical core index like the PM table, --co-sweep and
+ * core_disable_map, and is translated to the logical (enabled) index the
+ * CO commands take only when the command is sent.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "setinfo.h"
+#include "profile.h"
+
+extern smu_obj_t obj;
+extern int debuglog;
+extern const int TEST_INT;
+
+#define PROFILE_LIMIT_TOLERANCE 1   //PM table limits are floats, allow for rounding
+
+static const char *limit_keys[] = { "ppt", "tdc", "edc", "thm" };
+
+static int *limit_field(tuning_profile *p, int i) {
+    switch (i) {
+        case 0:     return &p->ppt;
+        case 1:     return &p->tdc;
+        case 2:     return &p->edc;
+        default:    return &p->thm;
+    }
+}
+
+void profile_init(tuning_profile *p) {
+    int i;
+
+    p->ppt = p->tdc = p->edc = p->thm = PROFILE_UNSET;
+    p->scalar = PROFILE_UNSET;
+    p->oc_mode = PROFILE_UNSET;
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++)
+        p->co[i] = PROFILE_UNSET;
+}
+
+static char* trim(char *s) {
+    char *end;
+
+    while (isspace((unsigned char)*s)) s++;
+    end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) end--;
+    *end = '\0';
+    return s;
+}
+
+int profile_load(const char *path, system_info *sysinfo, tuning_profile *p) {
+    int co_all = PROFILE_UNSET, co_set[PMT_MAX_NUM_CORES] = { 0 };
+    char line[256], *key, *val, *eq, *end;
+    int lineno = 0, i, err = 0;
+    long num, core;
+    FILE *fp;
+
+    profile_init(p);
+    if (!(fp = fopen(path, "r"))) {
+        fprintf(stderr, "profile: can't open %s\n", path);
+        return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        if ((end = strchr(line, '#')))
+            *end = '\0';
+        key = trim(line);
+        if (!*key)
+            continue;
+
+        if (!(eq = strchr(key, '='))) {
+            fprintf(stderr, "profile: %s:%d: expected key = value\n", path, lineno);
+            err = -1;
+            continue;
+        }
+        *eq = '\0';
+        key = trim(key);
+        val = trim(eq + 1);
+        num = strtol(val, &end, 10);
+        if (end == val || *end) {
+            fprintf(stderr, "profile: %s:%d: \"%s\" is not a number\n", path, lineno, val);
+            err = -1;
+            continue;
+        }
+
+        for (i = 0; i < 4; i++) {
+            if (!strcmp(key, limit_keys[i]))
+                break;
+        }
+        if (i < 4) {
+            if (num <= 0 || num >= TEST_INT) {
+                fprintf(stderr, "profile: %s:%d: %s out of range\n", path, lineno, key);
+                err = -1;
+            } else {
+                *limit_field(p, i) = (int)num;
+            }
+        } else if (!strcmp(key, "scalar")) {
+            if (num < 1 || num > 10) {
+                fprintf(stderr, "profile: %s:%d: scalar must be 1-10\n", path, lineno);
+                err = -1;
+            } else {
+                p->scalar = (int)num;
+            }
+        } else if (!strcmp(key, "oc-mode")) {
+            p->oc_mode = num ? 1 : 0;
+        } else if (!strcmp(key, "co-all") || !strncmp(key, "co.", 3)) {
+            if (num < -30 || num > 30) {
+                fprintf(stderr, "profile: %s:%d: CO count must be -30 to +30\n", path, lineno);
+                err = -1;
+                continue;
+            }
+            if (key[2] == '-') {
+                co_all = (int)num;
+                continue;
+            }
+            core = strtol(key + 3, &end, 10);
+            if (end == key + 3 || *end || core < 0 || core >= physical_core_count(NULL, sysinfo) ||
+                core_logical_index(sysinfo, (int)core) < 0) {
+                fprintf(stderr, "profile: %s:%d: invalid or disabled core in \"%s\"\n", path, lineno, key);
+                err = -1;
+                continue;
+            }
+            p->co[core] = (int)num;
+            co_set[core] = 1;
+        } else {
+            fprintf(stderr, "profile: %s:%d: unknown key \"%s\"\n", path, lineno, key);
+            err = -1;
+        }
+    }
+    fclose(fp);
+
+    if (co_all != PROFILE_UNSET) {
+        for (i = 0; i < physical_core_count(NULL, sysinfo); i++) {
+            if (!co_set[i] && core_logical_index(sysinfo, i) >= 0)
+                p->co[i] = co_all;
+        }
+    }
+    return err;
+}
+
+//Every key in the profile must be settable before anything is touched
+static int profile_supported(pm_table *pmt, system_info *sysinfo, tuning_profile *p) {
+    int i, err = 0;
+
+    if ((p->ppt != PROFILE_UNSET && (!pmt->PPT_LIMIT || op_set_ppt(sysinfo, TEST_INT) != 0)) ||
+        (p->tdc != PROFILE_UNSET && (!pmt->TDC_LIMIT || op_set_tdc(sysinfo, TEST_INT) != 0)) ||
+        (p->edc != PROFILE_UNSET && (!pmt->EDC_LIMIT || op_set_edc(sysinfo, TEST_INT) != 0)) ||
+        (p->thm != PROFILE_UNSET && (!pmt->THM_LIMIT || op_set_thm(sysinfo, TEST_INT) != 0))) {
+        fprintf(stderr, "profile: limits can't be set or read back on this processor\n");
+        err = -100;
+    }
+    if ((p->scalar != PROFILE_UNSET || p->oc_mode != PROFILE_UNSET) && op_set_scalar(sysinfo, TEST_INT) != 0) {
+        fprintf(stderr, "profile: scalar and OC mode are not available on this processor\n");
+        err = -100;
+    }
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if (p->co[i] != PROFILE_UNSET && op_set_cocount(sysinfo, core_logical_index(sysinfo, i), TEST_INT) != 0) {
+            fprintf(stderr, "profile: Curve Optimizer is not available on this processor\n");
+            err = -100;
+            break;
+        }
+    }
+    return err;
+}
+
+//Current value of every key set in the profile, left unset otherwise
+static int profile_snapshot(pm_table *pmt, system_info *sysinfo, tuning_profile *p, tuning_profile *snap) {
+    int i, scalar = 0;
+
+    profile_init(snap);
+    if (p->ppt != PROFILE_UNSET) snap->ppt = op_get_ppt(pmt);
+    if (p->tdc != PROFILE_UNSET) snap->tdc = op_get_tdc(pmt);
+    if (p->edc != PROFILE_UNSET) snap->edc = op_get_edc(pmt);
+    if (p->thm != PROFILE_UNSET) snap->thm = op_get_thm(pmt);
+
+    if (p->scalar != PROFILE_UNSET || p->oc_mode != PROFILE_UNSET) {
+        if ((scalar = op_get_scalar(sysinfo)) <= -100)
+            return -1;
+        if (p->scalar != PROFILE_UNSET) snap->scalar = scalar;
+        //Same reading as get-ocmode, the scalar reads 0 in OC mode
+        if (p->oc_mode != PROFILE_UNSET) snap->oc_mode = scalar != 0 ? 0 : 1;
+    }
+
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if (p->co[i] == PROFILE_UNSET)
+            continue;
+        if ((snap->co[i] = op_get_cocount(sysinfo, core_logical_index(sysinfo, i), 1)) <= -100)
+            return -1;
+    }
+    return 0;
+}
+
+//Records the commands for p in the same order as the command line: OC mode on first, off last
+static int profile_build(system_info *sysinfo, tuning_profile *p, smu_batch *batch) {
+    int i, err = 0;
+
+    smu_batch_init(batch);
+    smu_batch_record(batch);
+
+    if (p->oc_mode == 1 && op_set_enable_oc(sysinfo) <= -100) err = -1;
+    if (p->ppt != PROFILE_UNSET && op_set_ppt(sysinfo, p->ppt) <= -100) err = -1;
+    if (p->tdc != PROFILE_UNSET && op_set_tdc(sysinfo, p->tdc) <= -100) err = -1;
+    if (p->edc != PROFILE_UNSET && op_set_edc(sysinfo, p->edc) <= -100) err = -1;
+    if (p->thm != PROFILE_UNSET && op_set_thm(sysinfo, p->thm) <= -100) err = -1;
+    if (p->scalar != PROFILE_UNSET && op_set_scalar(sysinfo, p->scalar) <= -100) err = -1;
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if (p->co[i] != PROFILE_UNSET && op_set_cocount(sysinfo, core_logical_index(sysinfo, i), p->co[i]) <= -100) err = -1;
+    }
+    if (p->oc_mode == 0 && op_set_disable_oc(sysinfo) <= -100) err = -1;
+
+    smu_batch_record(NULL);
+    return err;
+}
+
+static int check_value(const char *key, int want, int got, int tolerance) {
+    if (want == PROFILE_UNSET || abs(want - got) <= tolerance)
+        return 0;
+    fprintf(stderr, "profile: %s is %d after apply, expected %d\n", key, got, want);
+    return 1;
+}
+
+//Single PM table read for the limits, scalar and CO counts come from the SMU
+static int profile_verify(pm_table *pmt, system_info *sysinfo, unsigned char *pm_buf, tuning_profile *p) {
+    char key[16];
+    int i, scalar, mismatch = 0;
+
+    if (p->ppt != PROFILE_UNSET || p->tdc != PROFILE_UNSET || p->edc != PROFILE_UNSET || p->thm != PROFILE_UNSET) {
+        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK) {
+            fprintf(stderr, "profile: can't read the PM table to verify\n");
+            return 1;
+        }
+        for (i = 0; i < 4; i++) {
+            if (*limit_field(p, i) == PROFILE_UNSET)
+                continue;
+            mismatch += check_value(limit_keys[i], *limit_field(p, i),
+                i == 0 ? op_get_ppt(pmt) : i == 1 ? op_get_tdc(pmt) : i == 2 ? op_get_edc(pmt) : op_get_thm(pmt),
+                PROFILE_LIMIT_TOLERANCE);
+        }
+    }
+
+    if (p->scalar != PROFILE_UNSET || p->oc_mode != PROFILE_UNSET) {
+        scalar = op_get_scalar(sysinfo);
+        mismatch += check_value("scalar", p->scalar, scalar, 0);
+        //With a scalar in the profile OC mode can't be told from the read back
+        if (p->scalar == PROFILE_UNSET)
+            mismatch += check_value("oc-mode", p->oc_mode, scalar != 0 ? 0 : 1, 0);
+    }
+
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if (p->co[i] == PROFILE_UNSET)
+            continue;
+        snprintf(key, sizeof(key), "co.%d", i);
+        mismatch += check_value(key, p->co[i], op_get_cocount(sysinfo, core_logical_index(sysinfo, i), 1), 0);
+    }
+    return mismatch;
+}
+
+static void print_changes(tuning_profile *p, tuning_profile *snap) {
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if (*limit_field(p, i) != PROFILE_UNSET)
+            fprintf(stdout, "apply-profile: %s %i before: %i\n", limit_keys[i], *limit_field(p, i), *limit_field(snap, i));
+    }
+    if (p->scalar != PROFILE_UNSET)
+        fprintf(stdout, "apply-profile: scalar %i before: %i\n", p->scalar, snap->scalar);
+    if (p->oc_mode != PROFILE_UNSET)
+        fprintf(stdout, "apply-profile: oc-mode %i before: %i\n", p->oc_mode, snap->oc_mode);
+    for (i = 0; i < PMT_MAX_NUM_CORES; i++) {
+        if (p->co[i] != PROFILE_UNSET)
+            fprintf(stdout, "apply-profile: co.%i %+i before: %+i\n", i, p->co[i], snap->co[i]);
+    }
+}
+
+int profile_apply(pm_table *pmt, system_info *sysinfo, tuning_profile *p) {
+    tuning_profile snap;
+    smu_batch batch;
+    unsigned char *pm_buf;
+    int err = 0;
+
+    if (!smu_pm_tables_supported(&obj) || !pmt->zen_version) {
+        fprintf(stderr, "profile: the PM table is needed to snapshot and verify the limits\n");
+        return -1;
+    }
+    if ((err = profile_supported(pmt, sysinfo, p)) != 0)
+        return err;
+
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(obj.pm_table_version, pmt, pm_buf) ||
+        smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK ||
+        profile_snapshot(pmt, sysinfo, p, &snap) != 0) {
+        fprintf(stderr, "profile: can't read the current values, nothing changed\n");
+        free(pm_buf);
+        return -1;
+    }
+
+    if (profile_build(sysinfo, p, &batch) != 0) {
+        fprintf(stderr, "profile: can't build the command batch, nothing changed\n");
+        free(pm_buf);
+        return -1;
+    }
+
+    smu_batch_run(&batch);
+    if (debuglog)
+        fprintf(stderr, "profile: %d commands in %.3f ms, %d failed, %d retries\n",
+            batch.count, batch.latency_ns / 1e6, batch.failed, batch.retries);
+
+    if (batch.failed || profile_verify(pmt, sysinfo, pm_buf, p)) {
+        if (batch.failed)
+            fprintf(stderr, "profile: %d of %d commands failed\n", batch.failed, batch.count);
+        err = -200;
+        if (profile_build(sysinfo, &snap, &batch) != 0 || smu_batch_run(&batch) != 0 ||
+            profile_verify(pmt, sysinfo, pm_buf, &snap))
+            fprintf(stderr, "profile: rollback failed, check the current values\n");
+        else
+            fprintf(stderr, "profile: rolled back to the previous values\n");
+    } else {
+        print_changes(p, &snap);
+    }
+
+    free(pm_buf);
+    return err;
+}
@@ -0,0 +1,43 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <limits.h>
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define PROFILE_UNSET   INT_MIN     //Key not in the profile, left alone
+
+typedef struct {
+    int ppt;                //W
+    int tdc;                //A
+    int edc;                //A
+    int thm;                //C
+    int scalar;
+    int oc_mode;            //1 enables, 0 disables
+    int co[PMT_MAX_NUM_CORES];
+} tuning_profile;
+
+void profile_init(tuning_profile *p);
+int profile_load(const char *path, system_info *sysinfo, tuning_profile *p);
+int profile_apply(pm_table *pmt, system_info *sysinfo, tuning_profile *p);
+
+#endif
@@ -30,20 +30,18 @@
 #include <libsmu.h>
 #include <time.h>
 #include <errno.h>    
+#include <unistd.h>
+#include <limits.h>
 #include "readinfo.h"
 #include "commonfuncs.h"
 
-extern smu_obj_t obj;
+#define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
 
-#define READ_SMN_V1(offs) { if (smu_read_smn_addr(&obj, offs + offset, &value1) != SMU_Return_OK) goto _READ_ERROR; }
-#define READ_SMN_V2(offs) { if (smu_read_smn_addr(&obj, offs + offset, &value2) != SMU_Return_OK) goto _READ_ERROR; }
-#define SEND_CMD_RSMU(op) { if (smu_send_command(&obj, op, &args, TYPE_RSMU) != SMU_Return_OK) goto _SEND_ERROR; }
-#define SEND_CMD_MP1(op) { if (smu_send_command(&obj, op, &args, TYPE_MP1) != SMU_Return_OK) goto _SEND_ERROR; }
 
-const char* get_processor_name() {
+void read_processor_name(char *name, size_t len) {
     unsigned int eax, ebx, ecx, edx;
     int i;
-    static char buffer[50] = { 0 }, *p;
+    char buffer[50] = { 0 }, *p;
 
     i=0;
     __get_cpuid(0x80000002, &eax, &ebx, &ecx, &edx);
@@ -70,10 +68,18 @@ const char* get_processor_name() {
     while(isspace(p[i]) && i>=0) p[i--]=0;
     while(*p && isspace(*p)) p++;
 
-    return p;
+    snprintf(name, len, "%s", p);
+}
+
+const char* get_processor_name() {
+    static char name[50];
+
+    read_processor_name(name, sizeof(name));
+    return name;
 }
 
-void get_processor_topology(system_info *sysinfo, int debug_init) {
+//0 on success, negative when a fuse could not be read. fuses can be NULL.
+int read_processor_topology(smu_obj_t *smu, system_info *sysinfo, topology_fuses *fuses) {
     unsigned int ccds_present, ccds_down, ccd_enable_map, ccd_disable_map, ccx_per_ccd, ccd_offset = 0,
         core_disable_map_addr, core_disable_map_tmp, logical_cores, threads_per_core, physical_cores,
         fam, model, fuse1, fuse2, offs, eax, ebx, ecx, edx;
@@ -104,11 +110,9 @@ void get_processor_topology(system_info *sysinfo, int debug_init) {
         fuse2 += 0x40;
     }
 
-    if (smu_read_smn_addr(&obj, fuse1, &ccds_present) != SMU_Return_OK ||
-        smu_read_smn_addr(&obj, fuse2, &ccds_down) != SMU_Return_OK) {
-        perror("Failed to read CCD fuses");
-        exit(-1);
-    }
+    if (smu_read_smn_addr(smu, fuse1, &ccds_present) != SMU_Return_OK ||
+        smu_read_smn_addr(smu, fuse2, &ccds_down) != SMU_Return_OK)
+        return TOPOLOGY_ERR_CCD_FUSES;
 
     ccd_enable_map = (ccds_present >> 22) & 0xff;
     ccd_disable_map = ((ccds_down & 0x3f) << 2) | ((ccds_present >> 30) & 0x3);
@@ -121,10 +125,8 @@ void get_processor_topology(system_info *sysinfo, int debug_init) {
     sysinfo->ccxs = sysinfo->ccds * ccx_per_ccd;
     sysinfo->physical_cores = (sysinfo->ccxs * 8) / ccx_per_ccd;
 
-    if (smu_read_smn_addr(&obj, core_disable_map_addr, &core_disable_map_tmp) != SMU_Return_OK) {
-        perror("Failed to read disabled core fuse");
-        exit(-1);
-    }
+    if (smu_read_smn_addr(smu, core_disable_map_addr, &core_disable_map_tmp) != SMU_Return_OK)
+        return TOPOLOGY_ERR_CORE_FUSE;
 
     if (fam == 0x19 && model == 0x50) {
         sysinfo->core_disable_map = (core_disable_map_tmp >> 11) & 0xFF;
@@ -133,10 +135,8 @@ void get_processor_topology(system_info *sysinfo, int debug_init) {
         {
             if (ccd_enable_map & i)
             {
-                if (smu_read_smn_addr(&obj, core_disable_map_addr | ccd_offset, &core_disable_map_tmp) != SMU_Return_OK) {
-                    perror("Failed to read disabled core fuse for CCD");
-                    exit(-1);
-                }
+                if (smu_read_smn_addr(smu, core_disable_map_addr | ccd_offset, &core_disable_map_tmp) != SMU_Return_OK)
+                    return TOPOLOGY_ERR_CCD_CORE_FUSE;
                 sysinfo->core_disable_map |= (core_disable_map_tmp & 0xff) << i * 8;
             }
             ccd_offset += 0x2000000;
@@ -159,6 +159,8 @@ void get_processor_topology(system_info *sysinfo, int debug_init) {
     sysinfo->enabled_cores_count = sysinfo->physical_cores-count_set_bits(sysinfo->core_disable_map);
 
     sysinfo->coremap=(int *)malloc(sysinfo->cores * sizeof(int));
+    if (!sysinfo->coremap)
+        return TOPOLOGY_ERR_MEMORY;
     
     int c, cx = 0, core_disabled;
     
@@ -171,92 +173,110 @@ void get_processor_topology(system_info *sysinfo, int debug_init) {
         }
     } 
 
-    if (debug_init) {
-        fprintf(stdout, "\nFamily: 0x%X Model: 0x%X\n", sysinfo->family, sysinfo->model);
-        fprintf(stdout, "ccds: %i ccxs: %i cores: %i cores_per_ccx: %i enabled: %i\n", sysinfo->ccds, sysinfo->ccxs, sysinfo->cores, sysinfo->cores_per_ccx, sysinfo->enabled_cores_count);
-        fprintf(stdout, "core_disable_map: 0x%X tmp: 0x%X pmt: 0x%X core_disable_addr: 0x%X\n", sysinfo->core_disable_map, core_disable_map_tmp, sysinfo->core_disable_map_pmt, core_disable_map_addr);
-        fprintf(stdout, "ccds_present: 0x%X  ccds_down: 0x%X\n", ccds_present, ccds_down);
-        fprintf(stdout, "ccd_enable_map: 0x%X ccd_disable_map: 0x%X\n", ccd_enable_map, ccd_disable_map);
-        fprintf(stdout, "\n");
+    if (fuses) {
+        fuses->ccds_present = ccds_present;
+        fuses->ccds_down = ccds_down;
+        fuses->ccd_enable_map = ccd_enable_map;
+        fuses->ccd_disable_map = ccd_disable_map;
+        fuses->core_disable_map_addr = core_disable_map_addr;
+        fuses->core_disable_map_raw = core_disable_map_tmp;
     }
 
     sysinfo->available=1;
+    return 0;
+}
+
+//Physical core slots, the index space of core_disable_map and the PM table core arrays.
+//sysinfo->cores only counts the enabled cores.
+int physical_core_count(pm_table *pmt, system_info *sysinfo) {
+    int n = pmt && pmt->max_cores ? pmt->max_cores : (int)sysinfo->physical_cores;
+
+    if (n < (int)sysinfo->cores)
+        n = sysinfo->cores;
+    return n > PMT_MAX_NUM_CORES ? PMT_MAX_NUM_CORES : n;
 }
 
-void print_memory_timings() {
-    const char* bool_str[2] = { "Disabled", "Enabled" };
-    unsigned int value1, value2, offset;
-
-    READ_SMN_V1(0x50200);
-    offset = value1 == 0x300 ? 0x100000 : 0;
-
-    READ_SMN_V1(0x50050); READ_SMN_V2(0x50058);
-    fprintf(stdout, "BankGroupSwap: %s\n",
-        bool_str[!(value1 == value2 && value1 == 0x87654321)]);
-
-    READ_SMN_V1(0x500D0); READ_SMN_V2(0x500D4);
-    fprintf(stdout, "BankGroupSwapAlt: %s\n",
-        bool_str[(value1 >> 4 & 0x7F) != 0 || (value2 >> 4 & 0x7F) != 0]);
-
-    READ_SMN_V1(0x50200); READ_SMN_V2(0x50204);
-    fprintf(stdout, "Memory Clock: %.0f MHz\nGDM: %s\nCR: %s\nTcl: %d\nTras: %d\nTrcdrd: %d\nTrcdwr: %d\n",
-        (value1 & 0x7f) / 3.f * 100.f,
-        bool_str[((value1 >> 11) & 1) == 1],
-        ((value1 & 0x400) >> 10) != 0 ? "2T" : "1T",
-        value2 & 0x3f,
-        value2 >> 8 & 0x7f,
-        value2 >> 16 & 0x3f,
-        value2 >> 24 & 0x3f);
-
-    READ_SMN_V1(0x50208); READ_SMN_V2(0x5020C);
-    fprintf(stdout, "Trc: %d\nTrp: %d\nTrrds: %d\nTrrdl: %d\nTrtp: %d\n",
-        value1 & 0xff,
-        value1 >> 16 & 0x3f,
-        value2 & 0x1f,
-        value2 >> 8 & 0x1f,
-        value2 >> 24 & 0x1f);
-
-    READ_SMN_V1(0x50210); READ_SMN_V2(0x50214);
-    fprintf(stdout, "Tfaw: %d\nTcwl: %d\nTwtrs: %d\nTwtrl: %d\n",
-        value1 & 0xff,
-        value2 & 0x3f,
-        value2 >> 8 & 0x1f,
-        value2 >> 16 & 0x3f);
-
-    READ_SMN_V1(0x50218); READ_SMN_V2(0x50220);
-    fprintf(stdout, "Twr: %d\nTrdrddd: %d\nTrdrdsd: %d\nTrdrdsc: %d\nTrdrdscl: %d\n",
-        value1 & 0xff,
-        value2 & 0xf,
-        value2 >> 8 & 0xf,
-        value2 >> 16 & 0xf,
-        value2 >> 24 & 0x3f);
-
-    READ_SMN_V1(0x50224); READ_SMN_V2(0x50228);
-    fprintf(stdout, "Twrwrdd: %d\nTwrwrsd: %d\nTwrwrsc: %d\nTwrwrscl: %d\nTwrrd: %d\nTrdwr: %d\n",
-        value1 & 0xf,
-        value1 >> 8 & 0xf,
-        value1 >> 16 & 0xf,
-        value1 >> 24 & 0x3f,
-        value2 & 0xf,
-        value2 >> 8 & 0x1f);
-
-    READ_SMN_V1(0x50254);
-    fprintf(stdout, "Tcke: %d\n", value1 >> 24 & 0x1f);
-
-    READ_SMN_V1(0x50260); READ_SMN_V2(0x50264);
-    if (value1 != value2 && value1 == 0x21060138)
-        value1 = value2;
-
-    fprintf(stdout, "Trfc: %d\nTrfc2: %d\nTrfc4: %d\n",
-        value1 & 0x3ff,
-        value1 >> 11 & 0x3ff,
-        value1 >> 22 & 0x3ff);
-
-    exit(0);
-
-_READ_ERROR:
-    fprintf(stderr, "Unable to read SMN address space.\n");
-    exit(1);
+//Logical (enabled) core of a physical PM table index, the inverse of coremap.
+//-1 for a fused-off or unknown core. op_get_cocount() and op_set_cocount() take the logical one.
+int core_logical_index(system_info *sysinfo, int physical) {
+    int i;
+
+    if (physical < 0 || physical >= 32 || ((sysinfo->core_disable_map >> physical) & 1))
+        return -1;
+    if (!sysinfo->coremap) {
+        i = count_set_bits(~sysinfo->core_disable_map & ((1u << physical) - 1));
+        return i < (int)sysinfo->cores ? i : -1;
+    }
+    for (i = 0; i < (int)sysinfo->cores; i++) {
+        if (sysinfo->coremap[i] == physical)
+            return i;
+    }
+    return -1;
+}
+
+//Map every logical CPU to the PM table core it runs on.
+//SMT siblings share a core, the first CPU of each sibling list identifies it.
+//Cores are enumerated in ascending order of their first CPU and then translated
+//to the physical PM table index through the coremap.
+int get_cpu_topology_map(system_info *sysinfo) {
+    return get_cpu_topology_map_at(sysinfo, "");
+}
+
+//Same under another sysfs root, the CPUs are the cpuN directories found there
+int get_cpu_topology_map_at(system_info *sysinfo, const char *root) {
+    char path[PATH_MAX];
+    int i, j, ncpus, first, ordinal, *primary;
+    FILE *fp;
+
+    if (*root) {
+        for (ncpus = 0; ; ncpus++) {
+            snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d", root, ncpus);
+            if (access(path, F_OK) != 0)
+                break;
+        }
+    } else {
+        ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    }
+    if (ncpus <= 0)
+        return -1;
+
+    primary = (int *)malloc(ncpus * sizeof(int));
+    sysinfo->cpumap = (int *)malloc(ncpus * sizeof(int));
+    if (!primary || !sysinfo->cpumap) {
+        free(primary);
+        return -1;
+    }
+
+    for (i = 0; i < ncpus; i++) {
+        primary[i] = -1;
+        snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", root, i);
+        fp = fopen(path, "r");
+        if (!fp)
+            continue;
+        if (fscanf(fp, "%d", &first) == 1)
+            primary[i] = first;
+        fclose(fp);
+    }
+
+    for (i = 0; i < ncpus; i++) {
+        sysinfo->cpumap[i] = -1;
+        if (primary[i] < 0)
+            continue;
+        //Ordinal of the core is the number of distinct primaries below ours
+        ordinal = 0;
+        for (j = 0; j < ncpus; j++) {
+            if (primary[j] == j && j < primary[i])
+                ordinal++;
+        }
+        if (sysinfo->coremap && ordinal < (int)sysinfo->cores)
+            sysinfo->cpumap[i] = sysinfo->coremap[ordinal];
+        else
+            sysinfo->cpumap[i] = ordinal;
+    }
+
+    sysinfo->cpumap_count = ncpus;
+    free(primary);
+    return 0;
 }
 
 int select_pm_table_version(unsigned int version, pm_table *pmt, unsigned char *pm_buf) {
@@ -291,4 +311,41 @@ int select_pm_table_version(unsigned int version, pm_table *pmt, unsigned char *
     if (pmt->VDD18_POWER == NULL) pmt->VDD18_POWER = pmt->IO_VDD18_POWER;
 
     return 1;
-}
\ No newline at end of file
+}
+
+void disabled_cores_from_pmt(pm_table *pmt, system_info *sysinfo) {
+    int i, mask;
+    float power, voltage, fit, iddmax, freq, freqeff, c0, cc1, irm;
+    for (i = 0; i < pmt->max_cores; i++) {
+        power = pmta0(CORE_POWER[i]);
+        voltage = pmta0(CORE_VOLTAGE[i]);
+        fit = pmta0(CORE_FIT[i]);
+        iddmax = pmta0(CORE_IDDMAX[i]);
+        freq = pmta0(CORE_FREQ[i]);
+        freqeff = pmta0(CORE_FREQEFF[i]);
+        c0 = pmta0(CORE_C0[i]);
+        cc1 = pmta0(CORE_CC1[i]);
+        irm = pmta0(CORE_IRM[i]);
+        
+        if (power == 0 && voltage == 0 && fit == 0 && iddmax == 0 && freq == 0 && freqeff == 0 && c0 == 0 && cc1 == 0 && irm == 0 ) {
+            mask = 1 << i;
+        } else {
+            mask = 0 << i;
+        }
+        sysinfo->core_disable_map_pmt = sysinfo->core_disable_map_pmt | mask;
+    }
+}
+
+//Without the SMU the topology is guessed from the PM table alone
+void sysinfo_from_pmt(pm_table *pmt, system_info *sysinfo) {
+    sysinfo->available=0; //Did not read sysinfo
+    sysinfo->cores = pmt->max_cores;
+    sysinfo->physical_cores = pmt->max_cores;
+    sysinfo->ccds = pmt->max_cores > 8 ? 2 : 1;
+    sysinfo->ccxs = pmt->zen_version == 3 ? sysinfo->ccds : sysinfo->ccds * 2;
+
+    disabled_cores_from_pmt(pmt, sysinfo);
+
+    sysinfo->core_disable_map=sysinfo->core_disable_map_pmt;
+    sysinfo->enabled_cores_count=sysinfo->cores-count_set_bits(sysinfo->core_disable_map);
+}
@@ -24,6 +24,8 @@
 #ifndef READINFO_H
 #define READINFO_H
 
+#include <stddef.h>
+#include <libsmu.h>
 #include "pm_tables.h"
 
 typedef struct {
@@ -44,13 +46,35 @@ typedef struct {
     unsigned int family;
     unsigned int model;
     int *coremap;
+    int *cpumap;        //Logical CPU -> PM table core index, -1 if unknown
+    int cpumap_count;
 } system_info;
 
-void print_memory_timings();
-void get_processor_topology(system_info *sysinfo, int init_debug);
+enum topology_error {
+    TOPOLOGY_ERR_CCD_FUSES      = -1,
+    TOPOLOGY_ERR_CORE_FUSE      = -2,
+    TOPOLOGY_ERR_CCD_CORE_FUSE  = -3,
+    TOPOLOGY_ERR_MEMORY         = -4,
+};
+
+//Raw fuse values behind the topology, for --init-debug
+typedef struct {
+    unsigned int ccds_present, ccds_down;
+    unsigned int ccd_enable_map, ccd_disable_map;
+    unsigned int core_disable_map_addr, core_disable_map_raw;
+} topology_fuses;
+
+int read_processor_topology(smu_obj_t *smu, system_info *sysinfo, topology_fuses *fuses);
+int physical_core_count(pm_table *pmt, system_info *sysinfo);
+int core_logical_index(system_info *sysinfo, int physical);
+int get_cpu_topology_map(system_info *sysinfo);
+int get_cpu_topology_map_at(system_info *sysinfo, const char *root);
 unsigned int count_set_bits(unsigned int v);
 const char* get_processor_name();
+void read_processor_name(char *name, size_t len);
 void append_u32_to_str(char* buffer, unsigned int val);
 int select_pm_table_version(unsigned int version, pm_table *pmt, unsigned char *pm_buf);
+void disabled_cores_from_pmt(pm_table *pmt, system_info *sysinfo);
+void sysinfo_from_pmt(pm_table *pmt, system_info *sysinfo);
 
 #endif
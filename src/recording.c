@@ -0,0 +1,178 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Multi-sample PM table recordings, written by --record and played back
+ * by --replay through the same decode and render path as a live table.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "recording.h"
+
+extern smu_obj_t obj;
+
+int recording_create(recording *rec, const char *path, unsigned int version, unsigned int table_size) {
+    recording_header hdr;
+
+    memset(rec, 0, sizeof(*rec));
+    if (!(rec->fp = fopen(path, "wb"))) {
+        fprintf(stderr, "Could not create the recording (\"%s\").\n", path);
+        return -1;
+    }
+
+    memcpy(hdr.magic, RECORDING_MAGIC, sizeof(hdr.magic));
+    hdr.version = version;
+    hdr.table_size = table_size;
+    if (fwrite(&hdr, sizeof(hdr), 1, rec->fp) != 1) {
+        fclose(rec->fp);
+        rec->fp = NULL;
+        return -1;
+    }
+    rec->version = version;
+    rec->table_size = table_size;
+    return 0;
+}
+
+int recording_write(recording *rec, unsigned long long time_ns, const unsigned char *table) {
+    if (fwrite(&time_ns, sizeof(time_ns), 1, rec->fp) != 1 ||
+        fwrite(table, 1, rec->table_size, rec->fp) != rec->table_size)
+        return -1;
+    rec->samples++;
+    return 0;
+}
+
+//version is only used for legacy raw dumps, recordings and dumps carry their own
+int recording_open(recording *rec, const char *path, unsigned int version) {
+    recording_header hdr;
+    struct stat st;
+
+    memset(rec, 0, sizeof(*rec));
+    if (!(rec->fp = fopen(path, "rb")) || fstat(fileno(rec->fp), &st) != 0) {
+        fprintf(stderr, "Could not read the recording (\"%s\").\n", path);
+        if (rec->fp) fclose(rec->fp);
+        rec->fp = NULL;
+        return -1;
+    }
+
+    switch (dumpfile_read_header(rec->fp, &rec->dump_hdr)) {
+        case 0:
+            rec->dump = 1;
+            rec->version = rec->dump_hdr.pm_table_version;
+            rec->table_size = rec->dump_hdr.table_size;
+            return 0;
+        case -1:
+            fprintf(stderr, "\"%s\" is not a valid dumpfile.\n", path);
+            recording_close(rec);
+            return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, rec->fp) == 1 && !memcmp(hdr.magic, RECORDING_MAGIC, sizeof(hdr.magic))) {
+        rec->version = hdr.version;
+        rec->table_size = hdr.table_size;
+        return 0;
+    }
+
+    if (!version) {
+        fprintf(stderr, "\"%s\" is a legacy raw dump, specify its PM Table version with -f.\n", path);
+        recording_close(rec);
+        return -1;
+    }
+    rec->raw = 1;
+    rec->version = version;
+    rec->table_size = st.st_size;
+    rewind(rec->fp);
+    return 0;
+}
+
+//Returns 1 when a sample was read, 0 at the end of the recording, -1 on a truncated sample,
+//-2 on a dump snapshot failing its checksum
+int recording_read(recording *rec, unsigned long long *time_ns, unsigned char *table) {
+    int ret;
+
+    if (rec->dump) {
+        if ((ret = dumpfile_read_snapshot(rec->fp, &rec->dump_hdr, time_ns, table)) > 0)
+            rec->samples++;
+        return ret;
+    }
+    if (rec->raw) {
+        if (rec->samples)
+            return 0;
+        *time_ns = 0;
+    } else if (fread(time_ns, sizeof(*time_ns), 1, rec->fp) != 1) {
+        return 0;
+    }
+
+    if (fread(table, 1, rec->table_size, rec->fp) != rec->table_size)
+        return -1;
+    rec->samples++;
+    return 1;
+}
+
+void recording_close(recording *rec) {
+    if (rec->fp)
+        fclose(rec->fp);
+    rec->fp = NULL;
+}
+
+//Records the live PM table every interval_ms, count 0 runs until interrupted
+int record_run(const char *path, int interval_ms, int count) {
+    unsigned long long next, now;
+    unsigned char *pm_buf;
+    recording rec;
+    int err = 0;
+
+    if (!smu_pm_tables_supported(&obj)) {
+        fprintf(stderr, "PM Tables are not supported for this processor.\n");
+        return -1;
+    }
+    if (recording_create(&rec, path, obj.pm_table_version, obj.pm_table_size) != 0)
+        return -4;
+    if (!(pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char)))) {
+        recording_close(&rec);
+        return -1;
+    }
+
+    fprintf(stderr, "Recording PM Table 0x%X every %d ms to \"%s\".\n", obj.pm_table_version, interval_ms, path);
+    next = get_time_ns();
+    while (!count || (int)rec.samples < count) {
+        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+            if (recording_write(&rec, get_time_ns(), pm_buf) != 0) {
+                fprintf(stderr, "Could not write to the recording.\n");
+                err = -4;
+                break;
+            }
+            //Keep what was recorded so far if the run is interrupted
+            fflush(rec.fp);
+        }
+        next += interval_ms * 1000000ULL;
+        now = get_time_ns();
+        if (next > now)
+            msleep((next - now) / 1000000);
+    }
+
+    fprintf(stderr, "Recorded %llu samples.\n", rec.samples);
+    recording_close(&rec);
+    free(pm_buf);
+    return err;
+}
@@ -0,0 +1,58 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <stdio.h>
+#include "dumpfile.h"
+
+#define RECORDING_MAGIC     "RMNGREC1"
+
+/**
+ * File layout, native endianness:
+ *   header   magic[8], PM table version (u32), sample size in bytes (u32)
+ *   samples  CLOCK_MONOTONIC time in ns (u64), raw PM table
+ * A dump written with -w is read as its snapshots, a legacy raw dump as a
+ * single sample at time 0.
+ **/
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int table_size;
+} recording_header;
+
+typedef struct {
+    FILE *fp;
+    unsigned int version;
+    unsigned int table_size;
+    int raw;                    //Legacy raw dump, no header
+    int dump;                   //Dump written with -w, see dumpfile.h
+    dumpfile_header dump_hdr;
+    unsigned long long samples;
+} recording;
+
+int recording_create(recording *rec, const char *path, unsigned int version, unsigned int table_size);
+int recording_write(recording *rec, unsigned long long time_ns, const unsigned char *table);
+int recording_open(recording *rec, const char *path, unsigned int version);
+int recording_read(recording *rec, unsigned long long *time_ns, unsigned char *table);
+void recording_close(recording *rec);
+int record_run(const char *path, int interval_ms, int count);
+
+#endif
@@ -50,6 +50,25 @@
 #include "pm_tables.h"
 #include "commonfuncs.h"
 #include "argparse.h"
+#include "energy.h"
+#include "topocache.h"
+#include "dramtimings.h"
+#include "governor.h"
+#include "discover.h"
+#include "loadgen.h"
+#include "cosweep.h"
+#include "profile.h"
+#include "smustats.h"
+#include "recording.h"
+#include "dumpfile.h"
+#include "columnar.h"
+#include "bench.h"
+#include "selfstats.h"
+#include "dist.h"
+#include "alert.h"
+#include "sampler.h"
+#include "lowpert.h"
+#include "derived.h"
 
 #define PROGRAM_VERSION "2.0.5"
 #define BUF_SIZE 65536
@@ -66,11 +85,18 @@ static int update_time_s = 1;
 static int export_update_time_s = 10;
 int show_disabled_cores = 0;
 static int cmd_mode = 0;
-int debuglog = 1;
 
 int fdpipe = 0;
 char *pm_export_pipe = 0;
 
+int use_topology_cache = 1;
+static int startup_profile = 0;
+static unsigned long long startup_start_ns = 0, startup_last_ns = 0;
+static int show_smu_stats = 0;
+static int show_self_stats = 0;
+static int show_dist = 0;
+static int low_perturbation = 0;
+
 int view_compact = 0, view_info = 1, view_counts = 1, view_electrical = 1, view_memory = 1, view_gfx = 1, view_power = 1;
 
 //Helper to access the PM Table elements. If an element doesn't exist in the
@@ -83,20 +109,40 @@ int view_compact = 0, view_info = 1, view_counts = 1, view_electrical = 1, view_
 #define for_each_item(item, list) \
     for(T * item = list->head; item != NULL; item = item->next)
 
+//Startup profiling, prints the time spent since the previous mark
+void startup_mark(const char *phase) {
+    unsigned long long now;
+
+    if (!startup_profile)
+        return;
+    now = get_time_ns();
+    if (!startup_start_ns) {
+        startup_start_ns = startup_last_ns = now;
+        return;
+    }
+    fprintf(stderr, "startup-profile: %-32s %9.3f ms\n", phase, (now - startup_last_ns) / 1e6);
+    startup_last_ns = now;
+}
+
+void startup_done() {
+    if (!startup_profile || !startup_start_ns)
+        return;
+    startup_mark("ready");
+    fprintf(stderr, "startup-profile: %-32s %9.3f ms\n", "total", (startup_last_ns - startup_start_ns) / 1e6);
+    startup_start_ns = 0;
+}
+
 void draw_screen(pm_table *pmt, system_info *sysinfo) {
     //general
     int i, j, k, l;
     //core block
-    float core_voltage, core_frequency, package_sleep_time, core_sleep_time, average_voltage;
-    float peak_core_frequency, peak_core_temp, peak_core_voltage, smu_peak_core_voltage;
-    float total_core_voltage, total_core_power, total_usage, total_core_CC6;
-    float thm_value = 0;
+    float core_voltage, core_frequency;
+    const derived_values *d = derived_get();
 
     int core_disabled, core_number;
     //constraints block
-    float edc_value, ppt_limit_apu;
+    float ppt_limit_apu;
     //power block
-    float l3_logic_power, l3_vddm_power;
     char strbuf[100];
 
     if (pmt->experimental) {
@@ -120,44 +166,15 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
         fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
     }
 
-    peak_core_frequency = peak_core_temp = peak_core_voltage = 0;
-    total_core_voltage = total_core_power = total_usage = total_core_CC6 = 0;
-    core_number = 0;
-
-    for (i = 0; i < pmt->max_cores; i++) {
-        core_disabled = (sysinfo->core_disable_map >> i)&0x01;
-        average_voltage = i > 0 ? (average_voltage+pmta(CORE_VOLTAGE[i]))/2 : pmta(CORE_VOLTAGE[i]);
-        if (!core_disabled) core_number++;
-    }
-
     core_number = 0;
 
-    if (!average_voltage > 0)
-        average_voltage = pmta(CPU_TELEMETRY_VOLTAGE);
-
-    if(pmt->PC6)
-    {
-        package_sleep_time = pmta(PC6) / 100.f;
-        average_voltage = ((average_voltage) - (0.2 * package_sleep_time)) / (1.0 - package_sleep_time);
-    }
-
     fprintf(stdout, "╭─────────┬────────────┬──────────┬─────────┬──────────┬─────────────┬─────────────┬─────────────╮\n");
     for (i = 0; i < pmt->max_cores; i++) {
         core_disabled = (sysinfo->core_disable_map >> i)&0x01;
         core_frequency = pmta(CORE_FREQEFF[i]) * 1000.f;
 
-        if (!pmt->THM_VALUE) {
-            if (pmta0(THM_VALUE_CORES[i]) > 0 && pmta0(THM_VALUE_CORES[i]) > thm_value)
-                thm_value = pmta0(THM_VALUE_CORES[i]);
-        }
-
-        core_voltage = pmta(CORE_VOLTAGE[i]); // True core voltage
-        // Rumours say this is how AMD calculates core voltage
-        //if (pmta(CORE_FREQ[i]) != 0.f) {
-        core_sleep_time = pmta0(CORE_CC6[i]) / 100.f;
-        if (core_sleep_time > 0 && average_voltage < 2)
-            core_voltage = ((1.0 - core_sleep_time) * average_voltage) + (0.2 * core_sleep_time);
-        //}
+        // Rumours say this is how AMD calculates core voltage, weighted by CC6 residency
+        core_voltage = d->cores.voltage[i];
 
         if (core_disabled) {
             if (show_disabled_cores)
@@ -187,36 +204,24 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
         //Don't confuse people by numbering cores that are disabled and hence not shown on 6 | 12 core CPUs
         //(which actually have 8 | 16 cores)
         if (show_disabled_cores || !core_disabled) core_number++;
-
-        //Statistics
-        if (!core_disabled) {
-            if (peak_core_frequency < core_frequency) peak_core_frequency = core_frequency;
-            if (peak_core_temp < pmta(CORE_TEMP[i])) peak_core_temp = pmta(CORE_TEMP[i]);
-            if (peak_core_voltage < core_voltage) peak_core_voltage = core_voltage;
-            total_core_voltage += core_voltage;
-            total_core_power += pmta(CORE_POWER[i]);
-            total_usage += pmta(CORE_C0[i]);
-            total_core_CC6 += pmta(CORE_CC6[i]);
-        }
     }
 
     fprintf(stdout, "╰─────────┴────────────┴──────────┴─────────┴──────────┴─────────────┴─────────────┴─────────────╯\n");
 
     fprintf(stdout, "╭── Core Statistics (Calculated) ───────────────┬────────────────────────────────────────────────╮\n");
-    print_line("Highest Effective Core Frequency", "%8.0f MHz", peak_core_frequency);
-    print_line("Highest Core Temperature", "%8.2f C", peak_core_temp);
-    print_line("Highest Core Voltage", "%8.3f V", peak_core_voltage);
-    print_line("Average Core Voltage", "%5.3f V", total_core_voltage/sysinfo->enabled_cores_count);
+    print_line("Highest Effective Core Frequency", "%8.0f MHz", d->cores.peak_frequency);
+    print_line("Highest Core Temperature", "%8.2f C", d->cores.peak_temp);
+    print_line("Highest Core Voltage", "%8.3f V", d->cores.peak_voltage);
+    print_line("Average Core Voltage", "%5.3f V", d->v[DERIVED_CORES_AVG_VOLTAGE]);
 
     if (!view_compact) {
-        print_line("Average Core CC6", "%6.2f %%", total_core_CC6/sysinfo->enabled_cores_count);
-        print_line("Total Core Power Sum", "%7.3f W", total_core_power);
+        print_line("Average Core CC6", "%6.2f %%", d->v[DERIVED_CORES_AVG_CC6]);
+        print_line("Total Core Power Sum", "%7.3f W", d->cores.total_power);
     }
 
     fprintf(stdout, "├── Reported by SMU ────────────────────────────┼────────────────────────────────────────────────┤\n");
     //print_line("Package Power", "%8.3f W", pmta(SOCKET_POWER)); //Is listed below in power section
-    smu_peak_core_voltage = pmta0(CPU_TELEMETRY_VOLTAGE) < peak_core_voltage ? peak_core_voltage : pmta0(CPU_TELEMETRY_VOLTAGE) < 2 ? pmta0(CPU_TELEMETRY_VOLTAGE) : peak_core_voltage;
-    print_line("Peak Core Voltage", "%5.3f V", smu_peak_core_voltage);
+    print_line("Peak Core Voltage", "%5.3f V", d->v[DERIVED_PEAK_VOLTAGE_SMU]);
     if(pmt->PC6) print_line("Package CC6", "%6.2f %%", pmta(PC6));
     fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
 
@@ -250,8 +255,6 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
 
     if (view_electrical) {
         fprintf(stdout, "╭── Electrical & Thermal Constraints ───────────┬────────────────────────────────────────────────╮\n");
-        edc_value = pmta0(EDC_VALUE) * (total_usage / sysinfo->cores / 100);
-        if (edc_value < pmta(TDC_VALUE)) edc_value = pmta(TDC_VALUE);
 
         print_line("Peak Temperature", "%8.2f C", pmta(PEAK_TEMP));
         if(pmt->SOC_TEMP) print_line("SoC Temperature", "%8.2f C", pmta(SOC_TEMP));
@@ -266,10 +269,9 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
         print_line("TDC Value", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_VALUE), pmta(TDC_LIMIT), (pmta(TDC_VALUE) / pmta(TDC_LIMIT) * 100));
         if(pmt->TDC_ACTUAL) print_line("TDC Actual", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_ACTUAL), pmta(TDC_LIMIT), (pmta(TDC_ACTUAL) / pmta(TDC_LIMIT) * 100));
         if(pmt->TDC_VALUE_SOC) print_line("TDC Value, SoC only", "%7.3f A | %7.f A | %8.2f %%", pmta(TDC_VALUE_SOC), pmta(TDC_LIMIT_SOC), (pmta(TDC_VALUE_SOC) / pmta(TDC_LIMIT_SOC) * 100));
-        print_line("EDC", "%7.3f A | %7.f A | %8.2f %%", edc_value, pmta0(EDC_LIMIT), (edc_value / pmta0(EDC_LIMIT) * 100));
+        print_line("EDC", "%7.3f A | %7.f A | %8.2f %%", d->v[DERIVED_EDC], pmta0(EDC_LIMIT), (d->v[DERIVED_EDC] / pmta0(EDC_LIMIT) * 100));
         if(pmt->EDC_VALUE_SOC) print_line("EDC, SoC only", "%7.3f A | %7.f A | %8.2f %%", pmta(EDC_VALUE_SOC), pmta(EDC_LIMIT_SOC), (pmta(EDC_VALUE_SOC) / pmta(EDC_LIMIT_SOC) * 100));
-        if (pmt->THM_VALUE) thm_value = pmta(THM_VALUE);
-        print_line("THM", "%7.2f C | %7.f C | %8.2f %%", thm_value, pmta(THM_LIMIT), (thm_value / pmta(THM_LIMIT) * 100));
+        print_line("THM", "%7.2f C | %7.f C | %8.2f %%", d->v[DERIVED_THM], pmta(THM_LIMIT), (d->v[DERIVED_THM] / pmta(THM_LIMIT) * 100));
         if (!view_compact) {
             if(pmt->THM_VALUE_SOC) print_line("THM SoC", "%7.2f C | %7.f C | %8.2f %%", pmta(THM_VALUE_SOC), pmta(THM_LIMIT_SOC), (pmta(THM_VALUE_SOC) / pmta(THM_LIMIT_SOC) * 100));
             if(pmt->THM_VALUE_GFX) print_line("THM GFX", "%7.2f C | %7.f C | %8.2f %%", pmta(THM_VALUE_GFX), pmta(THM_LIMIT_GFX), (pmta(THM_VALUE_GFX) / pmta(THM_LIMIT_GFX) * 100));
@@ -317,7 +319,7 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
     if (view_power) {
         fprintf(stdout, "╭── Power Consumption ──────────────────────────┬────────────────────────────────────────────────╮\n");
         //These powers are drawn via VDDCR_SOC and VDDCR_CPU and thus are pulled from the CPU power connector of the mainboard
-        print_line("Total Core Power Sum", "%7.3f W", total_core_power);
+        print_line("Total Core Power Sum", "%7.3f W", d->cores.total_power);
         //print_line("VDDCR_CPU Power", "%7.3f W", pmta(VDDCR_CPU_POWER)); //This value doesn't correlate with what the cores
                                                                             //report, nor with what is actually consumed. but is
                                                                             //the value HWiNFO shows.
@@ -332,12 +334,6 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
             if(pmt->GMI2_VDDG_POWER) print_line("GMI2_VDDG Power", "%7.3f W", pmta(GMI2_VDDG_POWER));
 
             //L3 caches (2 per CCD on Zen2, 1 per CCD on Zen3)
-            l3_logic_power=0;
-            l3_vddm_power=0;
-            for (i=0; i<pmt->max_l3; i++) {
-                l3_logic_power += pmta0(L3_LOGIC_POWER[i]);
-                l3_vddm_power += pmta0(L3_VDDM_POWER[i]);
-            }
             if (pmt->max_l3 == 1) {
                 if(pmt->L3_LOGIC_POWER[0])
                     print_line("L3 Logic Power", "%7.3f W", pmta(L3_LOGIC_POWER[0]));
@@ -351,7 +347,7 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
                     if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", pmta(L3_LOGIC_POWER[i+1]));
                     // end of string (sum or nothing)
                     if (pmt->max_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
-                    else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", l3_logic_power);
+                    else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", d->v[DERIVED_L3_LOGIC_POWER]);
                     // print
                     print_line((i?"":"L3 Logic Power"), "%s", strbuf);
                 }
@@ -362,7 +358,7 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
                     if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, " + %7.3f W", pmta(L3_VDDM_POWER[i+1]));
                     // end of string (sum or nothing)
                     if (pmt->max_l3-i > 2) j += snprintf(strbuf+j, sizeof(strbuf)-j, "            ");
-                    else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", l3_vddm_power);
+                    else j += snprintf(strbuf+j, sizeof(strbuf)-j, " = %7.3f W", d->v[DERIVED_L3_VDDM_POWER]);
                     // print
                     print_line((i?"":"L3 VDDM Power"), "%s", strbuf);
                 }
@@ -384,9 +380,7 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
             //The sum is the thermal output of the whole package. Yes, this is higher than PPT and SOCKET_POWER.
             //Confirmed by measuring the actual current draw on the mainboard.
             print_line("","");
-            print_line("Calculated Thermal Output", "%7.3f W", total_core_power + pmta0(VDDCR_SOC_POWER) + pmta0(GMI2_VDDG_POWER) 
-                    + l3_logic_power + l3_vddm_power
-                    + pmta0(VDDIO_MEM_POWER) + pmta0(IOD_VDDIO_MEM_POWER) + pmta0(DDR_VDDP_POWER) + pmta0(VDD18_POWER));
+            print_line("Calculated Thermal Output", "%7.3f W", d->v[DERIVED_THERMAL_OUTPUT]);
             }
 
             if (pmt->SOC_TELEMETRY_VOLTAGE || pmt->SOC_TELEMETRY_CURRENT || pmt->SOC_TELEMETRY_POWER || pmt->CPU_TELEMETRY_VOLTAGE || pmt->CPU_TELEMETRY_CURRENT || pmt->CPU_TELEMETRY_POWER || pmt->VDDCR_CPU_POWER || pmt->SOCKET_POWER || pmt->PACKAGE_POWER)
@@ -406,6 +400,15 @@ void draw_screen(pm_table *pmt, system_info *sysinfo) {
         }
         fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
     }
+
+    if (show_self_stats)
+        draw_self_footer();
+
+    if (show_dist)
+        draw_dist_pane(sysinfo->core_disable_map);
+
+    if (alert_count())
+        draw_alert_pane();
 }
 
 void remove_spaces(char* s) {
@@ -421,60 +424,26 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
     //general
     int i, j, k, l;
     //core block
-    float core_voltage, core_frequency, package_sleep_time, core_sleep_time, average_voltage;
-    float peak_core_frequency, peak_core_temp, peak_core_voltage;
-    float total_core_voltage, total_core_power, total_usage, total_core_CC6;
+    float core_voltage, core_frequency;
+    const derived_values *d = derived_get();
     int core_disabled, core_number;
-    float thm_value = 0;
-    //constraints block
-    float edc_value;
     //power block
-    float l3_logic_power, l3_vddm_power;
     char strbuf[100];
 
     char hostname[HOST_NAME_MAX + 1];
     gethostname(hostname, HOST_NAME_MAX + 1);    
     remove_spaces(hostname);
     
-    peak_core_frequency = peak_core_temp = peak_core_voltage = 0;
-    total_core_voltage = total_core_power = total_usage = total_core_CC6 = 0;
-    core_number = 0;
-
-    for (i = 0; i < pmt->max_cores; i++) {
-        core_disabled = (sysinfo->core_disable_map >> i)&0x01;
-        average_voltage = i > 0 ? (average_voltage+pmta(CORE_VOLTAGE[i]))/2 : pmta(CORE_VOLTAGE[i]);
-        if (!core_disabled) core_number++;
-    }
-
     core_number = 0;
 
-    if (!average_voltage > 0)
-        average_voltage = pmta(CPU_TELEMETRY_VOLTAGE);
-
-    if(pmt->PC6)
-    {
-        package_sleep_time = pmta(PC6) / 100.f;
-        average_voltage = ((average_voltage) - (0.2 * package_sleep_time)) / (1.0 - package_sleep_time);
-    }
-
     // Cores
 
     for (i = 0; i < pmt->max_cores; i++) {
         core_disabled = (sysinfo->core_disable_map >> i)&0x01;
         core_frequency = pmta0(CORE_FREQEFF[i]) * 1000.f;
 
-        if (!pmt->THM_VALUE) {
-            if (pmta0(THM_VALUE_CORES[i]) > 0 && pmta0(THM_VALUE_CORES[i]) > thm_value)
-                thm_value = pmta0(THM_VALUE_CORES[i]);
-        }
-
-        core_voltage = pmta0(CORE_VOLTAGE[i]); // True core voltage
-        // Rumours say this is how AMD calculates core voltage
-        //if (pmta(CORE_FREQ[i]) != 0.f) {
-        core_sleep_time = pmta0(CORE_CC6[i]) / 100.f;
-        if (core_sleep_time > 0 && average_voltage < 2)
-            core_voltage = ((1.0 - core_sleep_time) * average_voltage) + (0.2 * core_sleep_time);
-        //}
+        // Rumours say this is how AMD calculates core voltage, weighted by CC6 residency
+        core_voltage = d->cores.voltage[i];
 
         if (core_disabled) {
             if (show_disabled_cores)
@@ -505,33 +474,22 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
         //Don't confuse people by numbering cores that are disabled and hence not shown on 6 | 12 core CPUs
         //(which actually have 8 | 16 cores)
         if (show_disabled_cores || !core_disabled) core_number++;
-
-        //Statistics
-        if (!core_disabled) {
-            if (peak_core_frequency < core_frequency) peak_core_frequency = core_frequency;
-            if (peak_core_temp < pmta0(CORE_TEMP[i])) peak_core_temp = pmta0(CORE_TEMP[i]);
-            if (peak_core_voltage < core_voltage) peak_core_voltage = core_voltage;
-            total_core_voltage += core_voltage;
-            total_core_power += pmta0(CORE_POWER[i]);
-            total_usage += pmta0(CORE_C0[i]);
-            total_core_CC6 += pmta0(CORE_CC6[i]);
-        }
     }
 
     fprintf(stdout,
             "ryzen_monitor_ng,host=%s,name=Cores ", hostname);
     fprintf(stdout,
-            "cores_maxfrequencyeff=%.0fi,", peak_core_frequency);
+            "cores_maxfrequencyeff=%.0fi,", d->cores.peak_frequency);
     fprintf(stdout,
-            "cores_maxtemperature=%.2f,", peak_core_temp);
+            "cores_maxtemperature=%.2f,", d->cores.peak_temp);
     fprintf(stdout,
-            "cores_maxvid=%.3f,", peak_core_voltage);
+            "cores_maxvid=%.3f,", d->cores.peak_voltage);
     fprintf(stdout,
-            "cores_avgvid=%.3f,", total_core_voltage/sysinfo->enabled_cores_count);
+            "cores_avgvid=%.3f,", d->v[DERIVED_CORES_AVG_VOLTAGE]);
     fprintf(stdout,
-            "cores_avgcc6=%.2f,", total_core_CC6/sysinfo->enabled_cores_count);
+            "cores_avgcc6=%.2f,", d->v[DERIVED_CORES_AVG_CC6]);
     fprintf(stdout,
-            "cores_totalpower=%.3f,", total_core_power);
+            "cores_totalpower=%.3f,", d->cores.total_power);
     if(pmt->PC6)
         fprintf(stdout,
                 "package_cc6=%.2f,", pmta0(PC6));
@@ -564,8 +522,6 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
     fprintf(stdout,
             "ryzen_monitor_ng,host=%s,name=Package ", hostname);
 
-    edc_value = pmta0(EDC_VALUE) * (total_usage / sysinfo->cores / 100);
-    if (edc_value < pmta0(TDC_VALUE)) edc_value = pmta0(TDC_VALUE);
 
     fprintf(stdout,
             "package_peaktemperature=%.2f,", pmta0(PEAK_TEMP));
@@ -621,7 +577,7 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
     }
 
     fprintf(stdout,
-            "cpu_edc=%.3f,", edc_value);
+            "cpu_edc=%.3f,", d->v[DERIVED_EDC]);
     fprintf(stdout,
             "cpu_edclimit=%.fi,", pmta0(EDC_LIMIT));
 
@@ -632,10 +588,8 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
                 "soc_edclimit=%.fi,", pmta0(EDC_LIMIT_SOC));
     }
 
-    if (pmt->THM_VALUE) thm_value = pmta(THM_VALUE);
-
     fprintf(stdout,
-            "cpu_thm=%.2f,", thm_value);
+            "cpu_thm=%.2f,", d->v[DERIVED_THM]);
 
     fprintf(stdout,
             "cpu_thmlimit=%.0fi,", pmta0(THM_LIMIT));
@@ -789,12 +743,6 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
             "package_gmi2vddgpower=%.3f,", pmta0(GMI2_VDDG_POWER));
 
     //L3 caches (2 per CCD on Zen2, 1 per CCD on Zen3)
-    l3_logic_power=0;
-    l3_vddm_power=0;
-    for (i=0; i<pmt->max_l3; i++) {
-        l3_logic_power += pmta0(L3_LOGIC_POWER[i]);
-        l3_vddm_power += pmta0(L3_VDDM_POWER[i]);
-    }
     if (pmt->max_l3 == 1) {
 
         fprintf(stdout,
@@ -807,24 +755,24 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
 
         for (i=0; i<pmt->max_l3; i+=2) {
             // first value
-            j = snprintf(strbuf, sizeof(strbuf), "package_l3logic%spower=%.3f,", i, pmta0(L3_LOGIC_POWER[i]));
+            j = snprintf(strbuf, sizeof(strbuf), "package_l3logic%dpower=%.3f,", i, pmta0(L3_LOGIC_POWER[i]));
             // second value if it exists
-            if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3logic%spower=%.3f,", i+1, pmta0(L3_LOGIC_POWER[i+1]));
+            if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3logic%dpower=%.3f,", i+1, pmta0(L3_LOGIC_POWER[i+1]));
             // end of string (sum or nothing)
             if (pmt->max_l3-i <= 3)
-                j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3logicpower=%.3f,", l3_logic_power);
+                j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3logicpower=%.3f,", d->v[DERIVED_L3_LOGIC_POWER]);
             // print
             fprintf(stdout,
                 "%s", strbuf);
         }
         for (i=0; i<pmt->max_l3; i+=2) {
             // + sign if needed and first value
-            j = snprintf(strbuf, sizeof(strbuf), "package_l3vddm%spower=%.3f,", i, pmta0(L3_VDDM_POWER[i]));
+            j = snprintf(strbuf, sizeof(strbuf), "package_l3vddm%dpower=%.3f,", i, pmta0(L3_VDDM_POWER[i]));
             // second value if it exists
-            if (pmt->max_l3-i > 1) j += snprintf(strbuf, sizeof(strbuf)-j, "package_l3vddm%spower=%.3f,", i+1, pmta0(L3_VDDM_POWER[i+1]));
+            if (pmt->max_l3-i > 1) j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3vddm%dpower=%.3f,", i+1, pmta0(L3_VDDM_POWER[i+1]));
             // end of string (sum or nothing)
             if (pmt->max_l3-i <= 3)
-                j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3vddmpower=%.3f,", l3_vddm_power);
+                j += snprintf(strbuf+j, sizeof(strbuf)-j, "package_l3vddmpower=%.3f,", d->v[DERIVED_L3_VDDM_POWER]);
             // print
             fprintf(stdout,
                 "%s", strbuf);
@@ -859,9 +807,7 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
         //The sum is the thermal output of the whole package. Yes, this is higher than PPT and SOCKET_POWER.
         //Confirmed by measuring the actual current draw on the mainboard.
         fprintf(stdout,
-            "package_calc_thermaloutput=%.3f,", total_core_power + pmta0(VDDCR_SOC_POWER) + pmta0(GMI2_VDDG_POWER) 
-            + l3_logic_power + l3_vddm_power
-            + pmta0(VDDIO_MEM_POWER) + pmta0(IOD_VDDIO_MEM_POWER) + pmta0(DDR_VDDP_POWER) + pmta0(VDD18_POWER));
+            "package_calc_thermaloutput=%.3f,", d->v[DERIVED_THERMAL_OUTPUT]);
     }
 
     fprintf(stdout,
@@ -893,34 +839,26 @@ void draw_export(pm_table *pmt, system_info *sysinfo) {
         "package_vdd18power=%.3f,", pmta0(VDD18_POWER));
 
     fprintf(stdout,
-            "package_totalcorepower=%.3f", total_core_power);
+            "package_totalcorepower=%.3f", d->cores.total_power);
 
     fprintf(stdout,
             "\n");
-    
-}
 
-void disabled_cores_from_pmt(pm_table *pmt, system_info *sysinfo) {
-    int i, mask;
-    float power, voltage, fit, iddmax, freq, freqeff, c0, cc1, irm;
-    for (i = 0; i < pmt->max_cores; i++) {
-        power = pmta0(CORE_POWER[i]);
-        voltage = pmta0(CORE_VOLTAGE[i]);
-        fit = pmta0(CORE_FIT[i]);
-        iddmax = pmta0(CORE_IDDMAX[i]);
-        freq = pmta0(CORE_FREQ[i]);
-        freqeff = pmta0(CORE_FREQEFF[i]);
-        c0 = pmta0(CORE_C0[i]);
-        cc1 = pmta0(CORE_CC1[i]);
-        irm = pmta0(CORE_IRM[i]);
-        
-        if (power == 0 && voltage == 0 && fit == 0 && iddmax == 0 && freq == 0 && freqeff == 0 && c0 == 0 && cc1 == 0 && irm == 0 ) {
-            mask = 1 << i;
-        } else {
-            mask = 0 << i;
-        }
-        sysinfo->core_disable_map_pmt = sysinfo->core_disable_map_pmt | mask;
-    }
+    if (energy_enabled())
+        draw_energy_export(hostname);
+
+    if (show_smu_stats)
+        draw_smu_stats_export(hostname);
+
+    if (show_self_stats)
+        draw_self_export(hostname);
+
+    if (show_dist)
+        draw_dist_export(hostname, show_disabled_cores, sysinfo->core_disable_map);
+
+    if (alert_count())
+        draw_alert_export(hostname);
+    
 }
 
 int kbhit(void)
@@ -985,28 +923,79 @@ int init_pmt(pm_table* pmt, unsigned int force) {
     return 0;
 }
 
+static void get_processor_topology(system_info *sysinfo, int init_debug) {
+    topology_fuses f;
+
+    switch (read_processor_topology(&obj, sysinfo, &f)) {
+        case TOPOLOGY_ERR_CCD_FUSES:
+            perror("Failed to read CCD fuses");
+            exit(-1);
+        case TOPOLOGY_ERR_CORE_FUSE:
+            perror("Failed to read disabled core fuse");
+            exit(-1);
+        case TOPOLOGY_ERR_CCD_CORE_FUSE:
+            perror("Failed to read disabled core fuse for CCD");
+            exit(-1);
+        case TOPOLOGY_ERR_MEMORY:
+            fprintf(stderr, "Could not allocate memory for the core map.\n");
+            exit(-1);
+    }
+
+    if (init_debug) {
+        fprintf(stdout, "\nFamily: 0x%X Model: 0x%X\n", sysinfo->family, sysinfo->model);
+        fprintf(stdout, "ccds: %i ccxs: %i cores: %i cores_per_ccx: %i enabled: %i\n", sysinfo->ccds, sysinfo->ccxs, sysinfo->cores, sysinfo->cores_per_ccx, sysinfo->enabled_cores_count);
+        fprintf(stdout, "core_disable_map: 0x%X tmp: 0x%X pmt: 0x%X core_disable_addr: 0x%X\n", sysinfo->core_disable_map, f.core_disable_map_raw, sysinfo->core_disable_map_pmt, f.core_disable_map_addr);
+        fprintf(stdout, "ccds_present: 0x%X  ccds_down: 0x%X\n", f.ccds_present, f.ccds_down);
+        fprintf(stdout, "ccd_enable_map: 0x%X ccd_disable_map: 0x%X\n", f.ccd_enable_map, f.ccd_disable_map);
+        fprintf(stdout, "\n");
+    }
+}
+
 int init_sysinfo(pm_table* pmt, system_info* sysinfo, int init_debug) {
     unsigned char* pm_buf;
     int pmt_hack_fuse = 0;
+    topocache_key cache_key;
 
     sysinfo->enabled_cores_count = 1;
 
-    sysinfo->cpu_name    = get_processor_name();
     sysinfo->codename    = smu_codename_to_str(&obj);
     sysinfo->smu_codename= obj.codename;
     sysinfo->smu_fw_ver  = smu_get_fw_version(&obj);
 
+    //Static facts are cached per boot, the debug output needs the real probe
+    if (use_topology_cache && !init_debug) {
+        topocache_make_key(&cache_key, obj.smu_version, obj.pm_table_version);
+        if (topocache_load(sysinfo, &cache_key) == 0) {
+            startup_mark("topology cache hit");
+            goto IF_VERSION;
+        }
+        startup_mark("topology cache miss");
+    }
+
+    sysinfo->cpu_name    = get_processor_name();
+    startup_mark("cpuid brand string");
+
     //PMT hack for core_disabled_map 
-    if (smu_pm_tables_supported(&obj)) {
+    if (smu_pm_tables_supported(&obj) && pmt->version) {
         pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
         if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+            //Point the table at the buffer just read, the one of init_pmt() is gone
+            select_pm_table_version(pmt->version, pmt, pm_buf);
             disabled_cores_from_pmt(pmt, sysinfo);
         }
         free(pm_buf);
+        startup_mark("pm table read (disabled cores)");
     }
    
     get_processor_topology(sysinfo, init_debug);
+    startup_mark("topology (smn fuses)");
+
+    if (use_topology_cache && !init_debug) {
+        topocache_store(sysinfo, &cache_key);
+        startup_mark("topology cache store");
+    }
 
+IF_VERSION:
     switch (obj.smu_if_version) {
         case IF_VERSION_9:  sysinfo->if_ver =  9; break;
         case IF_VERSION_10: sysinfo->if_ver = 10; break;
@@ -1020,6 +1009,8 @@ int init_sysinfo(pm_table* pmt, system_info* sysinfo, int init_debug) {
 }
 
 int start_pm_export() {
+    static char out_buf[1 << 16];
+    unsigned long long span, next, now;
     unsigned char* pm_buf;
     int err = 0;
     int ret;
@@ -1042,16 +1033,37 @@ int start_pm_export() {
         }
         else if (fdpipe > 0) {
             close(fdpipe);
-            setvbuf(stdout, NULL, _IONBF, 0);
+            //One write per sample, flushed before the pipe is closed
+            fflush(stdout);
+            setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+            next = get_time_ns();
             while (1) {
                 fdpipe = open(pm_export_pipe, O_WRONLY);
                 dup2(fdpipe, 1);
+                span = self_span_begin();
                 if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) != SMU_Return_OK)
                     continue;
+                self_span_end(SELF_STAGE_READ, span);
+                span = self_span_begin();
+                energy_update(&pmt, &sysinfo);
+                derived_update(&pmt, &sysinfo);
+                dist_update(now = get_time_ns());
+                alert_update(&pmt, &sysinfo, now);
+                self_span_end(SELF_STAGE_AGGREGATE, span);
+                span = self_span_begin();
                 draw_export(&pmt, &sysinfo);
+                self_span_end(SELF_STAGE_RENDER, span);
+                span = self_span_begin();
                 fflush(NULL);
+                self_span_end(SELF_STAGE_WRITE, span);
                 close(fdpipe);
-                sleep(export_update_time_s);
+                self_tick();
+                if (low_perturbation) {
+                    next += export_update_time_s * 1000000000ULL;
+                    lowpert_wait_until(next, 0);
+                } else {
+                    sleep(export_update_time_s);
+                }
             }
         }
         close(fdpipe);
@@ -1069,7 +1081,84 @@ int start_pm_export() {
     return err;
 }
 
+//Applies a key pressed in monitor mode, returns 1 to quit
+static int monitor_key(int kpress) {
+    if (kpress == 113 || kpress == 81) return 1;
+    if (kpress == 99  || kpress == 67) view_compact ^= 1;
+    if (kpress == 105 || kpress == 73) view_info ^= 1;
+    if (kpress == 111 || kpress == 79) view_counts ^= 1;
+    if (kpress == 101 || kpress == 69) view_electrical ^= 1;
+    if (kpress == 109 || kpress == 67) view_memory ^= 1;
+    if (kpress == 103 || kpress == 71) view_gfx ^= 1;
+    if (kpress == 112 || kpress == 80) view_power ^= 1;
+    if (kpress == 115 || kpress == 83) selfstats_enable(show_self_stats ^= 1);
+    if (kpress == 100 || kpress == 68) dist_enable(show_dist ^= 1, 0);
+    return 0;
+}
+
+static void monitor_frame(unsigned int test_export) {
+    unsigned long long span;
+
+    span = self_span_begin();
+    fprintf(stdout, "\e[1;1H"); //Move cursor to (1,1) 
+    if (test_export) {
+        fprintf(stdout, "\e[2J\e[1;1H"); //Clear entire screen;Move cursor to (1,1) 
+        draw_export(&pmt, &sysinfo);
+    } else {
+        draw_screen(&pmt, &sysinfo);
+    }
+    self_span_end(SELF_STAGE_RENDER, span);
+    span = self_span_begin();
+    fflush(stdout);
+    self_span_end(SELF_STAGE_WRITE, span);
+}
+
+//One wakeup per sample on an absolute deadline, keys are only read when they arrive
+static void start_pm_monitor_quiet(unsigned char *pm_buf, unsigned int test_export) {
+    unsigned long long span, next, now, period = update_time_s * 1000000000ULL;
+    int tty, key, have_table = 0, exit_loop = 0;
+
+    tty = lowpert_tty_begin();
+    fprintf(stdout, "\e[2J\e[1;1H"); //Clear entire screen;Move cursor to (1,1) 
+    fprintf(stdout, "\e[?25l"); // Hide Cursor
+
+    next = get_time_ns();
+    while (!exit_loop) {
+        span = self_span_begin();
+        if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+            self_span_end(SELF_STAGE_READ, span);
+            span = self_span_begin();
+            energy_update(&pmt, &sysinfo);
+            derived_update(&pmt, &sysinfo);
+            dist_update(now = get_time_ns());
+            alert_update(&pmt, &sysinfo, now);
+            self_span_end(SELF_STAGE_AGGREGATE, span);
+            monitor_frame(test_export);
+            self_tick();
+            have_table = 1;
+        }
+
+        //A late sample moves the schedule instead of bunching up the next ones
+        next += period;
+        if (next <= (now = get_time_ns()))
+            next = now + period;
+
+        while ((key = lowpert_wait_until(next, tty)) >= 0) {
+            if ((exit_loop = monitor_key(key)))
+                break;
+            fprintf(stdout, "\e[2J"); //Clear entire screen
+            if (have_table)
+                monitor_frame(test_export);
+        }
+    }
+
+    lowpert_tty_end();
+    fprintf(stdout, "\e[?25h"); // Unhide Cursor
+}
+
 void start_pm_monitor(unsigned int force, unsigned int test_export) {
+    static char out_buf[1 << 16];
+    unsigned long long span, now;
     unsigned char *pm_buf;
     int exit_loop = 0;
 
@@ -1081,6 +1170,15 @@ void start_pm_monitor(unsigned int force, unsigned int test_export) {
     int restupdate = 0, draw_update = 0;
     int sleepms = 200;
 
+    //Whole frames go out in one write
+    fflush(stdout);
+    setvbuf(stdout, out_buf, _IOFBF, sizeof(out_buf));
+
+    if (low_perturbation) {
+        start_pm_monitor_quiet(pm_buf, test_export);
+        return;
+    }
+
     fprintf(stdout, "\e[2J\e[1;1H"); //Clear entire screen;Move cursor to (1,1) 
     fprintf(stdout, "\e[?25l"); // Hide Cursor
 
@@ -1090,14 +1188,7 @@ void start_pm_monitor(unsigned int force, unsigned int test_export) {
         if (kbhit()){
             sleepms = 0;
             kpress = getchar();
-            if (kpress == 113 || kpress == 81) exit_loop = 1;
-            if (kpress == 99  || kpress == 67) view_compact ^= 1;
-            if (kpress == 105 || kpress == 73) view_info ^= 1;
-            if (kpress == 111 || kpress == 79) view_counts ^= 1;
-            if (kpress == 101 || kpress == 69) view_electrical ^= 1;
-            if (kpress == 109 || kpress == 67) view_memory ^= 1;
-            if (kpress == 103 || kpress == 71) view_gfx ^= 1;
-            if (kpress == 112 || kpress == 80) view_power ^= 1;
+            exit_loop = monitor_key(kpress);
             sleepms = 200;
             draw_update = 1;
             fprintf(stdout, "\e[2J\e[1;1H"); //Clear entire screen;Move cursor to (1,1) 
@@ -1105,17 +1196,19 @@ void start_pm_monitor(unsigned int force, unsigned int test_export) {
 
 
         if (restupdate <= 0 || draw_update) {
+            span = self_span_begin();
             if (smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK) {
+                self_span_end(SELF_STAGE_READ, span);
+                span = self_span_begin();
+                energy_update(&pmt, &sysinfo);
+                derived_update(&pmt, &sysinfo);
+                dist_update(now = get_time_ns());
+                alert_update(&pmt, &sysinfo, now);
+                self_span_end(SELF_STAGE_AGGREGATE, span);
                 msleep(sleepms);
 
-                fprintf(stdout, "\e[1;1H"); //Move cursor to (1,1) 
-                if (test_export) {
-                    fprintf(stdout, "\e[2J\e[1;1H"); //Clear entire screen;Move cursor to (1,1) 
-                    draw_export(&pmt, &sysinfo);
-                } else {
-                    draw_screen(&pmt, &sysinfo);
-                }
-                fflush(stdout);
+                monitor_frame(test_export);
+                self_tick();
 
                 draw_update = 0;
             }
@@ -1130,53 +1223,150 @@ void start_pm_monitor(unsigned int force, unsigned int test_export) {
 
 }
 
-void read_from_dumpfile(char *dumpfile, unsigned int version, unsigned int test_export, unsigned int dump_table) {
-    unsigned char readbuf[10240];
-    unsigned char dumpbuf[10240];
-    unsigned int bytes_read;
-    int i;
-    float v;
+//Plays a recording through the same decode and render path as the live monitor.
+//speed is a multiple of real time, 0 runs as fast as possible and reports the throughput.
+int replay_recording(char *path, unsigned int version, float speed, unsigned int test_export) {
+    unsigned long long t, t_first = 0, wall_first = 0, target, now, start, decode_ns = 0, render_ns = 0;
+    unsigned char *pm_buf;
+    unsigned long samples = 0;
     pm_table pmt;
     system_info sysinfo;
-    FILE *fd;
+    recording rec;
+    int ret, err = 0;
+
+    if (recording_open(&rec, path, version) != 0)
+        return -1;
+    if (rec.dump)
+        dumpfile_print_header(&rec.dump_hdr, path);
 
-    if (!version) {
-        fprintf(stderr, "You need to specify a PM Table version with -f.\n");
-        exit(0);
+    //The PM table fields must stay inside the buffer even for a short sample
+    pm_buf = calloc(rec.table_size > 10240 ? rec.table_size : 10240, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(rec.version, &pmt, pm_buf)) {
+        fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", rec.version);
+        free(pm_buf);
+        recording_close(&rec);
+        return -1;
+    }
+    if (rec.table_size < pmt.min_size) {
+        fprintf(stderr, "Samples in \"%s\" are %d bytes, but the selected PM Table is %d bytes long.\n", path, rec.table_size, pmt.min_size);
+        free(pm_buf);
+        recording_close(&rec);
+        return -1;
     }
+    memset(&sysinfo, 0, sizeof(sysinfo));
+
+    if (!test_export)
+        fprintf(stdout, "\e[2J\e[1;1H\e[?25l"); //Clear entire screen;Move cursor to (1,1);Hide Cursor
+
+    while (1) {
+        start = get_time_ns();
+        if ((ret = recording_read(&rec, &t, pm_buf)) <= 0) {
+            if (ret == -2) {
+                fprintf(stderr, "Sample %lu in \"%s\" failed its checksum.\n", samples, path);
+                err = -1;
+            } else if (ret < 0) {
+                fprintf(stderr, "Truncated sample %lu in \"%s\".\n", samples, path);
+                err = -1;
+            }
+            break;
+        }
+        sysinfo_from_pmt(&pmt, &sysinfo);
+        if (rec.dump)
+            dumpfile_apply_sysinfo(&rec.dump_hdr, &sysinfo);
+        derived_update(&pmt, &sysinfo);
+        dist_update(t);
+        alert_update(&pmt, &sysinfo, t);
+        self_span_end(SELF_STAGE_DECODE, start);
+        now = get_time_ns();
+        decode_ns += now - start;
+
+        if (speed > 0) {
+            if (!samples) {
+                t_first = t;
+                wall_first = now;
+            }
+            target = wall_first + (unsigned long long)((t - t_first) / speed);
+            if (target > now)
+                msleep((target - now) / 1000000);
+        }
 
-    //Read file
-    fd = fopen(dumpfile, "rb");
-    if(!fd) {
-        fprintf(stderr, "Could not read the dumpfile (\"%s\").\n", dumpfile);
-        exit(0);
+        start = get_time_ns();
+        if (test_export) {
+            draw_export(&pmt, &sysinfo);
+        } else {
+            fprintf(stdout, "\e[1;1H"); //Move cursor to (1,1)
+            draw_screen(&pmt, &sysinfo);
+        }
+        self_span_end(SELF_STAGE_RENDER, start);
+        fflush(stdout);
+        render_ns += get_time_ns() - start;
+        self_tick();
+        samples++;
     }
-    bytes_read=fread(readbuf,sizeof(char),sizeof(readbuf),fd);
-    fclose(fd);
 
-    //Select matching PM Table
-    if(!select_pm_table_version(version, &pmt, readbuf)) {
-        fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", version);
-        exit(0);
+    if (!test_export)
+        fprintf(stdout, "\e[?25h"); // Unhide Cursor
+
+    if (speed <= 0 && samples) {
+        fprintf(stderr, "Replayed %lu samples of PM Table 0x%X\n", samples, rec.version);
+        fprintf(stderr, "  decode: %10.0f samples/s, %8.0f ns/sample\n", samples * 1e9 / (decode_ns ? decode_ns : 1), (double)decode_ns / samples);
+        fprintf(stderr, "  render: %10.0f samples/s, %8.0f ns/sample\n", samples * 1e9 / (render_ns ? render_ns : 1), (double)render_ns / samples);
     }
-    else fprintf(stderr, "Using PM Table version 0x%x.\n", version);
 
-    //Prevent illegal memory access
-    if (bytes_read < pmt.min_size) {
-        fprintf(stderr, "Read %d bytes from \"%s\", but the selected PM Table is %d bytes long.\n", bytes_read, dumpfile, pmt.min_size);
-        exit(0);
+    free(pm_buf);
+    recording_close(&rec);
+    return err;
+}
+
+//Decodes one snapshot of a dumpfile, the version of a legacy raw dump comes from -f
+int read_from_dumpfile(char *dumpfile, unsigned int version, int snapshot, unsigned int test_export, unsigned int dump_table) {
+    unsigned long long t;
+    unsigned char *pm_buf;
+    unsigned int i;
+    int n, ret;
+    pm_table pmt;
+    system_info sysinfo;
+    recording rec;
+
+    if (recording_open(&rec, dumpfile, version) != 0)
+        return -1;
+    if (rec.dump)
+        dumpfile_print_header(&rec.dump_hdr, dumpfile);
+
+    //The PM table fields must stay inside the buffer even for a short dump
+    pm_buf = calloc(rec.table_size > 10240 ? rec.table_size : 10240, sizeof(unsigned char));
+    if (!pm_buf || !select_pm_table_version(rec.version, &pmt, pm_buf)) {
+        fprintf(stderr, "This PM Table version (0x%x) is currently not supported.\n", rec.version);
+        free(pm_buf);
+        recording_close(&rec);
+        return -1;
+    }
+    else fprintf(stderr, "Using PM Table version 0x%x.\n", rec.version);
+
+    for (n = 0; (ret = recording_read(&rec, &t, pm_buf)) > 0 && n < snapshot; n++);
+    recording_close(&rec);
+    if (ret <= 0) {
+        if (ret == -2)
+            fprintf(stderr, "Snapshot %d in \"%s\" failed its checksum.\n", n, dumpfile);
+        else if (ret < 0)
+            fprintf(stderr, "Snapshot %d in \"%s\" is truncated.\n", n, dumpfile);
+        else
+            fprintf(stderr, "\"%s\" has %d snapshot%s, there is no snapshot %d.\n", dumpfile, n, n == 1 ? "" : "s", snapshot);
+        free(pm_buf);
+        return -1;
     }
-    
-    sysinfo.available=0; //Did not read sysinfo
-    sysinfo.cores = pmt.max_cores;
-    sysinfo.physical_cores = pmt.max_cores;
-    sysinfo.ccds = pmt.max_cores > 8 ? 2 : 1;
-    sysinfo.ccxs = pmt.zen_version == 3 ? sysinfo.ccds : sysinfo.ccds * 2;
 
-    disabled_cores_from_pmt(&pmt, &sysinfo);
+    //Prevent illegal memory access
+    if (rec.table_size < pmt.min_size) {
+        fprintf(stderr, "Read %d bytes from \"%s\", but the selected PM Table is %d bytes long.\n", rec.table_size, dumpfile, pmt.min_size);
+        free(pm_buf);
+        return -1;
+    }
 
-    sysinfo.core_disable_map=sysinfo.core_disable_map_pmt;
-    sysinfo.enabled_cores_count=sysinfo.cores-count_set_bits(sysinfo.core_disable_map);
+    sysinfo_from_pmt(&pmt, &sysinfo);
+    if (rec.dump)
+        dumpfile_apply_sysinfo(&rec.dump_hdr, &sysinfo);
+    derived_update(&pmt, &sysinfo);
 
     if (test_export)
         draw_export(&pmt, &sysinfo);
@@ -1185,59 +1375,52 @@ void read_from_dumpfile(char *dumpfile, unsigned int version, unsigned int test_
 
     if (dump_table) {
         fprintf(stdout, "\n\n");
-        fd = fopen(dumpfile, "rb");
-        //fread(dumpbuf,sizeof(char),sizeof(dumpbuf),fd);
-        i = 0;
-        while (1){
-            fread((void*)(&v), sizeof(v), 1, fd);
-            if( feof(fd) ) 
-                break ;
-            fprintf(stdout, "%i\t%f\n", i, v );
-            i++;
-        }
-        fclose(fd);
+        for (i = 0; i < rec.table_size / sizeof(float); i++)
+            fprintf(stdout, "%i\t%f\n", i, ((float *)pm_buf)[i]);
     }
 
     fprintf(stdout, "\e[?25h"); // Unhide Cursor
 
+    free(pm_buf);
+    return 0;
 }
 
-int write_to_dumpfile(char *dumpfile) {
-    char *buf = (char*) malloc(BUF_SIZE* sizeof(char));
-    unsigned int bytes_written = 0;
-    size_t in, out;
-    FILE *src, *dst;
-    char* pmtv = malloc(sizeof(obj.pm_table_version)+1);
-    sprintf(pmtv, "%X_", obj.pm_table_version);
-    char* filename = (char*)malloc(sizeof(pmtv) + sizeof(dumpfile));
-    strcat(filename, pmtv);
-    strcat(filename, dumpfile);
-
-    src = fopen("/sys/kernel/ryzen_smu_drv/pm_table", "rb");
-    dst = fopen(filename, "wb");
-
-    if(!dst) {
-        fprintf(stderr, "Could not create the dumpfile (\"%s\").\n", filename);
-        return -4;
-    } else if (!src){
-        fprintf(stderr, "Could not read the PM table from kernel.\n");
-        return -4;
-    } else {
-        while (1) {
-            in = fread(buf, sizeof(char), BUF_SIZE, src);
-            if (0 == in) break;
-            out = fwrite(buf, sizeof(char), in, dst);
-            bytes_written += (int)out;
-            if (0 == out) break;
+int print_memory_timings(const char *format_str, int watch) {
+    enum dram_format format;
+    dram_timings timings[2];
+    int cur = 0;
+
+    char hostname[HOST_NAME_MAX + 1];
+    gethostname(hostname, HOST_NAME_MAX + 1);
+    remove_spaces(hostname);
+
+    if (dram_timings_parse_format(format_str, &format) != 0) {
+        fprintf(stderr, "Unknown timings format \"%s\", use text, json or influx.\n", format_str);
+        return -1;
+    }
+
+    if (dram_timings_read(&timings[cur]) != 0) {
+        fprintf(stderr, "Unable to read SMN address space.\n");
+        return -5;
+    }
+    dram_timings_print(&timings[cur], format, hostname);
+    fflush(stdout);
+
+    //Watch mode, only report what changed since the previous read
+    while (watch) {
+        sleep(update_time_s);
+        if (dram_timings_read(&timings[cur ^ 1]) != 0) {
+            if (debuglog) fprintf(stderr, "Unable to read SMN address space.\n");
+            continue;
         }
-        fprintf(stdout, "Written %i bytes in dumpfile (\"%s\").\n", bytes_written, filename);
+        if (dram_timings_print_changes(&timings[cur], &timings[cur ^ 1], format, hostname))
+            fflush(stdout);
+        cur ^= 1;
     }
-    free(pmtv);
-    free(filename);
+
     return 0;
 }
 
-
 void print_version() {
     fprintf(stdout, "Ryzen Monitor v" PROGRAM_VERSION " (NG)\n");
     exit(0);
@@ -1248,8 +1431,20 @@ void signal_interrupt(int sig) {
         case SIGINT:
         case SIGABRT:
         case SIGTERM:
-           // Re-enable the cursor.
+           // Let the governor restore the original limits before leaving
+           if (governor_active()) {
+               governor_stop();
+               break;
+           }
+           // The sweep puts the core back to its last stable count after the step in progress
+           if (cosweep_active()) {
+               cosweep_stop();
+               break;
+           }
+           // Re-enable the cursor and the terminal echo.
            fprintf(stdout, "\e[?25h");
+           lowpert_tty_end();
+           if (show_smu_stats) print_smu_stats(stderr);
            smu_free(&obj); 
            if (fdpipe != 0) {
                close(fdpipe);
@@ -1290,18 +1485,44 @@ int main(int argc, const char** argv) {
     smu_return_val ret;
 
     int helpinfo=0, versioninfo=0, memorytimings=0, err=0, skip=0, cmdmode=0;
-    int printtimings=0, force_update_time_s=0, test_export=0;
-    int forcetable=0, dumptable=0, init_debug=0;
+    int discover=0, discover_time=3, discover_rate=100;
+    int load_duty=100, load_time=5, load_smt=0;
+    char *load_kernel = NULL;
+    char *load_cores = NULL;
+    int co_sweep=0, sweep_step=5, sweep_min=-30, sweep_time=30;
+    char *sweep_cores = NULL;
+    char *sweep_out = NULL;
+    int printtimings=0, timings_watch=0, force_update_time_s=0, test_export=0;
+    int forcetable=0, dumptable=0, init_debug=0, no_topology_cache=0, smu_cache_ttl=-1;
     int tview_compact=0, tview_info=0, tview_counts=0, tview_electrical=0, tview_memory=0, tview_gfx=0, tview_power=0;
     int set_enable_oc=0, set_disable_oc=0, get_ocmode=0, set_enable_eco=0, set_enable_maxperf=0;
     int get_ppt=0, get_pptfast=0, get_pptapu=0, get_tdc=0, get_tdcsoc=0, get_edc=0, get_edcsoc=0, get_stapm=0, get_ppt_time=0, get_stapm_time=0, get_thm=0, get_scalar=0, get_cocountall=0;
     int set_ppt=0, set_pptfast=0, set_pptapu=0, set_tdc=0, set_tdcsoc=0, set_edc=0, set_edcsoc=0, set_stapm=0, set_ppt_time=0, set_stapm_time=0, set_thm=0, set_scalar=0, set_cocountall=0;
 
     char *set_cocount = NULL;
+    char *apply_profile = NULL;
     char *dumpfile = NULL;
     char *writedump = NULL;
+    char *record_file = NULL;
+    char *replay_file = NULL;
+    int record_count = 0, dump_count = 1, dump_snapshot = 0;
+    float replay_speed = 1;
+    int bench=0, housekeeping_cpu=0, dist_window=0, alert_syslog=0;
+    char *alert_rules = NULL, *alert_file = NULL, *alert_exec = NULL, *alert_socket = NULL;
+    char *sample_sources = NULL, *sample_root = NULL;
+    char *columnar_file = NULL, *query_file = NULL, *query_select = NULL, *query_where = NULL;
+    int columnar_chunk = 0, query_rows = 0;
+    int sample_interval = 1000, sample_count = 0;
+    bench_config bench_cfg = { NULL, BENCH_DEFAULT_ITERATIONS, BENCH_DEFAULT_WARMUP };
     char *forcetablestr = NULL;
     char *get_cocount = NULL;
+    char *energy_cgroups = NULL;
+    char *energy_pids = NULL;
+    char *timings_format = NULL;
+    float gov_socket_power = 0, gov_package_power = 0, gov_temp = 0;
+    governor_config gov;
+
+    governor_defaults(&gov);
  
     //Set up signal handlers
     if ((signal(SIGABRT, signal_interrupt) == SIG_ERR) ||
@@ -1317,16 +1538,68 @@ int main(int argc, const char** argv) {
             OPT_BOOLEAN('h', "help", &helpinfo, "Show this help screen."),
             OPT_BOOLEAN('v', "version", &versioninfo, "Show program version."),
             OPT_BOOLEAN('m', "timings", &printtimings, "Print DRAM Timings and exit."),
+            OPT_BOOLEAN('\0', "timings-watch", &timings_watch, "Re-read DRAM Timings every update interval and print the changes."),
+            OPT_STRING('\0', "timings-format", &timings_format, "DRAM Timings output format: text, json or influx. Defaults to text."),
             OPT_BOOLEAN('d', "disabled", &show_disabled_cores, "Show disabled cores."),
             OPT_INTEGER('u', "update", &force_update_time_s, "Update refresh for monitoring, in seconds. Defaults to 1."),
-            OPT_STRING('t', "dumpfile", &dumpfile, "Test mode, Read PM Table from raw-dumpfile. Must be used with -f."),
-            OPT_STRING('w', "writedump", &writedump, "Write PM Table to raw-dumpfile. PM Table version will prepend the filename."),
+            OPT_STRING('t', "dumpfile", &dumpfile, "Test mode, Read PM Table from a dumpfile. A legacy raw-dumpfile needs -f."),
+            OPT_INTEGER('\0', "snapshot", &dump_snapshot, "Snapshot of the dumpfile shown by -t (Starting 0). Defaults to 0."),
+            OPT_STRING('w', "writedump", &writedump, "Write the PM Table to a dumpfile, with a header describing the system."),
+            OPT_INTEGER('\0', "dump-count", &dump_count, "Snapshots written by -w, one every update interval. Defaults to 1."),
             OPT_STRING('f', "forcetable", &forcetablestr, "Force to use a specific PM table version (Hex value)."),
+            OPT_STRING('\0', "record", &record_file, "Record the PM Table every update interval to a file, replay it with --replay."),
+            OPT_INTEGER('\0', "record-count", &record_count, "Samples to record, 0 records until interrupted. Defaults to 0."),
+            OPT_STRING('\0', "replay", &replay_file, "Replay a recording or dumpfile through the monitor, or the export with --test-export. A legacy raw-dumpfile needs -f."),
+            OPT_STRING('\0', "columnar", &columnar_file, "Convert the recording or dumpfile given with --replay to a columnar file instead of playing it."),
+            OPT_INTEGER('\0', "columnar-chunk", &columnar_chunk, "Rows per columnar chunk, the unit a query skips by. Defaults to 4096."),
+            OPT_STRING('\0', "query", &query_file, "Scan a columnar file. Lists its columns without --query-select."),
+            OPT_STRING('\0', "query-select", &query_select, "Columns to summarize, separate with comma for multiple."),
+            OPT_STRING('\0', "query-where", &query_where, "Only rows matching \"<column> <op> <value>\", op is one of > >= < <= ==."),
+            OPT_BOOLEAN('\0', "query-rows", &query_rows, "Print the matching rows instead of a summary."),
+            OPT_FLOAT('\0', "replay-speed", &replay_speed, "Replay speed as a multiple of the recorded pace, 0 runs at full speed and prints the throughput. Defaults to 1."),
+            OPT_BOOLEAN('\0', "bench", &bench, "Benchmark decode, aggregation, screen and export for every supported PM table, JSON to stdout."),
+            OPT_STRING('\0', "bench-dumps", &bench_cfg.dump_dir, "Directory with dumpfiles written by -w, synthetic tables are used for versions without one."),
+            OPT_INTEGER('\0', "bench-iterations", &bench_cfg.iterations, "Timed calls per benchmark stage. Defaults to 2000."),
+            OPT_INTEGER('\0', "bench-warmup", &bench_cfg.warmup, "Untimed calls before every benchmark stage. Defaults to 200."),
             OPT_BOOLEAN('\0', "dumptable", &dumptable, "Dump table on screen. Can be used with -t."),
             OPT_STRING('e', "export", &pm_export_pipe, "Export metrics mode to a named pipe, Influx inline protocol."),
+            OPT_BOOLEAN('\0', "discover", &discover, "Sample the raw PM table under pinned per-core load phases and print a candidate layout."),
+            OPT_INTEGER('\0', "discover-time", &discover_time, "Seconds for each discovery phase. Defaults to 3."),
+            OPT_INTEGER('\0', "discover-rate", &discover_rate, "Discovery PM table samples per second. Defaults to 100."),
+            OPT_STRING('\0', "load", &load_kernel, "Characterize cores under pinned load: scalar, fma, l3, dram or verify kernel."),
+            OPT_STRING('\0', "load-cores", &load_cores, "Cores to load, separate with comma for multiple (Starting 0). Defaults to all."),
+            OPT_INTEGER('\0', "load-duty", &load_duty, "Load duty cycle in percent. Defaults to 100."),
+            OPT_INTEGER('\0', "load-time", &load_time, "Seconds for each load phase. Defaults to 5."),
+            OPT_BOOLEAN('\0', "load-smt", &load_smt, "Load both SMT siblings of every core."),
+            OPT_BOOLEAN('\0', "co-sweep", &co_sweep, "Walk the CO count of every core down under a self-verifying load and keep the last stable one."),
+            OPT_STRING('\0', "sweep-cores", &sweep_cores, "Cores to sweep, separate with comma for multiple (Starting 0). Defaults to all."),
+            OPT_INTEGER('\0', "sweep-step", &sweep_step, "CO counts between sweep steps. Defaults to 5."),
+            OPT_INTEGER('\0', "sweep-min", &sweep_min, "Lowest CO count tried by the sweep. Defaults to -30."),
+            OPT_INTEGER('\0', "sweep-time", &sweep_time, "Seconds of load at every sweep step. Defaults to 30."),
+            OPT_STRING('\0', "sweep-out", &sweep_out, "Write the stable CO counts found to a profile file."),
             OPT_BOOLEAN('\0', "init-debug", &init_debug, "Print initialization debug info and exit."),
             OPT_BOOLEAN('\0', "debuglog", &debuglog, "Print out debug error messages."),
+            OPT_BOOLEAN('\0', "startup-profile", &startup_profile, "Print per-phase startup timings to stderr."),
+            OPT_BOOLEAN('\0', "stats", &show_smu_stats, "Print SMU command, PM table and SMN read statistics to stderr on exit, also added to the export."),
+            OPT_BOOLEAN('\0', "self-stats", &show_self_stats, "Time every stage of the sampling loop, shown as a footer in monitor (key s) and added to the export."),
+            OPT_BOOLEAN('\0', "dist", &show_dist, "Keep per-core frequency, voltage, temperature and power distributions, shown in monitor (key d) and exported once per window."),
+            OPT_INTEGER('\0', "dist-window", &dist_window, "Seconds covered by one distribution window. Defaults to 60."),
+            OPT_STRING('\0', "sample", &sample_sources, "Sample pmt, hwmon, cpufreq and rapl in the same tick and print aligned records, separate with comma or use all."),
+            OPT_STRING('\0', "sample-root", &sample_root, "Directory the sysfs paths of --sample are read under, for a mock tree."),
+            OPT_INTEGER('\0', "sample-interval", &sample_interval, "Milliseconds between --sample ticks. Defaults to 1000."),
+            OPT_INTEGER('\0', "sample-count", &sample_count, "Stop --sample after this many ticks."),
+            OPT_STRING('\0', "alert", &alert_rules, "Alert rules like \"CORE_TEMP[*] > 90 for 2s hyst 5\", separate with ; for multiple."),
+            OPT_STRING('\0', "alert-file", &alert_file, "Read alert rules from a file, one per line."),
+            OPT_STRING('\0', "alert-exec", &alert_exec, "Run a shell command on every alert event, details are in ALERT_* environment variables."),
+            OPT_BOOLEAN('\0', "alert-syslog", &alert_syslog, "Log alert events to syslog."),
+            OPT_STRING('\0', "alert-socket", &alert_socket, "Send alert events as JSON datagrams to a unix socket."),
+            OPT_BOOLEAN('\0', "low-perturbation", &low_perturbation, "Pin to one CPU, wake up once per update with a large timer slack, don't poll the keyboard. Wakeups are shown with --self-stats."),
+            OPT_INTEGER('\0', "housekeeping-cpu", &housekeeping_cpu, "CPU the low-perturbation mode runs on. Defaults to 0."),
+            OPT_BOOLEAN('\0', "no-topology-cache", &no_topology_cache, "Don't use the startup topology cache in " TOPOCACHE_DIR "."),
+            OPT_INTEGER('\0', "smu-cache-ttl", &smu_cache_ttl, "Milliseconds SMU read values like scalar and CO counts are cached, 0 disables. Defaults to 10000."),
             OPT_BOOLEAN('\0', "test-export", &test_export, "Export metrics mode to console for testing purpose, can be used with a raw-dumpfile."),
+            OPT_STRING('\0', "energy-cgroup", &energy_cgroups, "Export energy attribution for cgroups, separate with comma for multiple (cgroup v1 cpuacct or v2)."),
+            OPT_STRING('\0', "energy-pid", &energy_pids, "Export energy attribution for processes, separate with comma for multiple PIDs."),
             OPT_BOOLEAN('c', "compact", &tview_compact, "Toggle compact view in monitor."),
             OPT_BOOLEAN('\0', "t-info", &tview_info, "Toggle view Info in monitor."),
             OPT_BOOLEAN('\0', "t-counts", &tview_counts, "Toggle view Counts in monitor."),
@@ -1334,6 +1607,17 @@ int main(int argc, const char** argv) {
             OPT_BOOLEAN('\0', "t-memory", &tview_memory, "Toggle view Memory in monitor."),
             OPT_BOOLEAN('\0', "t-gfx", &tview_gfx, "Toggle view GFX in monitor."),
             OPT_BOOLEAN('\0', "t-power", &tview_power, "Toggle view Power in monitor."),
+            OPT_GROUP("Governor"),
+            OPT_FLOAT('\0', "gov-socket-power", &gov_socket_power, "Hold socket power at this value (W) adjusting PPT."),
+            OPT_FLOAT('\0', "gov-package-power", &gov_package_power, "Hold package power at this value (W) adjusting PPT."),
+            OPT_FLOAT('\0', "gov-temp", &gov_temp, "Hold temperature at this value (degree C) adjusting PPT."),
+            OPT_FLOAT('\0', "gov-hysteresis", &gov.hysteresis, "Governor dead band around the target. Defaults to 2."),
+            OPT_FLOAT('\0', "gov-kp", &gov.kp, "Governor proportional gain, W of PPT per unit of error. Defaults to 0.5."),
+            OPT_FLOAT('\0', "gov-ki", &gov.ki, "Governor integral gain, W of PPT per unit of error per second. Defaults to 0.2."),
+            OPT_INTEGER('\0', "gov-min-ppt", &gov.min_ppt, "Governor lowest PPT Limit (W). Defaults to 30."),
+            OPT_INTEGER('\0', "gov-max-ppt", &gov.max_ppt, "Governor highest PPT Limit (W). Defaults to the limit at start."),
+            OPT_INTEGER('\0', "gov-max-step", &gov.max_step, "Governor largest PPT change per update (W). Defaults to 5."),
+            OPT_BOOLEAN('\0', "gov-current", &gov.scale_current, "Governor scales TDC and EDC Limits along with PPT."),
             OPT_GROUP("Get operations"),
             OPT_BOOLEAN('\0', "get-ppt", &get_ppt, "Get PPT Limit (W)", set_cmdmode, 0, 0),
             OPT_BOOLEAN('\0', "get-pptfast", &get_pptfast, "Get PPT Fast Limit (W)", set_cmdmode, 0, 0),
@@ -1369,6 +1653,7 @@ int main(int argc, const char** argv) {
             OPT_INTEGER('\0', "set-scalar", &set_scalar, "Set PBO Scalar", set_cmdmode, 0, 0),
             OPT_STRING('\0', "set-cocount", &set_cocount, "Set CO count for Cores (n+/-30 - syntax: 0+10,1+0,2-20,3-0)", set_cmdmode, 0, 0),
             OPT_INTEGER('\0', "set-cocountall", &set_cocountall, "Set CO count for all Cores (+/-30)", set_cmdmode, 0, 0),
+            OPT_STRING('\0', "apply-profile", &apply_profile, "Apply a tuning profile file in one batch, rolled back if any value doesn't stick", set_cmdmode, 0, 0),
             OPT_END(),
     };
     
@@ -1377,11 +1662,23 @@ int main(int argc, const char** argv) {
     argparse_describe(&argparse, "\nRyzen Monitor", "\nVersion: v" PROGRAM_VERSION " (NextGeneration - ManniX fork)\n\nNote: set and get operations will override the other options.\nSet and get operations will report NA for Not Available, ERR for SMU/PMT errors and invalid values\n");
     argc = argparse_parse(&argparse, argc, argv);
 
-    ret = smu_init(&obj);
+    if (no_topology_cache) use_topology_cache = 0;
+    if (smu_cache_ttl >= 0) smu_cache_set_ttl(SMU_CACHE_KINDS, smu_cache_ttl);
+    if (show_self_stats) selfstats_enable(1);
+    dist_enable(show_dist, dist_window > 0 ? dist_window : 0);
+    startup_mark("start");
+
+    //The benchmark times the render path alone, without a target no SMU command goes out
+    ret = bench ? SMU_Return_OK : smu_init(&obj);
+    if (!bench) smu_target_default(&obj);
     if (ret != SMU_Return_OK) {
         fprintf(stderr, "Error accessing SMU: %s\n", smu_return_to_str(ret));
-        err = -3;
+        //Dumpfiles, recordings, columnar files, the benchmark and the sysfs-only sampler run without the SMU
+        if (cmd_mode || !((dumpfile && !printtimings && !timings_watch) || replay_file || query_file || bench
+                          || (sample_sources && !sampler_needs_smu(sample_sources))))
+            err = -3;
     }
+    startup_mark("smu_init");
 
     if (!err && init_debug) {
         err = init_pmt(&pmt, forcetable);
@@ -1397,12 +1694,20 @@ int main(int argc, const char** argv) {
 
         if (!err) {
             err = init_pmt(&pmt, forcetable);
+            startup_mark("init_pmt");
             init_sysinfo(&pmt, &sysinfo, init_debug);
             pmt_refresh(&pmt);            
+            startup_mark("pm table refresh");
         }
 
         if (sysinfo.available && sysinfo.smu_codename != CODENAME_UNDEFINED) {
 
+            if (apply_profile) {
+                tuning_profile profile;
+                err = profile_load(apply_profile, &sysinfo, &profile);
+                if (!err)
+                    err = profile_apply(&pmt, &sysinfo, &profile);
+            }
             if (set_enable_oc) cmd_set_enable_oc(&sysinfo);
             if (set_enable_eco) cmd_set_enable_eco(&sysinfo);
             if (set_enable_maxperf) cmd_set_enable_maxperf(&sysinfo);
@@ -1461,9 +1766,7 @@ int main(int argc, const char** argv) {
                 }
                 free(delimpair);
                 free(corecountstr);
-                for (t = 0; t < sysinfo.cores; t++) {
-                     if (cocores[t][tcore] >= 0) cmd_set_cocount(&sysinfo, cocores[t][tcore], cocores[t][tcount]);
-                }
+                if (cc > 0) cmd_set_cocount_batch(&sysinfo, cocores, cc);
             }
             if (set_cocountall) {
                 int count = set_cocountall < -30 ? -30 : set_cocountall > +30 ? +30 : set_cocountall;
@@ -1511,7 +1814,9 @@ int main(int argc, const char** argv) {
             }
             if (get_cocountall) cmd_get_cocountall(&sysinfo);
 
+            startup_mark("commands");
         }
+        startup_done();
 
     } else {
 
@@ -1535,11 +1840,24 @@ int main(int argc, const char** argv) {
             forcetable = (unsigned int)val;
         }
 
-        if(dumpfile && !forcetable) {
-            fprintf(stderr, "Dumpfile must be used in conjuction with forced PM table switch -f.\n");
-            err = -1;
+        if (gov_socket_power > 0) {
+            gov.target = GOV_TARGET_SOCKET_POWER;
+            gov.setpoint = gov_socket_power;
+        } else if (gov_package_power > 0) {
+            gov.target = GOV_TARGET_PACKAGE_POWER;
+            gov.setpoint = gov_package_power;
+        } else if (gov_temp > 0) {
+            gov.target = GOV_TARGET_TEMPERATURE;
+            gov.setpoint = gov_temp;
         }
 
+        if (!err && alert_file && alert_load_file(alert_file) != 0)
+            err = -1;
+        if (!err && alert_rules && alert_compile(alert_rules) != 0)
+            err = -1;
+        if (!err && alert_count() && alert_set_sinks(alert_exec, alert_socket, alert_syslog) != 0)
+            err = -1;
+
         if (tview_compact) view_compact ^= 1;
         if (tview_info) view_info ^= 1;
         if (tview_counts) view_counts ^= 1;
@@ -1551,8 +1869,18 @@ int main(int argc, const char** argv) {
         if (!err) {
             if(versioninfo)
                 print_version();
-            else if(dumpfile && !printtimings)
-                read_from_dumpfile(dumpfile, forcetable, test_export, dumptable);
+            else if(dumpfile && !printtimings && !timings_watch)
+                err = read_from_dumpfile(dumpfile, forcetable, dump_snapshot, test_export, dumptable);
+            else if(replay_file && columnar_file)
+                err = columnar_convert(replay_file, forcetable, columnar_file, columnar_chunk);
+            else if(query_file)
+                err = columnar_query(query_file, query_select, query_where, query_rows);
+            else if(replay_file)
+                err = replay_recording(replay_file, forcetable, replay_speed, test_export);
+            else if(bench)
+                err = bench_run(&bench_cfg);
+            else if(sample_sources && !sampler_needs_smu(sample_sources))
+                err = sampler_run(sample_sources, sample_root, sample_interval, sample_count, NULL, NULL);
             else 
                 {
                 
@@ -1562,17 +1890,70 @@ int main(int argc, const char** argv) {
                 }
 
                 if (!err) {
-                    ret = smu_init(&obj);
-                    if (ret != SMU_Return_OK) {
-                        fprintf(stderr, "Error accessing SMU: %s\n", smu_return_to_str(ret));
-                        err = -3;
-                    }
+                    //SMU was initialized already, err would be set otherwise
                     if (!err) {
                         if(writedump){
-                            err = write_to_dumpfile(writedump);
+                            //Tables of unsupported versions are dumped as well, the PM table only refines the core map
+                            init_pmt(&pmt, forcetable);
+                            init_sysinfo(&pmt, &sysinfo, init_debug);
+                            if (force_update_time_s)
+                                update_time_s = force_update_time_s;
+                            err = dumpfile_write(writedump, &sysinfo, dump_count, update_time_s * 1000);
                         }
-                        else if(printtimings) {
-                            print_memory_timings();
+                        else if(record_file) {
+                            if (force_update_time_s)
+                                update_time_s = force_update_time_s;
+                            err = record_run(record_file, update_time_s * 1000, record_count);
+                        }
+                        else if(sample_sources) {
+                            err = init_pmt(&pmt, forcetable);
+                            init_sysinfo(&pmt, &sysinfo, init_debug);
+                            if (!err)
+                                err = sampler_run(sample_sources, sample_root, sample_interval, sample_count, &pmt, &sysinfo);
+                        }
+                        else if(printtimings || timings_watch) {
+                            if (force_update_time_s)
+                                update_time_s = force_update_time_s;
+                            err = print_memory_timings(timings_format, timings_watch);
+                        }
+                        else if(discover) {
+                            //The table version is likely unknown, don't bind the PM table
+                            memset(&pmt, 0, sizeof(pmt));
+                            init_sysinfo(&pmt, &sysinfo, init_debug);
+                            err = discover_run(&sysinfo, discover_time, discover_rate);
+                        }
+                        else if(load_kernel) {
+                            loadgen_config load_cfg;
+                            memset(&load_cfg, 0, sizeof(load_cfg));
+                            load_cfg.duty = load_duty;
+                            load_cfg.phase_s = load_time < 1 ? 1 : load_time;
+                            load_cfg.smt = load_smt;
+                            if (loadgen_parse_kernel(load_kernel, &load_cfg.kernel) != 0) {
+                                fprintf(stderr, "Unknown load kernel \"%s\", use scalar, fma, l3, dram or verify.\n", load_kernel);
+                                err = -1;
+                            }
+                            if (!err) {
+                                err = init_pmt(&pmt, forcetable);
+                                init_sysinfo(&pmt, &sysinfo, init_debug);
+                            }
+                            if (!err && loadgen_parse_cores(load_cores, &pmt, &sysinfo, &load_cfg) != 0)
+                                err = -1;
+                            if (!err)
+                                err = loadgen_characterize(&pmt, &sysinfo, &load_cfg);
+                        }
+                        else if(co_sweep) {
+                            cosweep_config sweep_cfg;
+                            cosweep_defaults(&sweep_cfg);
+                            sweep_cfg.step = sweep_step;
+                            sweep_cfg.min_count = sweep_min;
+                            sweep_cfg.load.phase_s = sweep_time < 1 ? 1 : sweep_time;
+                            sweep_cfg.out_path = sweep_out;
+                            err = init_pmt(&pmt, forcetable);
+                            init_sysinfo(&pmt, &sysinfo, init_debug);
+                            if (!err && loadgen_parse_cores(sweep_cores, &pmt, &sysinfo, &sweep_cfg.load) != 0)
+                                err = -1;
+                            if (!err)
+                                err = cosweep_run(&pmt, &sysinfo, &sweep_cfg);
                         }
                         else {
                             if (force_update_time_s) {
@@ -1581,9 +1962,21 @@ int main(int argc, const char** argv) {
                             }
                             if (!err) {
                                 err = init_pmt(&pmt, forcetable);
+                                startup_mark("init_pmt");
                                 init_sysinfo(&pmt, &sysinfo, init_debug);
                             }
-                            if (!err && pm_export_pipe) {
+                            if (!err && (energy_cgroups || energy_pids)) {
+                                if (energy_init(&sysinfo, energy_cgroups, energy_pids) != 0)
+                                    err = -4;
+                            }
+                            startup_done();
+                            if (!err && low_perturbation)
+                                lowpert_setup(housekeeping_cpu, (pm_export_pipe ? export_update_time_s : update_time_s) * 1000000000ULL);
+                            if (!err && gov.target != GOV_TARGET_NONE) {
+                                gov.interval_ms = update_time_s * 1000;
+                                err = governor_run(&pmt, &sysinfo, &gov);
+                            }
+                            else if (!err && pm_export_pipe) {
 
                                 err = start_pm_export();
                             }
@@ -1597,6 +1990,9 @@ int main(int argc, const char** argv) {
         }
     }
 
+    energy_free();
+    alert_free();
+    if (show_smu_stats) print_smu_stats(stderr);
     smu_free(&obj); 
 
     return err;
@@ -0,0 +1,459 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * libryzenmonitor, the sampling, decode and control entry points of
+ * ryzen_monitor for use from other programs.
+ *
+ * Everything goes through an opaque context holding its own SMU object, PM
+ * table, system info and derived values, a process can open as many as it
+ * needs. A context must not be used from two threads at the same time,
+ * separate contexts can. SMU commands reach the context's SMU object through
+ * the per-thread binding of setinfo.c. Nothing here prints or exits, errors
+ * come back as enum rm_status. The scalar and CO count reads go through the
+ * process wide SMU read cache, shared by every context.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "readinfo.h"
+#include "setinfo.h"
+#include "derived.h"
+#include "pmt_fields.h"
+#include "dramtimings.h"
+#include "ryzenmonitor.h"
+
+#define pmta(elem) ((pmt->elem)?(*pmt->elem):NAN)
+
+#define RM_TABLE_BYTES  10240   //Every PM table field stays inside the buffer, even for a short table
+
+_Static_assert(RM_MAX_CORES == PMT_MAX_NUM_CORES, "rm_sample must hold every PM table core");
+_Static_assert(RM_MAX_DRAM_CHANNELS == DRAM_MAX_CHANNELS && RM_MAX_DRAM_FIELDS == DRAM_MAX_FIELDS,
+    "rm_dram must match dram_timings");
+
+extern const int TEST_INT;
+
+struct rm_context {
+    derived_values derived;     //Aligned for the core stats kernels, keep first
+    smu_obj_t smu;
+    pm_table pmt;
+    system_info sysinfo;
+    unsigned char *pm_buf;
+    unsigned int pm_table_size;
+    int offline;
+    int supported;              //The PM table version has a decoder
+    int decoded;                //pm_buf holds a table
+    char cpu_name[64];
+    char smu_fw[32];
+};
+
+static const char *status_names[] = {
+    "Success",
+    "ryzen_smu driver not loaded or not accessible",
+    "PM tables are not supported for this processor",
+    "PM table version is not supported",
+    "Processor topology could not be read",
+    "Out of memory",
+    "PM table read failed",
+    "PM table is shorter than its version needs",
+    "Not available on this processor",
+    "SMU command failed",
+    "Invalid argument",
+};
+
+int rm_version() {
+    return RM_API_VERSION;
+}
+
+const char* rm_strerror(int status) {
+    if (status > 0 || -status >= (int)(sizeof(status_names) / sizeof(status_names[0])))
+        return "Unknown error";
+    return status_names[-status];
+}
+
+static rm_context* context_alloc(unsigned int table_size) {
+    rm_context *ctx;
+
+    if (posix_memalign((void **)&ctx, 64, sizeof(rm_context)) != 0)
+        return NULL;
+    memset(ctx, 0, sizeof(rm_context));
+    ctx->pm_buf = calloc(table_size > RM_TABLE_BYTES ? table_size : RM_TABLE_BYTES, sizeof(unsigned char));
+    if (!ctx->pm_buf) {
+        free(ctx);
+        return NULL;
+    }
+    ctx->pm_table_size = table_size;
+    return ctx;
+}
+
+static void format_fw_version(unsigned int version, char *buf, size_t len) {
+    if (version & 0xff000000)
+        snprintf(buf, len, "%u.%u.%u.%u", (version >> 24) & 0xff, (version >> 16) & 0xff,
+            (version >> 8) & 0xff, version & 0xff);
+    else
+        snprintf(buf, len, "%u.%u.%u", (version >> 16) & 0xff, (version >> 8) & 0xff, version & 0xff);
+}
+
+int rm_open(rm_context **out) {
+    rm_context *ctx;
+    smu_obj_t smu;
+    int err;
+
+    *out = NULL;
+    if (smu_init(&smu) != SMU_Return_OK)
+        return RM_ERR_SMU;
+
+    ctx = context_alloc(smu.pm_table_size);
+    if (!ctx) {
+        smu_free(&smu);
+        return RM_ERR_MEMORY;
+    }
+    ctx->smu = smu;
+
+    if (smu_pm_tables_supported(&ctx->smu))
+        ctx->supported = select_pm_table_version(ctx->smu.pm_table_version, &ctx->pmt, ctx->pm_buf);
+
+    read_processor_name(ctx->cpu_name, sizeof(ctx->cpu_name));
+    format_fw_version(ctx->smu.smu_version, ctx->smu_fw, sizeof(ctx->smu_fw));
+    ctx->sysinfo.cpu_name = ctx->cpu_name;
+    ctx->sysinfo.codename = smu_codename_to_str(&ctx->smu);
+    ctx->sysinfo.smu_codename = ctx->smu.codename;
+    ctx->sysinfo.smu_fw_ver = ctx->smu_fw;
+    ctx->sysinfo.enabled_cores_count = 1;
+
+    //Same PMT hack for the disabled cores as the monitor
+    if (ctx->supported && smu_read_pm_table(&ctx->smu, ctx->pm_buf, ctx->pm_table_size) == SMU_Return_OK) {
+        disabled_cores_from_pmt(&ctx->pmt, &ctx->sysinfo);
+        ctx->decoded = 1;
+    }
+
+    err = read_processor_topology(&ctx->smu, &ctx->sysinfo, NULL);
+    if (err) {
+        rm_close(ctx);
+        return err == TOPOLOGY_ERR_MEMORY ? RM_ERR_MEMORY : RM_ERR_TOPOLOGY;
+    }
+
+    *out = ctx;
+    return RM_OK;
+}
+
+int rm_open_offline(unsigned int pm_table_version, rm_context **out) {
+    rm_context *ctx;
+
+    *out = NULL;
+    ctx = context_alloc(0);
+    if (!ctx)
+        return RM_ERR_MEMORY;
+    if (!select_pm_table_version(pm_table_version, &ctx->pmt, ctx->pm_buf)) {
+        rm_close(ctx);
+        return RM_ERR_UNSUPPORTED;
+    }
+    ctx->offline = 1;
+    ctx->supported = 1;
+    ctx->pm_table_size = ctx->pmt.min_size;
+    snprintf(ctx->cpu_name, sizeof(ctx->cpu_name), "Offline PM table 0x%06x", pm_table_version);
+    ctx->sysinfo.cpu_name = ctx->cpu_name;
+    ctx->sysinfo.codename = "Undefined";
+    ctx->sysinfo.smu_fw_ver = ctx->smu_fw;
+    sysinfo_from_pmt(&ctx->pmt, &ctx->sysinfo);
+
+    *out = ctx;
+    return RM_OK;
+}
+
+void rm_close(rm_context *ctx) {
+    if (!ctx)
+        return;
+    if (!ctx->offline)
+        smu_free(&ctx->smu);
+    free(ctx->sysinfo.coremap);
+    free(ctx->sysinfo.cpumap);
+    free(ctx->pm_buf);
+    free(ctx);
+}
+
+int rm_system_info(rm_context *ctx, rm_system *info) {
+    system_info *sysinfo = &ctx->sysinfo;
+
+    memset(info, 0, sizeof(rm_system));
+    snprintf(info->cpu_name, sizeof(info->cpu_name), "%s", ctx->cpu_name);
+    snprintf(info->codename, sizeof(info->codename), "%s", sysinfo->codename);
+    snprintf(info->smu_fw, sizeof(info->smu_fw), "%s", ctx->smu_fw);
+    info->family = sysinfo->family;
+    info->model = sysinfo->model;
+    info->pm_table_version = ctx->offline ? ctx->pmt.version : ctx->smu.pm_table_version;
+    info->pm_table_size = ctx->pm_table_size;
+    info->pm_table_supported = ctx->supported;
+    info->zen_version = ctx->supported ? ctx->pmt.zen_version : 0;
+    info->cores = sysinfo->cores;
+    info->ccds = sysinfo->ccds;
+    info->ccxs = sysinfo->ccxs;
+    info->cores_per_ccx = sysinfo->cores_per_ccx;
+    info->core_disable_map = sysinfo->core_disable_map;
+    info->enabled_cores = sysinfo->enabled_cores_count;
+    return RM_OK;
+}
+
+static void fill_sample(rm_context *ctx, rm_sample *out) {
+    pm_table *pmt = &ctx->pmt;
+    const derived_values *d = &ctx->derived;
+    rm_core *c;
+    int i;
+
+    derived_compute(pmt, &ctx->sysinfo, &ctx->derived);
+
+    out->cores = pmt->max_cores;
+    for (i = 0; i < RM_MAX_CORES; i++) {
+        c = &out->core[i];
+        if (i >= pmt->max_cores) {
+            memset(c, 0, sizeof(rm_core));
+            continue;
+        }
+        c->enabled = !((ctx->sysinfo.core_disable_map >> i) & 1);
+        c->frequency = pmta(CORE_FREQEFF[i]) * 1000.f;
+        c->power = pmta(CORE_POWER[i]);
+        c->voltage = d->cores.voltage[i];
+        c->temperature = pmta(CORE_TEMP[i]);
+        c->c0 = pmta(CORE_C0[i]);
+        c->cc1 = pmta(CORE_CC1[i]);
+        c->cc6 = pmta(CORE_CC6[i]);
+    }
+
+    out->peak_frequency = d->cores.peak_frequency;
+    out->peak_temperature = d->cores.peak_temp;
+    out->peak_voltage = d->v[DERIVED_PEAK_VOLTAGE_SMU];
+    out->avg_voltage = d->v[DERIVED_CORES_AVG_VOLTAGE];
+    out->socket_power = pmta(SOCKET_POWER);
+    out->package_power = pmta(PACKAGE_POWER);
+    out->thermal_output = d->v[DERIVED_THERMAL_OUTPUT];
+    out->ppt = pmta(PPT_VALUE);
+    out->ppt_limit = pmta(PPT_LIMIT);
+    out->tdc = pmta(TDC_VALUE);
+    out->tdc_limit = pmta(TDC_LIMIT);
+    out->edc = d->v[DERIVED_EDC];
+    out->edc_limit = pmta(EDC_LIMIT);
+    out->thm = d->v[DERIVED_THM];
+    out->thm_limit = pmta(THM_LIMIT);
+    out->soc_temperature = pmta(SOC_TEMP);
+    out->fclk = pmta(FCLK_FREQ_EFF);
+    out->uclk = pmta(UCLK_FREQ);
+    out->memclk = pmta(MEMCLK_FREQ);
+}
+
+static int read_table(rm_context *ctx) {
+    if (ctx->offline)
+        return RM_ERR_INVALID;
+    if (!ctx->supported)
+        return smu_pm_tables_supported(&ctx->smu) ? RM_ERR_UNSUPPORTED : RM_ERR_NO_PM_TABLE;
+    if (smu_read_pm_table(&ctx->smu, ctx->pm_buf, ctx->pm_table_size) != SMU_Return_OK)
+        return RM_ERR_READ;
+    ctx->decoded = 1;
+    return RM_OK;
+}
+
+int rm_sample_read(rm_context *ctx, rm_sample *out) {
+    unsigned long long t;
+    int err;
+
+    t = get_time_ns();
+    if ((err = read_table(ctx)) != RM_OK)
+        return err;
+    fill_sample(ctx, out);
+    out->time_ns = t;
+    return RM_OK;
+}
+
+int rm_decode(rm_context *ctx, const void *table, size_t size, rm_sample *out) {
+    if (!ctx->supported)
+        return RM_ERR_UNSUPPORTED;
+    if (size < ctx->pmt.min_size)
+        return RM_ERR_SHORT_TABLE;
+    if (size > ctx->pm_table_size && size > RM_TABLE_BYTES)
+        size = ctx->pm_table_size > RM_TABLE_BYTES ? ctx->pm_table_size : RM_TABLE_BYTES;
+    memcpy(ctx->pm_buf, table, size);
+
+    //The first table is all an offline context knows about the disabled cores
+    if (ctx->offline && !ctx->decoded) {
+        ctx->sysinfo.core_disable_map_pmt = 0;
+        sysinfo_from_pmt(&ctx->pmt, &ctx->sysinfo);
+    }
+    ctx->decoded = 1;
+
+    fill_sample(ctx, out);
+    out->time_ns = 0;
+    return RM_OK;
+}
+
+int rm_field(rm_context *ctx, const char *name, int index, float *value) {
+    const pmt_field *field;
+
+    if (!ctx->supported)
+        return RM_ERR_UNSUPPORTED;
+    field = pmt_field_find(name, strlen(name));
+    if (!field || index < 0 || index >= field->count)
+        return RM_ERR_INVALID;
+    if (!pmt_field_ptr(&ctx->pmt, field, index))
+        return RM_ERR_NOT_AVAILABLE;
+    *value = pmt_field_value(&ctx->pmt, field, index);
+    return RM_OK;
+}
+
+//op_set_* and op_get_cocount return -100 when not available and -200 when the SMU refused
+static int op_status(int ret) {
+    if (ret == -100)
+        return RM_ERR_NOT_AVAILABLE;
+    if (ret <= -100)
+        return RM_ERR_COMMAND;
+    return RM_OK;
+}
+
+int rm_get_limit(rm_context *ctx, enum rm_limit limit, int *value) {
+    pm_table *pmt = &ctx->pmt;
+    smu_obj_t *prev;
+    float *field = NULL;
+    int err, ret;
+
+    if (limit == RM_LIMIT_SCALAR) {
+        if (ctx->offline)
+            return RM_ERR_INVALID;
+        prev = smu_target_bind(&ctx->smu);
+        ret = op_get_scalar(&ctx->sysinfo);
+        smu_target_bind(prev);
+        if ((err = op_status(ret)) != RM_OK)
+            return err;
+        *value = ret;
+        return RM_OK;
+    }
+
+    if (!ctx->offline && (err = read_table(ctx)) != RM_OK)
+        return err;
+    if (!ctx->decoded)
+        return RM_ERR_INVALID;
+
+    switch (limit) {
+        case RM_LIMIT_PPT:          field = pmt->PPT_LIMIT; break;
+        case RM_LIMIT_PPT_FAST:     field = pmt->PPT_LIMIT_FAST; break;
+        case RM_LIMIT_PPT_APU:      field = pmt->PPT_LIMIT_APU; break;
+        case RM_LIMIT_TDC:          field = pmt->TDC_LIMIT; break;
+        case RM_LIMIT_TDC_SOC:      field = pmt->TDC_LIMIT_SOC; break;
+        case RM_LIMIT_EDC:          field = pmt->EDC_LIMIT; break;
+        case RM_LIMIT_EDC_SOC:      field = pmt->EDC_LIMIT_SOC; break;
+        case RM_LIMIT_STAPM:        field = pmt->STAPM_LIMIT; break;
+        case RM_LIMIT_PPT_TIME:     field = pmt->SlowPPTTimeConstant; break;
+        case RM_LIMIT_STAPM_TIME:   field = pmt->StapmTimeConstant; break;
+        case RM_LIMIT_THM:          field = pmt->THM_LIMIT; break;
+        default:                    return RM_ERR_INVALID;
+    }
+    if (!field)
+        return RM_ERR_NOT_AVAILABLE;
+    *value = (int)*field;
+    return RM_OK;
+}
+
+int rm_set_limit(rm_context *ctx, enum rm_limit limit, int value) {
+    system_info *sysinfo = &ctx->sysinfo;
+    smu_obj_t *prev;
+    int ret;
+
+    if (ctx->offline || limit < 0 || limit >= RM_LIMIT_COUNT || value == TEST_INT)
+        return RM_ERR_INVALID;
+
+    prev = smu_target_bind(&ctx->smu);
+    switch (limit) {
+        case RM_LIMIT_PPT:          ret = op_set_ppt(sysinfo, value); break;
+        case RM_LIMIT_PPT_FAST:     ret = op_set_pptfast(sysinfo, value); break;
+        case RM_LIMIT_PPT_APU:      ret = op_set_pptapu(sysinfo, value); break;
+        case RM_LIMIT_TDC:          ret = op_set_tdc(sysinfo, value); break;
+        case RM_LIMIT_TDC_SOC:      ret = op_set_tdcsoc(sysinfo, value); break;
+        case RM_LIMIT_EDC:          ret = op_set_edc(sysinfo, value); break;
+        case RM_LIMIT_EDC_SOC:      ret = op_set_edcsoc(sysinfo, value); break;
+        case RM_LIMIT_STAPM:        ret = op_set_stapm(sysinfo, value); break;
+        case RM_LIMIT_PPT_TIME:     ret = op_set_ppt_time(sysinfo, value); break;
+        case RM_LIMIT_STAPM_TIME:   ret = op_set_stapm_time(sysinfo, value); break;
+        case RM_LIMIT_THM:          ret = op_set_thm(sysinfo, value); break;
+        case RM_LIMIT_SCALAR:       ret = op_set_scalar(sysinfo, value); break;
+        default:                    ret = 0; break;
+    }
+    smu_target_bind(prev);
+
+    return op_status(ret);
+}
+
+int rm_get_cocount(rm_context *ctx, int core, int *count) {
+    smu_obj_t *prev;
+    int ret;
+
+    if (ctx->offline || !ctx->sysinfo.coremap || core < 0 || core >= (int)ctx->sysinfo.cores || core == TEST_INT)
+        return RM_ERR_INVALID;
+
+    prev = smu_target_bind(&ctx->smu);
+    ret = op_get_cocount(&ctx->sysinfo, core, 1);
+    smu_target_bind(prev);
+
+    if (ret == -100 || ret == -200)
+        return op_status(ret);
+    *count = ret;
+    return RM_OK;
+}
+
+int rm_set_cocount(rm_context *ctx, int core, int count) {
+    smu_obj_t *prev;
+    int ret;
+
+    if (ctx->offline || !ctx->sysinfo.coremap || core < 0 || core >= (int)ctx->sysinfo.cores || count == TEST_INT)
+        return RM_ERR_INVALID;
+
+    prev = smu_target_bind(&ctx->smu);
+    ret = op_set_cocount(&ctx->sysinfo, core, count);
+    smu_target_bind(prev);
+
+    return op_status(ret);
+}
+
+int rm_dram_read(rm_context *ctx, rm_dram *out) {
+    dram_timings t;
+    smu_obj_t *prev;
+    int i, err;
+
+    if (ctx->offline)
+        return RM_ERR_INVALID;
+
+    prev = smu_target_bind(&ctx->smu);
+    err = dram_timings_read(&t);
+    smu_target_bind(prev);
+    if (err)
+        return RM_ERR_READ;
+
+    memset(out, 0, sizeof(rm_dram));
+    out->channels = t.channel_count;
+    for (i = 0; i < t.channel_count; i++) {
+        out->umc[i] = t.channels[i].umc;
+        memcpy(out->values[i], t.channels[i].values, sizeof(out->values[i]));
+    }
+    return RM_OK;
+}
+
+const char* rm_dram_field_name(int i) {
+    return dram_timings_field_key(i);
+}
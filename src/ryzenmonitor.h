@@ -0,0 +1,154 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef RYZENMONITOR_H
+#define RYZENMONITOR_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RM_API_VERSION  1
+
+//The shared library is built with hidden visibility, only these entry points are exported
+#if defined(__GNUC__)
+#define RM_API __attribute__((visibility("default")))
+#else
+#define RM_API
+#endif
+#define RM_MAX_CORES    16
+#define RM_MAX_DRAM_CHANNELS    8
+#define RM_MAX_DRAM_FIELDS      48
+
+typedef struct rm_context rm_context;
+
+enum rm_status {
+    RM_OK                   =  0,
+    RM_ERR_SMU              = -1,   //ryzen_smu driver not loaded or not accessible
+    RM_ERR_NO_PM_TABLE      = -2,   //The processor has no PM table
+    RM_ERR_UNSUPPORTED      = -3,   //PM table version without a decoder
+    RM_ERR_TOPOLOGY         = -4,   //Fuses could not be read
+    RM_ERR_MEMORY           = -5,
+    RM_ERR_READ             = -6,   //PM table read failed
+    RM_ERR_SHORT_TABLE      = -7,   //Buffer smaller than the PM table version needs
+    RM_ERR_NOT_AVAILABLE    = -8,   //Not available on this processor
+    RM_ERR_COMMAND          = -9,   //The SMU did not take the command
+    RM_ERR_INVALID          = -10,  //Bad argument, or an offline context for a live call
+};
+
+enum rm_limit {
+    RM_LIMIT_PPT,           //W
+    RM_LIMIT_PPT_FAST,      //W
+    RM_LIMIT_PPT_APU,       //W
+    RM_LIMIT_TDC,           //A
+    RM_LIMIT_TDC_SOC,       //A
+    RM_LIMIT_EDC,           //A
+    RM_LIMIT_EDC_SOC,       //A
+    RM_LIMIT_STAPM,         //W
+    RM_LIMIT_PPT_TIME,      //s
+    RM_LIMIT_STAPM_TIME,    //s
+    RM_LIMIT_THM,           //C
+    RM_LIMIT_SCALAR,        //PBO scalar x1
+    RM_LIMIT_COUNT
+};
+
+typedef struct {
+    char cpu_name[64];
+    char codename[32];
+    char smu_fw[32];            //Empty for an offline context
+    unsigned int family, model;
+    unsigned int pm_table_version;
+    unsigned int pm_table_size;
+    int pm_table_supported;
+    int zen_version;
+    int cores;                  //Core slots of the PM table
+    int ccds, ccxs, cores_per_ccx;
+    unsigned int core_disable_map;
+    int enabled_cores;
+} rm_system;
+
+typedef struct {
+    int enabled;
+    float frequency;            //Effective, MHz
+    float power;                //W
+    float voltage;              //V, CC6 weighted
+    float temperature;          //C
+    float c0, cc1, cc6;         //Residency %
+} rm_core;
+
+typedef struct {
+    unsigned long long time_ns; //CLOCK_MONOTONIC when the table was read, 0 for rm_decode()
+    int cores;
+    rm_core core[RM_MAX_CORES];
+    float peak_frequency;       //MHz
+    float peak_temperature;
+    float peak_voltage;
+    float avg_voltage;          //Mean of the CC6 weighted core voltages
+    float socket_power;
+    float package_power;
+    float thermal_output;       //Sum of every power rail the package draws
+    float ppt, ppt_limit;
+    float tdc, tdc_limit;
+    float edc, edc_limit;
+    float thm, thm_limit;
+    float soc_temperature;
+    float fclk, uclk, memclk;   //MHz
+} rm_sample;
+
+typedef struct {
+    int channels;
+    int umc[RM_MAX_DRAM_CHANNELS];  //UMC instance of every channel
+    double values[RM_MAX_DRAM_CHANNELS][RM_MAX_DRAM_FIELDS];   //In rm_dram_field_name() order
+} rm_dram;
+
+RM_API int rm_version();
+RM_API const char* rm_strerror(int status);
+
+//Live context on the ryzen_smu driver, needs root
+RM_API int rm_open(rm_context **ctx);
+//Decode only context for tables read elsewhere, dumpfiles or recordings
+RM_API int rm_open_offline(unsigned int pm_table_version, rm_context **ctx);
+RM_API void rm_close(rm_context *ctx);
+
+RM_API int rm_system_info(rm_context *ctx, rm_system *info);
+
+//Reads and decodes the PM table
+RM_API int rm_sample_read(rm_context *ctx, rm_sample *out);
+//Decodes a raw PM table of the context's version, size is in bytes
+RM_API int rm_decode(rm_context *ctx, const void *table, size_t size, rm_sample *out);
+//Any pm_tables.h field of the last sampled or decoded table, index for per core arrays
+RM_API int rm_field(rm_context *ctx, const char *name, int index, float *value);
+
+RM_API int rm_get_limit(rm_context *ctx, enum rm_limit limit, int *value);
+RM_API int rm_set_limit(rm_context *ctx, enum rm_limit limit, int value);
+//Curve Optimizer count of a core, index into the enabled cores
+RM_API int rm_get_cocount(rm_context *ctx, int core, int *count);
+RM_API int rm_set_cocount(rm_context *ctx, int core, int count);
+
+RM_API int rm_dram_read(rm_context *ctx, rm_dram *out);
+//Key of a DRAM timing as in the --timings-format json output, NULL past the last one
+RM_API const char* rm_dram_field_name(int i);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,368 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Time aligned sampling of the PM table and the kernel's own sensors.
+ *
+ * Every source keeps its sysfs files open and reads them with pread() in
+ * the same tick as the PM table, with its own start and end timestamps.
+ * One record per tick carries all sources, so k10temp, cpufreq and RAPL can
+ * be lined up against the SMU values. Sources are entries in a table of
+ * modules, each only has to find its files; the root of the sysfs paths can
+ * be moved to a mock tree for testing.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <limits.h>
+#include <libsmu.h>
+#include "commonfuncs.h"
+#include "lowpert.h"
+#include "msr.h"
+#include "sampler.h"
+
+extern smu_obj_t obj;
+
+static unsigned char *pm_buf = NULL;
+
+static int add_channel(sample_source *src, const char *name, int fd, float *field, double scale) {
+    sampler_channel *c;
+    char *p;
+
+    if (src->count == src->alloc) {
+        c = realloc(src->ch, (src->alloc ? src->alloc * 2 : 16) * sizeof(sampler_channel));
+        if (!c)
+            return -1;
+        src->ch = c;
+        src->alloc = src->alloc ? src->alloc * 2 : 16;
+    }
+    c = &src->ch[src->count++];
+    memset(c, 0, sizeof(sampler_channel));
+    snprintf(c->name, sizeof(c->name), "%s", name);
+    //Field keys stay plain: lower case, anything else becomes '_'
+    for (p = c->name; *p; p++)
+        *p = isalnum((unsigned char)*p) ? tolower((unsigned char)*p) : '_';
+    c->fd = fd;
+    c->field = field;
+    c->scale = scale;
+    c->value = NAN;
+    return 0;
+}
+
+static int read_text(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    ssize_t n;
+
+    if (fd < 0)
+        return -1;
+    n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0)
+        return -1;
+    buf[n] = 0;
+    buf[strcspn(buf, "\n")] = 0;
+    return 0;
+}
+
+static int add_file(sample_source *src, const char *name, const char *path, double scale) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+    if (add_channel(src, name, fd, NULL, scale) != 0) {
+        close(fd);
+        return -1;
+    }
+    return 0;
+}
+
+//PM table, the reference the other sources are compared against
+static int pmt_source_open(sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo) {
+    char name[32];
+    int i;
+
+    if (!pmt || !obj.pm_table_size)
+        return 0;
+    pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
+    if (!pm_buf)
+        return 0;
+    select_pm_table_version(obj.pm_table_version, pmt, pm_buf);
+
+    if (pmt->THM_VALUE) add_channel(src, "thm", -1, pmt->THM_VALUE, 1);
+    if (pmt->SOCKET_POWER) add_channel(src, "socket_w", -1, pmt->SOCKET_POWER, 1);
+    if (pmt->PPT_VALUE) add_channel(src, "ppt_w", -1, pmt->PPT_VALUE, 1);
+    for (i = 0; i < pmt->max_cores; i++) {
+        if (((sysinfo->core_disable_map >> i) & 1) || !pmt->CORE_FREQEFF[i])
+            continue;
+        snprintf(name, sizeof(name), "core%d_mhz", i);
+        add_channel(src, name, -1, pmt->CORE_FREQEFF[i], 1000);
+    }
+    return src->count;
+}
+
+static int pmt_source_refresh(sample_source *src) {
+    return smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK ? 0 : -1;
+}
+
+//k10temp: Tctl, Tdie and Tccd in millidegrees
+static int hwmon_open(sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo) {
+    char path[SAMPLER_PATH_MAX], text[64], label[64];
+    int i, t;
+
+    for (i = 0; i < SAMPLER_MAX_HWMON; i++) {
+        snprintf(path, sizeof(path), "%s/sys/class/hwmon/hwmon%d/name", root, i);
+        if (read_text(path, text, sizeof(text)) != 0 || strcmp(text, "k10temp"))
+            continue;
+        for (t = 1; t < 16; t++) {
+            snprintf(path, sizeof(path), "%s/sys/class/hwmon/hwmon%d/temp%d_label", root, i, t);
+            if (read_text(path, label, sizeof(label)) != 0)
+                snprintf(label, sizeof(label), "temp%d", t);
+            snprintf(path, sizeof(path), "%s/sys/class/hwmon/hwmon%d/temp%d_input", root, i, t);
+            add_file(src, label, path, 0.001);
+        }
+    }
+    return src->count;
+}
+
+//scaling_cur_freq of every logical CPU, in kHz
+static int cpufreq_open(sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo) {
+    char path[SAMPLER_PATH_MAX], name[32];
+    int cpu;
+
+    for (cpu = 0; cpu < SAMPLER_MAX_CPUS; cpu++) {
+        snprintf(path, sizeof(path), "%s/sys/devices/system/cpu/cpu%d/cpufreq/scaling_cur_freq", root, cpu);
+        snprintf(name, sizeof(name), "cpu%d_mhz", cpu);
+        add_file(src, name, path, 0.001);
+    }
+    return src->count;
+}
+
+//powercap zones, energy_uj is a wrapping counter turned into W
+static int rapl_open(sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo) {
+    //Room for the directory, any entry name and the longest file name below it
+    char dir[SAMPLER_PATH_MAX], path[SAMPLER_PATH_MAX + NAME_MAX + 32], text[64], name[48];
+    struct dirent **list;
+    int i, n;
+
+    snprintf(dir, sizeof(dir), "%s/sys/class/powercap", root);
+    n = scandir(dir, &list, NULL, alphasort);
+    for (i = 0; i < n; i++) {
+        if (!strncmp(list[i]->d_name, "intel-rapl:", 11)) {
+            snprintf(path, sizeof(path), "%s/%s/name", dir, list[i]->d_name);
+            if (read_text(path, text, sizeof(text)) != 0)
+                snprintf(text, sizeof(text), "%s", list[i]->d_name + 11);
+            snprintf(name, sizeof(name), "%.*s_w", (int)sizeof(name) - 3, text);
+            snprintf(path, sizeof(path), "%s/%s/energy_uj", dir, list[i]->d_name);
+            if (add_file(src, name, path, 1e-6) == 0) {
+                src->ch[src->count - 1].counter = 1;
+                snprintf(path, sizeof(path), "%s/%s/max_energy_range_uj", dir, list[i]->d_name);
+                if (read_text(path, text, sizeof(text)) == 0)
+                    src->ch[src->count - 1].wrap = strtod(text, NULL);
+            }
+        }
+        free(list[i]);
+    }
+    if (n >= 0)
+        free(list);
+    return src->count;
+}
+
+//APERF/MPERF per logical CPU, named after the PM table core it belongs to
+static int msr_source_open(sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo) {
+    msr_thread *t;
+    char base[32], name[48];
+    int i, n;
+
+    n = msr_open(root, sysinfo);
+    for (i = 0; i < n; i++) {
+        t = msr_get(i);
+        if (t->core >= 0)
+            snprintf(base, sizeof(base), "core%d_t%d", t->core, t->thread);
+        else
+            snprintf(base, sizeof(base), "cpu%d", t->cpu);
+        snprintf(name, sizeof(name), "%s_mhz", base);
+        add_channel(src, name, -1, &t->mhz, 1);
+        snprintf(name, sizeof(name), "%s_eff_mhz", base);
+        add_channel(src, name, -1, &t->eff_mhz, 1);
+        snprintf(name, sizeof(name), "%s_c0", base);
+        add_channel(src, name, -1, &t->c0, 1);
+    }
+    return src->count;
+}
+
+static int msr_source_refresh(sample_source *src) {
+    return msr_sample();
+}
+
+//New sources go here, the name is what --sample selects them by
+static sample_source sources[] = {
+    { "pmt",     1, pmt_source_open, pmt_source_refresh },
+    { "hwmon",   0, hwmon_open,   NULL },
+    { "cpufreq", 0, cpufreq_open, NULL },
+    { "rapl",    0, rapl_open,    NULL },
+    { "msr",     0, msr_source_open, msr_source_refresh },
+};
+#define SOURCE_COUNT ((int)(sizeof(sources) / sizeof(sources[0])))
+
+static int selected(const char *list, const char *name) {
+    size_t len = strlen(name);
+    const char *p = list;
+
+    if (!list || !strcmp(list, "all"))
+        return 1;
+    while ((p = strstr(p, name))) {
+        if ((p == list || p[-1] == ',') && (p[len] == ',' || !p[len]))
+            return 1;
+        p += len;
+    }
+    return 0;
+}
+
+int sampler_needs_smu(const char *list) {
+    int i;
+
+    for (i = 0; i < SOURCE_COUNT; i++) {
+        if (sources[i].needs_smu && selected(list, sources[i].name))
+            return 1;
+    }
+    return 0;
+}
+
+static void source_read(sample_source *src) {
+    sampler_channel *c;
+    char buf[64];
+    double raw, delta;
+    ssize_t n;
+    int i;
+
+    src->start_ns = get_time_ns();
+    src->ok = !src->refresh || src->refresh(src) == 0;
+    for (i = 0; src->ok && i < src->count; i++) {
+        c = &src->ch[i];
+        if (c->field) {
+            raw = *c->field;
+        } else {
+            n = pread(c->fd, buf, sizeof(buf) - 1, 0);
+            if (n <= 0) {
+                c->value = NAN;
+                continue;
+            }
+            buf[n] = 0;
+            raw = strtod(buf, NULL);
+        }
+        if (!c->counter) {
+            c->value = raw * c->scale;
+            continue;
+        }
+        //Rate over the time between this source's reads
+        if (c->last_ns) {
+            delta = raw - c->last_raw;
+            if (delta < 0 && c->wrap > 0)
+                delta += c->wrap;
+            c->value = delta >= 0 ? delta * c->scale * 1e9 / (get_time_ns() - c->last_ns) : NAN;
+        }
+        c->last_raw = raw;
+        c->last_ns = get_time_ns();
+    }
+    src->end_ns = get_time_ns();
+}
+
+//One line per tick, every source with its offset from the tick start and its read time
+static void print_record(const char *hostname, unsigned long tick, unsigned long long tick_ns, sample_source **active, int count) {
+    sample_source *src;
+    int i, k;
+
+    fprintf(stdout, "ryzen_monitor_ng_sample,host=%s tick=%lui,t_ns=%llui", hostname, tick, tick_ns);
+    for (i = 0; i < count; i++) {
+        src = active[i];
+        if (!src->ok)
+            continue;
+        fprintf(stdout, ",%s_at_us=%.1f,%s_read_us=%.1f", src->name, (src->start_ns - tick_ns) / 1e3,
+            src->name, (src->end_ns - src->start_ns) / 1e3);
+        for (k = 0; k < src->count; k++) {
+            if (!isnan(src->ch[k].value))
+                fprintf(stdout, ",%s_%s=%.3f", src->name, src->ch[k].name, src->ch[k].value);
+        }
+    }
+    fprintf(stdout, "\n");
+    fflush(stdout);
+}
+
+//count 0 runs until interrupted
+int sampler_run(const char *list, const char *root, int interval_ms, int count, pm_table *pmt, system_info *sysinfo) {
+    sample_source *active[SAMPLER_MAX_SOURCES];
+    char hostname[HOST_NAME_MAX + 1];
+    unsigned long long next, now;
+    unsigned long tick;
+    int i, k, n = 0;
+
+    if (!root) root = "";
+    if (interval_ms < 1) interval_ms = 1;
+    gethostname(hostname, sizeof(hostname));
+
+    for (i = 0; i < SOURCE_COUNT && n < SAMPLER_MAX_SOURCES; i++) {
+        if (!selected(list, sources[i].name))
+            continue;
+        if (sources[i].open(&sources[i], root, pmt, sysinfo) <= 0) {
+            fprintf(stderr, "sampler: no %s channels found under \"%s/\"\n", sources[i].name, root);
+            continue;
+        }
+        fprintf(stderr, "sampler: %s, %d channels\n", sources[i].name, sources[i].count);
+        active[n++] = &sources[i];
+    }
+    if (!n) {
+        fprintf(stderr, "sampler: nothing to sample\n");
+        return -1;
+    }
+
+    next = get_time_ns();
+    for (tick = 0; !count || tick < (unsigned long)count; tick++) {
+        now = get_time_ns();
+        for (i = 0; i < n; i++)
+            source_read(active[i]);
+        print_record(hostname, tick, now, active, n);
+
+        next += interval_ms * 1000000ULL;
+        if (next <= (now = get_time_ns()))
+            next = now;
+        else if (!count || tick + 1 < (unsigned long)count)
+            lowpert_wait_until(next, 0);
+    }
+
+    for (i = 0; i < n; i++) {
+        for (k = 0; k < active[i]->count; k++) {
+            if (active[i]->ch[k].fd >= 0)
+                close(active[i]->ch[k].fd);
+        }
+        if (active[i]->open == msr_source_open)
+            msr_close();
+        free(active[i]->ch);
+        active[i]->ch = NULL;
+        active[i]->count = active[i]->alloc = 0;
+    }
+    free(pm_buf);
+    pm_buf = NULL;
+    return 0;
+}
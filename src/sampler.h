@@ -0,0 +1,59 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "pm_tables.h"
+#include "readinfo.h"
+
+#define SAMPLER_MAX_SOURCES 8
+#define SAMPLER_MAX_CPUS    1024
+#define SAMPLER_MAX_HWMON   64
+#define SAMPLER_PATH_MAX    512
+
+typedef struct {
+    char name[48];
+    int fd;                     //sysfs file read with pread, -1 for a PM table field
+    float *field;               //PM table field, read after the table was refreshed
+    double scale;
+    double value;               //NAN until the first good read
+    int counter;                //value is the rate of a wrapping counter
+    double wrap;                //Counter range, 0 if unknown
+    double last_raw;
+    unsigned long long last_ns;
+} sampler_channel;
+
+typedef struct sample_source {
+    const char *name;
+    int needs_smu;
+    //Finds the channels under root, returns how many
+    int (*open)(struct sample_source *src, const char *root, pm_table *pmt, system_info *sysinfo);
+    //Optional, called before the channels are read
+    int (*refresh)(struct sample_source *src);
+    sampler_channel *ch;
+    int count, alloc;
+    unsigned long long start_ns, end_ns;    //Around the reads of the last tick
+    int ok;
+} sample_source;
+
+int sampler_needs_smu(const char *sources);
+int sampler_run(const char *sources, const char *root, int interval_ms, int count, pm_table *pmt, system_info *sysinfo);
+
+#endif
@@ -0,0 +1,178 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+/**
+ * Self-instrumentation of the sampling loop.
+ *
+ * Each stage of a tick is timed with CLOCK_MONOTONIC spans kept in a small
+ * ring, so percentiles and the maximum follow the last SELF_WINDOW samples. Every tick also
+ * takes a getrusage() delta for the CPU time, context switches and page
+ * faults of the monitor itself. Nothing is recorded while disabled, a span
+ * then costs one branch.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "commonfuncs.h"
+#include "selfstats.h"
+
+typedef struct {
+    unsigned long long ns[SELF_WINDOW];
+    unsigned long long count;   //Spans recorded, the ring holds the last SELF_WINDOW
+} self_ring;
+
+typedef struct {
+    double cpu_pct;             //CPU time over wall time of the last tick
+    unsigned long long utime_us, stime_us;
+    long maxrss_kb;
+    long nvcsw, nivcsw, minflt; //Deltas of the last tick
+    double wakeups_per_s;       //Voluntary switches, every sleep the monitor does ends in one
+} self_usage;
+
+static int self_enabled = 0;
+static self_ring rings[SELF_STAGES];
+static self_ring tick_ring;
+static self_usage usage;
+static struct rusage last_ru;
+static unsigned long long last_tick_ns;
+
+static const char *stage_names[] = { "read", "decode", "aggregate", "render", "write" };
+static const char *stage_labels[] = { "Read PM Table", "Decode", "Aggregate", "Render", "Write" };
+
+static unsigned long long tv_us(struct timeval *tv) {
+    return tv->tv_sec * 1000000ULL + tv->tv_usec;
+}
+
+void selfstats_enable(int enable) {
+    if (enable && !self_enabled) {
+        memset(rings, 0, sizeof(rings));
+        memset(&tick_ring, 0, sizeof(tick_ring));
+        memset(&usage, 0, sizeof(usage));
+        getrusage(RUSAGE_SELF, &last_ru);
+        last_tick_ns = get_time_ns();
+    }
+    self_enabled = enable;
+}
+
+int selfstats_enabled() {
+    return self_enabled;
+}
+
+unsigned long long self_span_begin() {
+    return self_enabled ? get_time_ns() : 0;
+}
+
+static void ring_add(self_ring *r, unsigned long long ns) {
+    r->ns[r->count++ % SELF_WINDOW] = ns;
+}
+
+void self_span_end(enum self_stage stage, unsigned long long start) {
+    if (!self_enabled || !start)
+        return;
+    ring_add(&rings[stage], get_time_ns() - start);
+}
+
+//Closes a tick, called once per sample after the output went out
+void self_tick() {
+    struct rusage ru;
+    unsigned long long now, wall_ns, cpu_us;
+
+    if (!self_enabled)
+        return;
+
+    now = get_time_ns();
+    getrusage(RUSAGE_SELF, &ru);
+    wall_ns = now - last_tick_ns;
+    cpu_us = tv_us(&ru.ru_utime) + tv_us(&ru.ru_stime) - tv_us(&last_ru.ru_utime) - tv_us(&last_ru.ru_stime);
+
+    usage.cpu_pct = wall_ns ? cpu_us * 1000.0 * 100.0 / wall_ns : 0;
+    usage.utime_us = tv_us(&ru.ru_utime);
+    usage.stime_us = tv_us(&ru.ru_stime);
+    usage.maxrss_kb = ru.ru_maxrss;
+    usage.nvcsw = ru.ru_nvcsw - last_ru.ru_nvcsw;
+    usage.nivcsw = ru.ru_nivcsw - last_ru.ru_nivcsw;
+    usage.minflt = ru.ru_minflt - last_ru.ru_minflt;
+    usage.wakeups_per_s = wall_ns ? usage.nvcsw * 1e9 / wall_ns : 0;
+    ring_add(&tick_ring, wall_ns);
+
+    last_ru = ru;
+    last_tick_ns = now;
+}
+
+static int compare_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long *)a, y = *(const unsigned long long *)b;
+    return x < y ? -1 : x > y;
+}
+
+//Fills p50, p99 and the maximum of the window, returns the number of samples in it
+static int ring_percentiles(const self_ring *r, double *p50_us, double *p99_us, double *max_us) {
+    unsigned long long sorted[SELF_WINDOW];
+    int n = r->count < SELF_WINDOW ? (int)r->count : SELF_WINDOW;
+
+    if (!n)
+        return 0;
+    memcpy(sorted, r->ns, n * sizeof(sorted[0]));
+    qsort(sorted, n, sizeof(sorted[0]), compare_ull);
+    *p50_us = sorted[n / 2] / 1e3;
+    *p99_us = sorted[(int)(n * 0.99)] / 1e3;
+    *max_us = sorted[n - 1] / 1e3;
+    return n;
+}
+
+void draw_self_export(const char *hostname) {
+    double p50, p99, max;
+    int i;
+
+    if (!self_enabled)
+        return;
+
+    for (i = 0; i < SELF_STAGES; i++) {
+        if (!ring_percentiles(&rings[i], &p50, &p99, &max))
+            continue;
+        fprintf(stdout,
+                "ryzen_monitor_ng_self,host=%s,stage=%s count=%llui,p50_us=%.1f,p99_us=%.1f,max_us=%.1f\n",
+                hostname, stage_names[i], rings[i].count, p50, p99, max);
+    }
+
+    fprintf(stdout,
+            "ryzen_monitor_ng_self,host=%s,stage=process cpu_pct=%.3f,wakeups_per_s=%.2f,utime_us=%llui,stime_us=%llui,maxrss_kb=%lii,nvcsw=%lii,nivcsw=%lii,minflt=%lii\n",
+            hostname, usage.cpu_pct, usage.wakeups_per_s, usage.utime_us, usage.stime_us, usage.maxrss_kb, usage.nvcsw, usage.nivcsw, usage.minflt);
+}
+
+void draw_self_footer() {
+    double p50, p99, max;
+    int i;
+
+    if (!self_enabled)
+        return;
+
+    fprintf(stdout, "╭── Monitor Overhead ───────────────────────────┬────────────────────────────────────────────────╮\n");
+    for (i = 0; i < SELF_STAGES; i++) {
+        if (ring_percentiles(&rings[i], &p50, &p99, &max))
+            print_line(stage_labels[i], "P50 %8.1f us | P99 %8.1f us", p50, p99);
+    }
+    print_line("Monitor CPU Usage", "%7.3f %%", usage.cpu_pct);
+    print_line("Monitor Wakeups", "%7.2f /s", usage.wakeups_per_s);
+    print_line("Context Switches", "%ld vol | %ld invol", usage.nvcsw, usage.nivcsw);
+    fprintf(stdout, "╰───────────────────────────────────────────────┴────────────────────────────────────────────────╯\n");
+}
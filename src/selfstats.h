@@ -0,0 +1,43 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+
+#ifndef SELFSTATS_H
+#define SELFSTATS_H
+
+#define SELF_WINDOW     128     //Samples kept per stage for the rolling percentiles
+
+enum self_stage {
+    SELF_STAGE_READ,        //smu_read_pm_table()
+    SELF_STAGE_DECODE,      //Raw table to fields, only replay has work here
+    SELF_STAGE_AGGREGATE,   //Energy attribution and derived values
+    SELF_STAGE_RENDER,      //Formatting into the stdout buffer
+    SELF_STAGE_WRITE,       //Flushing the buffer to the terminal or pipe
+    SELF_STAGES
+};
+
+void selfstats_enable(int enable);
+int selfstats_enabled();
+unsigned long long self_span_begin();
+void self_span_end(enum self_stage stage, unsigned long long start);
+void self_tick();
+void draw_self_export(const char *hostname);
+void draw_self_footer();
+
+#endif
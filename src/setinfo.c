@@ -24,78 +24,263 @@
 #include <libsmu.h>
 #include <math.h>
 #include <limits.h>
+#include <pthread.h>
 #include "commonfuncs.h"
 #include "pm_tables.h"
 #include "readinfo.h"
 #include "setinfo.h"
 
-extern smu_obj_t obj;
-extern int debuglog;
-
-#define SEND_CMD_RSMU(op) { if (smu_send_command(&obj, op, &args, TYPE_RSMU) != SMU_Return_OK) goto _SEND_ERROR; }
-#define SEND_CMD_MP1(op) { if (smu_send_command(&obj, op, &args, TYPE_MP1) != SMU_Return_OK) goto _SEND_ERROR; }
-#define SEND_CMD_HSMP(op) { if (smu_send_command(&obj, op, &args, TYPE_HSMP) != SMU_Return_OK) goto _SEND_ERROR; }
+int debuglog = 1;
 
 #define pmta(elem) ((pmt->elem)?(*pmt->elem):NAN)
 //Same, but with 0 as return. For summations that should not fail if one value is not present.
 #define pmta0(elem) ((pmt->elem)?(*pmt->elem):0)
 
-const int smu_sleep = 25;
+const int smu_backoff_ms = 1;
+const int smu_backoff_retries = 5;
 const int smu_sleep_pmt = 100;
 
+#define SMU_CACHE_SLOTS 64
+
+typedef struct {
+    int valid;
+    unsigned int key;           //Argument sent with the get command
+    int value;
+    unsigned long long time_ns;
+} smu_cache_entry;
+
+//Values only change with our own set operations, which invalidate them, or other tools.
+//One cache per process: every SMU object of the process talks to the same processor,
+//so it's shared by the library contexts too. The TTLs are read and written under the lock.
+static int smu_cache_ttl_ms[SMU_CACHE_KINDS] = { 10000, 10000 };
+static smu_cache_entry smu_cache[SMU_CACHE_KINDS][SMU_CACHE_SLOTS];
+static pthread_mutex_t smu_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 const int TEST_INT = 8191;
 
+static __thread smu_batch *recording = NULL;
+
+//The program's SMU, and the one a library context bound to the calling thread
+static smu_obj_t *smu_default = NULL;
+static __thread smu_obj_t *smu_bound = NULL;
+
+void smu_target_default(smu_obj_t *smu) {
+    smu_default = smu;
+}
+
+//Returns the previous binding, NULL goes back to the default. A bound thread gets
+//return codes only, no messages.
+smu_obj_t* smu_target_bind(smu_obj_t *smu) {
+    smu_obj_t *prev = smu_bound;
+
+    smu_bound = smu;
+    return prev;
+}
+
+smu_obj_t* smu_target() {
+    return smu_bound ? smu_bound : smu_default;
+}
+
+//ttl_ms 0 disables the cache for kind, SMU_CACHE_KINDS sets every kind
+void smu_cache_set_ttl(enum smu_cache_kind kind, int ttl_ms) {
+    int i;
+
+    pthread_mutex_lock(&smu_cache_lock);
+    for (i = 0; i < SMU_CACHE_KINDS; i++) {
+        if (kind == SMU_CACHE_KINDS || kind == (enum smu_cache_kind)i) {
+            smu_cache_ttl_ms[i] = ttl_ms < 0 ? 0 : ttl_ms;
+            memset(smu_cache[i], 0, sizeof(smu_cache[i]));
+        }
+    }
+    pthread_mutex_unlock(&smu_cache_lock);
+}
+
+//SMU_CACHE_KINDS drops every kind
+void smu_cache_invalidate(enum smu_cache_kind kind) {
+    int i;
+
+    pthread_mutex_lock(&smu_cache_lock);
+    for (i = 0; i < SMU_CACHE_KINDS; i++) {
+        if (kind == SMU_CACHE_KINDS || kind == (enum smu_cache_kind)i)
+            memset(smu_cache[i], 0, sizeof(smu_cache[i]));
+    }
+    pthread_mutex_unlock(&smu_cache_lock);
+}
+
+//Returns 1 and sets value on a hit younger than the TTL of kind
+int smu_cache_get(enum smu_cache_kind kind, unsigned int key, int *value) {
+    unsigned long long now = get_time_ns();
+    int i, hit = 0;
+
+    pthread_mutex_lock(&smu_cache_lock);
+    for (i = 0; smu_cache_ttl_ms[kind] && i < SMU_CACHE_SLOTS; i++) {
+        if (smu_cache[kind][i].valid && smu_cache[kind][i].key == key) {
+            if (now - smu_cache[kind][i].time_ns < smu_cache_ttl_ms[kind] * 1000000ULL) {
+                *value = smu_cache[kind][i].value;
+                hit = 1;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&smu_cache_lock);
+    return hit;
+}
+
+void smu_cache_put(enum smu_cache_kind kind, unsigned int key, int value) {
+    smu_cache_entry *entry = NULL, *oldest = NULL;
+    int i;
+
+    pthread_mutex_lock(&smu_cache_lock);
+    if (!smu_cache_ttl_ms[kind]) {
+        pthread_mutex_unlock(&smu_cache_lock);
+        return;
+    }
+    for (i = 0; i < SMU_CACHE_SLOTS && !entry; i++) {
+        if (!smu_cache[kind][i].valid || smu_cache[kind][i].key == key)
+            entry = &smu_cache[kind][i];
+        else if (!oldest || smu_cache[kind][i].time_ns < oldest->time_ns)
+            oldest = &smu_cache[kind][i];
+    }
+    if (!entry)
+        entry = oldest;
+    entry->valid = 1;
+    entry->key = key;
+    entry->value = value;
+    entry->time_ns = get_time_ns();
+    pthread_mutex_unlock(&smu_cache_lock);
+}
+
+//One buffer for the life of the process instead of a new one on every refresh
 void pmt_refresh(pm_table *pmt) {
-    if (smu_pm_tables_supported(&obj)) {
-        unsigned char* pm_buf;
-        pm_buf = calloc(obj.pm_table_size, sizeof(unsigned char));
-        select_pm_table_version(obj.pm_table_version, pmt, pm_buf);
-        smu_read_pm_table(&obj, pm_buf, obj.pm_table_size);
+    static unsigned char *pm_buf = NULL;
+    smu_obj_t *smu = smu_target();
+
+    if (smu && smu_pm_tables_supported(smu)) {
+        if (!pm_buf)
+            pm_buf = calloc(smu->pm_table_size, sizeof(unsigned char));
+        if (!pm_buf)
+            return;
+        select_pm_table_version(smu->pm_table_version, pmt, pm_buf);
+        smu_read_pm_table(smu, pm_buf, smu->pm_table_size);
         msleep(smu_sleep_pmt);
     }
 }
 
-int send_tri_command(unsigned int op_rsmu, unsigned int op_mp1, unsigned int op_hsmp, smu_arg_t *args) {
-    int ret_rsmu = 1, ret_mp1 = 1, ret_hsmp = 1;
-    smu_return_val ret_smu;
-
-    if (op_rsmu != 0x0) {
-        ret_smu = smu_send_command(&obj, op_rsmu, args, TYPE_RSMU);
-        if ( ret_smu != SMU_Return_OK) {
-            if (debuglog)
-                fprintf(stderr, "\nSMU Error, RSMU cmd:0x%X MSG=%s\n", op_rsmu, smu_return_to_str(ret_smu));
-        } else {
-            ret_rsmu = 0;
+//Send one command trying RSMU, MP1 and HSMP in this order, stop at the first that takes it.
+//Only a busy mailbox or a timeout is retried, with an exponential back-off.
+static int send_batch_cmd(smu_batch_cmd *cmd, int *retries) {
+    const unsigned int ops[3] = { cmd->op_rsmu, cmd->op_mp1, cmd->op_hsmp };
+    const enum smu_mailbox mailboxes[3] = { TYPE_RSMU, TYPE_MP1, TYPE_HSMP };
+    const char *names[3] = { "RSMU", "MP1", "HSMP" };
+    smu_return_val ret_smu, errors[3] = { 0 };
+    smu_obj_t *smu = smu_target();
+    int i, attempt, delay_ms;
+
+    if (!smu)
+        return 1;
+
+    for (i = 0; i < 3; i++) {
+        if (ops[i] == 0x0)
+            continue;
+
+        delay_ms = smu_backoff_ms;
+        for (attempt = 0; attempt <= smu_backoff_retries; attempt++) {
+            ret_smu = smu_send_command(smu, ops[i], &cmd->args, mailboxes[i]);
+            if (ret_smu != SMU_Return_CmdRejectedBusy && ret_smu != SMU_Return_CommandTimeout)
+                break;
+            if (attempt == smu_backoff_retries)
+                break;
+            msleep(delay_ms);
+            delay_ms *= 2;
+            (*retries)++;
         }
-        msleep(smu_sleep);
-    }
 
-    if (op_mp1 != 0x0) {
-        ret_smu = smu_send_command(&obj, op_mp1, args, TYPE_MP1);
-        if ( ret_smu != SMU_Return_OK) {
-            if (debuglog)
-                fprintf(stderr, "\nSMU Error, MP1 cmd:0x%X MSG=%s\n", op_mp1, smu_return_to_str(ret_smu));
-        } else {
-            ret_mp1 = 0;        
+        if (ret_smu == SMU_Return_OK) {
+            cmd->mailbox = mailboxes[i];
+            return 0;
         }
-        msleep(smu_sleep);
+        errors[i] = ret_smu;
     }
 
-    if (op_hsmp != 0x0) {
-        ret_smu = smu_send_command(&obj, op_hsmp, args, TYPE_HSMP);
-        if ( ret_smu != SMU_Return_OK) {
-            if (debuglog)
-                fprintf(stderr, "\nSMU Error, HSMP cmd:0x%X MSG=%s\n", op_hsmp, smu_return_to_str(ret_smu));
-        } else {
-            ret_hsmp = 0;        
-        }
-        msleep(smu_sleep);
+    //Only worth a message when no mailbox took the command
+    for (i = 0; i < 3 && debuglog && !smu_bound; i++) {
+        if (errors[i])
+            fprintf(stderr, "\nSMU Error, %s cmd:0x%X MSG=%s\n", names[i], ops[i], smu_return_to_str(errors[i]));
     }
 
-    if (ret_rsmu == 0 || ret_mp1 == 0 || ret_hsmp == 0)
-        return 0;
     return 1;
+}
+
+void smu_batch_init(smu_batch *batch) {
+    memset(batch, 0, sizeof(*batch));
+}
+
+int smu_batch_add(smu_batch *batch, unsigned int op_rsmu, unsigned int op_mp1, unsigned int op_hsmp, smu_arg_t *args) {
+    smu_batch_cmd *cmd;
+
+    if (batch->count >= SMU_BATCH_MAX)
+        return -1;
+
+    cmd = &batch->cmds[batch->count];
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->op_rsmu = op_rsmu;
+    cmd->op_mp1 = op_mp1;
+    cmd->op_hsmp = op_hsmp;
+    cmd->args = *args;
 
+    return batch->count++;
+}
+
+//Sends one command right away, also while a batch is recorded. Returns 0 on success.
+int smu_batch_cmd_send(smu_batch_cmd *cmd) {
+    int retries = 0;
+
+    cmd->ret = send_batch_cmd(cmd, &retries);
+    //Any set operation could be in there
+    smu_cache_invalidate(SMU_CACHE_KINDS);
+    return cmd->ret;
+}
+
+int smu_batch_run(smu_batch *batch) {
+    unsigned long long start = get_time_ns();
+    int i;
+
+    batch->failed = 0;
+    batch->retries = 0;
+    for (i = 0; i < batch->count; i++) {
+        batch->cmds[i].ret = send_batch_cmd(&batch->cmds[i], &batch->retries);
+        if (batch->cmds[i].ret)
+            batch->failed++;
+    }
+    batch->latency_ns = get_time_ns() - start;
+    smu_cache_invalidate(SMU_CACHE_KINDS);
+
+    return batch->failed;
+}
+
+//While a batch is recorded the op_set_* functions queue their command into it instead of sending.
+//Pass NULL to go back to sending.
+void smu_batch_record(smu_batch *batch) {
+    recording = batch;
+}
+
+int send_tri_command(unsigned int op_rsmu, unsigned int op_mp1, unsigned int op_hsmp, smu_arg_t *args) {
+    smu_batch_cmd cmd;
+    int retries = 0;
+
+    if (recording)
+        return smu_batch_add(recording, op_rsmu, op_mp1, op_hsmp, args) < 0 ? 1 : 0;
+
+    memset(&cmd, 0, sizeof(cmd));
+    cmd.op_rsmu = op_rsmu;
+    cmd.op_mp1 = op_mp1;
+    cmd.op_hsmp = op_hsmp;
+    cmd.args = *args;
+
+    cmd.ret = send_batch_cmd(&cmd, &retries);
+    *args = cmd.args;
+
+    return cmd.ret;
 }
 
 void cmd_get_ppt(pm_table *pmt) {
@@ -1075,6 +1260,7 @@ int op_get_scalar(system_info *sysinfo) {
     unsigned int op_mp1 = 0x0;
     unsigned int op_hsmp = 0x0;
     smu_arg_t args;
+    unsigned int key;
     int ret = 0;
 
     memset(&args, 0, sizeof(args));
@@ -1116,11 +1302,17 @@ int op_get_scalar(system_info *sysinfo) {
     
     if (op_rsmu == 0x0 && op_mp1 == 0x0 && op_hsmp == 0x0) return -100;
 
+    key = args.i.args0;
+    if (smu_cache_get(SMU_CACHE_SCALAR, key, &ret))
+        return ret;
+
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
 
-    return (int)args.f.args0_f;
+    ret = (int)args.f.args0_f;
+    smu_cache_put(SMU_CACHE_SCALAR, key, ret);
+    return ret;
     
 }
 
@@ -1197,6 +1389,7 @@ int op_set_scalar(system_info *sysinfo, int val) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_SCALAR);
 
     return (int)args.f.args0_f;
     
@@ -1296,6 +1489,7 @@ int op_set_enable_oc(system_info *sysinfo) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_KINDS);
 
     return (int)args.f.args0_f;
     
@@ -1383,6 +1577,7 @@ int op_set_disable_oc(system_info *sysinfo) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_KINDS);
 
     return (int)args.f.args0_f;
     
@@ -1421,6 +1616,7 @@ int op_get_cocount(system_info *sysinfo, int val, int use_coremap) {
     unsigned int op_mp1 = 0x0;
     unsigned int op_hsmp = 0x0;
     smu_arg_t args;
+    unsigned int key;
     int ret = 0;
 
     memset(&args, 0, sizeof(args));
@@ -1469,14 +1665,38 @@ int op_get_cocount(system_info *sysinfo, int val, int use_coremap) {
     
     if (op_rsmu == 0x0 && op_mp1 == 0x0 && op_hsmp == 0x0) return -100;
 
+    key = args.i.args0;
+    if (smu_cache_get(SMU_CACHE_COCOUNT, key, &ret))
+        return ret;
+
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
 
+    smu_cache_put(SMU_CACHE_COCOUNT, key, args.i.args0);
     return args.i.args0;
 
 }
 
+void cmd_set_cocount_batch(system_info *sysinfo, int (*cores)[2], int count) {
+    smu_batch batch;
+    int i, ret;
+
+    ret = op_set_cocount_batch(sysinfo, cores, count, &batch);
+    for (i = 0; i < count; i++) {
+        if (ret == -100) {
+            fprintf(stdout, "set-cocount: NA\n");
+        } else if (ret == -200 || batch.cmds[i].ret) {
+            fprintf(stdout, "set-cocount: ERROR\n");
+        } else {
+            fprintf(stdout, "set-cocount: %i%+.1i\n", cores[i][0], cores[i][1]);
+        }
+    }
+    if (ret >= 0 && debuglog)
+        fprintf(stderr, "set-cocount: batch of %d commands in %.3f ms, %d failed, %d retries\n",
+            batch.count, batch.latency_ns / 1e6, batch.failed, batch.retries);
+}
+
 void cmd_set_cocount(system_info *sysinfo, int core, int count) {
     int cocount = op_set_cocount(sysinfo, core, count);
     if (cocount == -100) {
@@ -1488,14 +1708,13 @@ void cmd_set_cocount(system_info *sysinfo, int core, int count) {
     }
 }
 
-int op_set_cocount(system_info *sysinfo, int coreidx, int val) {
+//Fills the mailbox ops and arguments to set the CO count of a core
+static int set_cocount_cmd(system_info *sysinfo, int coreidx, int val, unsigned int *ops, smu_arg_t *args) {
     unsigned int op_rsmu = 0x0;
     unsigned int op_mp1 = 0x0;
     unsigned int op_hsmp = 0x0;
-    smu_arg_t args;
-    int ret = 0;
 
-    memset(&args, 0, sizeof(args));
+    memset(args, 0, sizeof(*args));
 
     u_int32_t ccxInCcd = sysinfo->ccxs;
     u_int32_t ccx = sysinfo->ccxs;
@@ -1509,8 +1728,8 @@ int op_set_cocount(system_info *sysinfo, int coreidx, int val) {
     switch(sysinfo->smu_codename) {
         case CODENAME_VERMEER: //Zen3Settings -> Zen2Settings
         case CODENAME_MILAN: //Zen3Settings -> Zen2Settings
-            //args.i.args0 = (u_int32_t)(((ucore & 8) << 5 | (ucore & 7)) << 20 | (count & 65535));
-            args.i.args0 = (u_int32_t)(((ccd << 4 | ccx % ccxInCcd & 0xF) << 4 | core % coresInCcx & 0xF) << 20 | (val & 65535));
+            //args->i.args0 = (u_int32_t)(((ucore & 8) << 5 | (ucore & 7)) << 20 | (count & 65535));
+            args->i.args0 = (u_int32_t)(((ccd << 4 | ccx % ccxInCcd & 0xF) << 4 | core % coresInCcx & 0xF) << 20 | (val & 65535));
             op_mp1 = 0x35;
             op_rsmu = 0xA;
             break;
@@ -1518,10 +1737,10 @@ int op_set_cocount(system_info *sysinfo, int coreidx, int val) {
         case CODENAME_LUCIENNE: //APUSettings1
         case CODENAME_REMBRANDT: //APUSettings2 -> APUSettings1
         case CODENAME_VANGOGH: //APUSettings2 -> APUSettings1
-            args.i.args0 = (u_int32_t)(core << 20 | (val & 0xFFFF));
+            args->i.args0 = (u_int32_t)(core << 20 | (val & 0xFFFF));
             op_mp1 = 0x53;
         case CODENAME_CEZANNE: //APUSettings1_Cezanne
-            args.i.args0 = (u_int32_t)(core << 20 | (val & 0xFFFF));
+            args->i.args0 = (u_int32_t)(core << 20 | (val & 0xFFFF));
             op_rsmu = 0x52;
             break;
         case CODENAME_PINNACLERIDGE: //ZenPSettings
@@ -1539,18 +1758,51 @@ int op_set_cocount(system_info *sysinfo, int coreidx, int val) {
             break;
     }
     
+    ops[0] = op_rsmu;
+    ops[1] = op_mp1;
+    ops[2] = op_hsmp;
+
     if (op_rsmu == 0x0 && op_mp1 == 0x0 && op_hsmp == 0x0) return -100;
+
+    return 0;
+}
+
+int op_set_cocount(system_info *sysinfo, int coreidx, int val) {
+    unsigned int ops[3];
+    smu_arg_t args;
+    int ret = 0;
+
+    ret = set_cocount_cmd(sysinfo, coreidx, val, ops, &args);
+    if (ret < 0) return ret;
     // this is a check set is supported
     if (val == TEST_INT) return 0;
 
-    ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
+    ret = send_tri_command(ops[0], ops[1], ops[2], &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_COCOUNT);
 
     return (int)args.f.args0_f;
     
 }
 
+//Sets the CO count of several cores in one batch, cores holds {core, count} pairs.
+//Returns the number of commands that failed, -100 or -200 if the batch couldn't be built.
+int op_set_cocount_batch(system_info *sysinfo, int (*cores)[2], int count, smu_batch *batch) {
+    unsigned int ops[3];
+    smu_arg_t args;
+    int i, ret;
+
+    smu_batch_init(batch);
+    for (i = 0; i < count; i++) {
+        ret = set_cocount_cmd(sysinfo, cores[i][0], cores[i][1], ops, &args);
+        if (ret < 0) return ret;
+        if (smu_batch_add(batch, ops[0], ops[1], ops[2], &args) < 0) return -200;
+    }
+
+    return smu_batch_run(batch);
+}
+
 void cmd_set_cocountall(system_info *sysinfo, int count) {
     int cocount = op_set_cocountall(sysinfo, count);
     if (cocount == -100) {
@@ -1618,6 +1870,7 @@ int op_set_cocountall(system_info *sysinfo, int val) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_COCOUNT);
 
     return (int)args.f.args0_f;
 }
@@ -1676,6 +1929,7 @@ int op_set_enable_eco(system_info *sysinfo) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_KINDS);
 
     return (int)args.f.args0_f;
     
@@ -1735,6 +1989,7 @@ int op_set_enable_maxperf(system_info *sysinfo) {
     ret = send_tri_command(op_rsmu, op_mp1, op_hsmp, &args);
 
     if (ret == 1) return -200;
+    smu_cache_invalidate(SMU_CACHE_KINDS);
 
     return (int)args.f.args0_f;
     
@@ -20,13 +20,56 @@
 #ifndef SETINFO_H
 #define SETINFO_H
 
+#include <libsmu.h>
 #include "pm_tables.h"
 #include "readinfo.h"
 
+#define SMU_BATCH_MAX 64
+
+typedef struct {
+    unsigned int op_rsmu;
+    unsigned int op_mp1;
+    unsigned int op_hsmp;
+    smu_arg_t args;             //Sent and returned
+    int ret;                    //0 on success, 1 if no mailbox took the command
+    enum smu_mailbox mailbox;   //Mailbox that took the command
+} smu_batch_cmd;
+
+typedef struct {
+    smu_batch_cmd cmds[SMU_BATCH_MAX];
+    int count;
+    int failed;
+    int retries;                //Back-offs on a busy mailbox or a timeout
+    unsigned long long latency_ns;
+} smu_batch;
+
+//Mailbox derived values kept by the read-through cache of the op_get_* functions
+enum smu_cache_kind {
+    SMU_CACHE_SCALAR,
+    SMU_CACHE_COCOUNT,
+    SMU_CACHE_KINDS
+};
+
+extern int debuglog;
+
+void smu_target_default(smu_obj_t *smu);
+smu_obj_t* smu_target_bind(smu_obj_t *smu);
+smu_obj_t* smu_target();
+
 void pmt_refresh(pm_table *pmt);
+void smu_cache_set_ttl(enum smu_cache_kind kind, int ttl_ms);
+void smu_cache_invalidate(enum smu_cache_kind kind);
+int smu_cache_get(enum smu_cache_kind kind, unsigned int key, int *value);
+void smu_cache_put(enum smu_cache_kind kind, unsigned int key, int value);
 
 int send_tri_command(unsigned int op_rsmu, unsigned int op_mp1, unsigned int op_hsmp, smu_arg_t *args);
 
+void smu_batch_init(smu_batch *batch);
+int smu_batch_add(smu_batch *batch, unsigned int op_rsmu, unsigned int op_mp1, unsigned int op_hsmp, smu_arg_t *args);
+int smu_batch_run(smu_batch *batch);
+int smu_batch_cmd_send(smu_batch_cmd *cmd);
+void smu_batch_record(smu_batch *batch);
+
 void cmd_get_ppt(pm_table *pmt);
 int op_get_ppt(pm_table *pmt);
 
@@ -113,6 +156,8 @@ int op_get_cocount(system_info *sysinfo, int val, int use_coremap);
 
 void cmd_set_cocount(system_info *sysinfo, int core, int count);
 int op_set_cocount(system_info *sysinfo, int core, int val);
+void cmd_set_cocount_batch(system_info *sysinfo, int (*cores)[2], int count);
+int op_set_cocount_batch(system_info *sysinfo, int (*cores)[2], int count, smu_batch *batch);
 
 void cmd_set_cocountall(system_info *sysinfo, int count);
 int op_set_cocountall(system_info *sysinfo, int val);
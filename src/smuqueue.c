@@ -0,0 +1,297 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Asynchronous SMU command queue.
+ *
+ * A single worker thread sends the queued commands and PM table reads so the
+ * caller doesn't wait for the mailbox round trip. Requests are served in
+ * priority order, FIFO within a priority, so PM table reads queued as high
+ * priority always go before bulk writes waiting in the queue. A write
+ * submitted with SMU_REQ_MERGE replaces a pending write of the same command,
+ * the replaced requests complete together with it since the last value wins.
+ *
+ * Callbacks run on the worker thread, or on the thread calling
+ * smu_queue_cancel()/smu_queue_stop() for cancelled requests. A request
+ * owned by the caller must stay valid until it's done or cancelled.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <libsmu.h>
+#include "smuqueue.h"
+
+extern smu_obj_t obj;
+
+static pthread_t worker;
+static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static smu_request *head[SMU_QUEUE_PRIO_COUNT], *tail[SMU_QUEUE_PRIO_COUNT];
+static int queue_running = 0;
+static int queue_stopping = 0;
+
+//Called with queue_lock held
+static void list_append(smu_request *req) {
+    req->next = NULL;
+    if (tail[req->prio])
+        tail[req->prio]->next = req;
+    else
+        head[req->prio] = req;
+    tail[req->prio] = req;
+}
+
+//Called with queue_lock held
+static int list_remove(smu_request *req) {
+    smu_request *prev = NULL, *cur;
+
+    for (cur = head[req->prio]; cur; prev = cur, cur = cur->next) {
+        if (cur != req)
+            continue;
+        if (prev)
+            prev->next = cur->next;
+        else
+            head[req->prio] = cur->next;
+        if (tail[req->prio] == cur)
+            tail[req->prio] = prev;
+        cur->next = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+//Called with queue_lock held
+static smu_request* list_pop() {
+    smu_request *req;
+    int prio;
+
+    for (prio = 0; prio < SMU_QUEUE_PRIO_COUNT; prio++) {
+        if ((req = head[prio])) {
+            list_remove(req);
+            return req;
+        }
+    }
+    return NULL;
+}
+
+static int same_write(smu_request *req, smu_request *pending) {
+    return !req->pm_buf && !pending->pm_buf && (pending->flags & SMU_REQ_MERGE) &&
+        req->cmd.op_rsmu == pending->cmd.op_rsmu && req->cmd.op_mp1 == pending->cmd.op_mp1 &&
+        req->cmd.op_hsmp == pending->cmd.op_hsmp &&
+        !((req->cmd.args.i.args0 ^ pending->cmd.args.i.args0) & req->merge_mask);
+}
+
+//Called with queue_lock held, moves the pending writes req replaces to its merged list
+static void merge_pending(smu_request *req) {
+    smu_request *cur, *next, *m;
+    int prio;
+
+    for (prio = 0; prio < SMU_QUEUE_PRIO_COUNT; prio++) {
+        for (cur = head[prio]; cur; cur = next) {
+            next = cur->next;
+            if (!same_write(req, cur))
+                continue;
+            list_remove(cur);
+            while ((m = cur->merged)) {
+                cur->merged = m->next;
+                m->next = req->merged;
+                req->merged = m;
+            }
+            cur->next = req->merged;
+            req->merged = cur;
+        }
+    }
+}
+
+static void finish(smu_request *req, enum smu_request_state state) {
+    if (req->cb)
+        req->cb(req);
+    if (req->flags & SMU_REQ_AUTOFREE) {
+        free(req);
+        return;
+    }
+    pthread_mutex_lock(&queue_lock);
+    req->state = state;
+    pthread_cond_broadcast(&done_cond);
+    pthread_mutex_unlock(&queue_lock);
+}
+
+static void complete(smu_request *req, enum smu_request_state state, int ret) {
+    smu_request *m, *next;
+
+    for (m = req->merged; m; m = next) {
+        next = m->next;
+        m->next = NULL;
+        m->cmd.args = req->cmd.args;
+        m->cmd.mailbox = req->cmd.mailbox;
+        m->cmd.ret = m->ret = ret;
+        finish(m, state);
+    }
+    req->merged = NULL;
+    req->ret = ret;
+    finish(req, state);
+}
+
+static void* queue_worker(void *arg) {
+    smu_request *req;
+    int ret;
+
+    for (;;) {
+        pthread_mutex_lock(&queue_lock);
+        while (!queue_stopping && !(req = list_pop()))
+            pthread_cond_wait(&work_cond, &queue_lock);
+        if (queue_stopping) {
+            pthread_mutex_unlock(&queue_lock);
+            break;
+        }
+        req->state = SMU_REQ_RUNNING;
+        pthread_mutex_unlock(&queue_lock);
+
+        if (req->pm_buf)
+            ret = smu_read_pm_table(&obj, req->pm_buf, obj.pm_table_size) == SMU_Return_OK ? 0 : 1;
+        else
+            ret = smu_batch_cmd_send(&req->cmd);
+        complete(req, SMU_REQ_DONE, ret);
+    }
+    return NULL;
+}
+
+int smu_queue_start() {
+    int prio;
+
+    if (queue_running)
+        return 0;
+
+    for (prio = 0; prio < SMU_QUEUE_PRIO_COUNT; prio++)
+        head[prio] = tail[prio] = NULL;
+    queue_stopping = 0;
+    if (pthread_create(&worker, NULL, queue_worker, NULL) != 0)
+        return -1;
+    queue_running = 1;
+    return 0;
+}
+
+//Cancels what is still pending and waits for the request being sent
+void smu_queue_stop() {
+    smu_request *cancelled = NULL, *req;
+
+    if (!queue_running)
+        return;
+
+    pthread_mutex_lock(&queue_lock);
+    queue_stopping = 1;
+    while ((req = list_pop())) {
+        req->next = cancelled;
+        cancelled = req;
+    }
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&queue_lock);
+
+    pthread_join(worker, NULL);
+    queue_running = 0;
+
+    while ((req = cancelled)) {
+        cancelled = req->next;
+        complete(req, SMU_REQ_CANCELLED, 1);
+    }
+}
+
+int smu_queue_running() {
+    return queue_running;
+}
+
+int smu_queue_submit(smu_request *req) {
+    if (!queue_running || req->prio < 0 || req->prio >= SMU_QUEUE_PRIO_COUNT)
+        return -1;
+
+    req->state = SMU_REQ_PENDING;
+    req->ret = 0;
+    req->next = NULL;
+    req->merged = NULL;
+
+    pthread_mutex_lock(&queue_lock);
+    if (req->flags & SMU_REQ_MERGE)
+        merge_pending(req);
+    list_append(req);
+    pthread_cond_signal(&work_cond);
+    pthread_mutex_unlock(&queue_lock);
+    return 0;
+}
+
+//Fire and forget, the queue owns the request. The result is only seen by cb.
+int smu_queue_post(smu_batch_cmd *cmd, enum smu_queue_prio prio, unsigned int flags,
+                   unsigned int merge_mask, smu_request_cb cb, void *user) {
+    smu_request *req;
+
+    if (!(req = calloc(1, sizeof(smu_request))))
+        return -1;
+
+    req->cmd = *cmd;
+    req->prio = prio;
+    req->flags = flags | SMU_REQ_AUTOFREE;
+    req->merge_mask = merge_mask;
+    req->cb = cb;
+    req->user = user;
+    if (smu_queue_submit(req) != 0) {
+        free(req);
+        return -1;
+    }
+    return 0;
+}
+
+//Only a pending request can be cancelled, the writes it replaced are cancelled with it.
+//Returns 0 if it was cancelled, -1 if it's running, done or merged into a newer write.
+int smu_queue_cancel(smu_request *req) {
+    int found;
+
+    pthread_mutex_lock(&queue_lock);
+    found = req->state == SMU_REQ_PENDING && list_remove(req);
+    pthread_mutex_unlock(&queue_lock);
+
+    if (!found)
+        return -1;
+    complete(req, SMU_REQ_CANCELLED, 1);
+    return 0;
+}
+
+//Blocks until the request is done or cancelled, returns its result. Not for posted requests.
+int smu_queue_wait(smu_request *req) {
+    pthread_mutex_lock(&queue_lock);
+    while (req->state == SMU_REQ_PENDING || req->state == SMU_REQ_RUNNING)
+        pthread_cond_wait(&done_cond, &queue_lock);
+    pthread_mutex_unlock(&queue_lock);
+    return req->ret;
+}
+
+//High priority read through the queue, or a direct read when the queue is not running.
+//Returns 0 on success.
+int smu_queue_read_pm_table(unsigned char *pm_buf) {
+    smu_request req;
+
+    if (!queue_running)
+        return smu_read_pm_table(&obj, pm_buf, obj.pm_table_size) == SMU_Return_OK ? 0 : 1;
+
+    memset(&req, 0, sizeof(req));
+    req.pm_buf = pm_buf;
+    req.prio = SMU_QUEUE_PRIO_HIGH;
+    if (smu_queue_submit(&req) != 0)
+        return 1;
+    return smu_queue_wait(&req);
+}
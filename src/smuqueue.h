@@ -0,0 +1,73 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef SMUQUEUE_H
+#define SMUQUEUE_H
+
+#include "setinfo.h"
+
+enum smu_queue_prio {
+    SMU_QUEUE_PRIO_HIGH,        //PM table reads
+    SMU_QUEUE_PRIO_NORMAL,      //Single set operations
+    SMU_QUEUE_PRIO_BULK,        //Long runs of writes, e.g. CO counts of every core
+    SMU_QUEUE_PRIO_COUNT
+};
+
+enum smu_request_state {
+    SMU_REQ_IDLE,
+    SMU_REQ_PENDING,
+    SMU_REQ_RUNNING,
+    SMU_REQ_DONE,
+    SMU_REQ_CANCELLED,
+};
+
+#define SMU_REQ_MERGE       0x1     //Replaces a pending write of the same command, see merge_mask
+#define SMU_REQ_AUTOFREE    0x2     //Allocated by smu_queue_post(), freed after the callback
+
+typedef struct smu_request smu_request;
+typedef void (*smu_request_cb)(smu_request *req);
+
+struct smu_request {
+    //Set by the caller
+    smu_batch_cmd cmd;          //Command to send, ignored for a PM table read
+    unsigned char *pm_buf;      //PM table read into this buffer when not NULL
+    enum smu_queue_prio prio;
+    unsigned int flags;
+    unsigned int merge_mask;    //Pending writes with the same ops and equal args0 & merge_mask are merged
+    smu_request_cb cb;          //Called when done or cancelled, may be NULL
+    void *user;
+
+    //Owned by the queue
+    volatile enum smu_request_state state;
+    int ret;                    //0 on success, 1 if the command or read failed
+    smu_request *next;
+    smu_request *merged;        //Older writes replaced by this one, they complete with it
+};
+
+int smu_queue_start();
+void smu_queue_stop();
+int smu_queue_running();
+int smu_queue_submit(smu_request *req);
+int smu_queue_post(smu_batch_cmd *cmd, enum smu_queue_prio prio, unsigned int flags,
+                   unsigned int merge_mask, smu_request_cb cb, void *user);
+int smu_queue_cancel(smu_request *req);
+int smu_queue_wait(smu_request *req);
+int smu_queue_read_pm_table(unsigned char *pm_buf);
+
+#endif
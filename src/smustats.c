@@ -0,0 +1,123 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Reports of the libsmu mailbox and table access statistics, as a table
+ * for --stats and as influx lines for the export stream.
+ **/
+
+#include <stdio.h>
+#include <libsmu.h>
+#include "smustats.h"
+
+extern smu_obj_t obj;
+
+static const char *mailbox_names[] = { "RSMU", "MP1", "HSMP" };
+
+static const char* entry_name(const smu_stats_entry *e, char *buf, size_t len) {
+    switch (e->source) {
+        case SMU_STATS_PM_READ:     return "pm_table";
+        case SMU_STATS_SMN_READ:    return "smn";
+        case SMU_STATS_SMN_BATCH:   return "smn_batch";
+        default:
+            snprintf(buf, len, "%s 0x%02X", mailbox_names[e->mailbox], e->op);
+            return buf;
+    }
+}
+
+static unsigned long long entry_errors(const smu_stats_entry *e) {
+    return e->calls - e->status[0];
+}
+
+static void print_entry(FILE *fp, const smu_stats_entry *e) {
+    char name[16];
+    int i, first = 1;
+
+    if (!e->calls)
+        return;
+
+    fprintf(fp, "%-10s %10llu %8llu %9.1f %9.1f %9.1f %9.1f  ", entry_name(e, name, sizeof(name)),
+        e->calls, entry_errors(e), e->total_ns / 1e3 / e->calls,
+        smu_stats_percentile(e, 0.5) / 1e3, smu_stats_percentile(e, 0.99) / 1e3, e->max_ns / 1e3);
+
+    for (i = 1; i < SMU_STATS_STATUS_COUNT; i++) {
+        if (!e->status[i])
+            continue;
+        if (i == SMU_STATS_STATUS_COUNT - 1)
+            fprintf(fp, "%sOther:%llu", first ? "" : ",", e->status[i]);
+        else
+            fprintf(fp, "%s%s:%llu", first ? "" : ",", smu_return_to_str(smu_stats_status_value(i)), e->status[i]);
+        first = 0;
+    }
+    fprintf(fp, "\n");
+}
+
+void print_smu_stats(FILE *fp) {
+    const smu_stats_t *stats = smu_get_stats(&obj);
+    unsigned int i;
+
+    if (!stats) {
+        fprintf(fp, "SMU statistics are not available.\n");
+        return;
+    }
+
+    fprintf(fp, "%-10s %10s %8s %9s %9s %9s %9s  %s\n", "Access", "Calls", "Errors", "Avg us", "P50 us", "P99 us", "Max us", "Status");
+    print_entry(fp, &stats->pm_read);
+    print_entry(fp, &stats->smn_read);
+    print_entry(fp, &stats->smn_batch);
+    for (i = 0; i < stats->cmd_count; i++)
+        print_entry(fp, &stats->cmds[i]);
+    if (stats->cmd_dropped)
+        fprintf(fp, "%llu commands not recorded, more than %d opcodes\n", stats->cmd_dropped, SMU_STATS_MAX_CMDS);
+}
+
+static void draw_entry_export(const char *hostname, const smu_stats_entry *e) {
+    char tags[48];
+
+    if (!e->calls)
+        return;
+
+    if (e->source == SMU_STATS_CMD)
+        snprintf(tags, sizeof(tags), "source=cmd,mailbox=%s,op=0x%02X", mailbox_names[e->mailbox], e->op);
+    else
+        snprintf(tags, sizeof(tags), "source=%s", e->source == SMU_STATS_PM_READ ? "pm_table" :
+            e->source == SMU_STATS_SMN_READ ? "smn" : "smn_batch");
+
+    fprintf(stdout,
+            "ryzen_monitor_ng,host=%s,name=SMU,%s calls=%llui,errors=%llui,busy=%llui,timeouts=%llui,latency_avg_us=%.1f,latency_p50_us=%.1f,latency_p99_us=%.1f,latency_max_us=%.1f\n",
+            hostname, tags, e->calls, entry_errors(e),
+            e->status[smu_stats_status_index(SMU_Return_CmdRejectedBusy)],
+            e->status[smu_stats_status_index(SMU_Return_CommandTimeout)],
+            e->total_ns / 1e3 / e->calls, smu_stats_percentile(e, 0.5) / 1e3,
+            smu_stats_percentile(e, 0.99) / 1e3, e->max_ns / 1e3);
+}
+
+void draw_smu_stats_export(const char *hostname) {
+    const smu_stats_t *stats = smu_get_stats(&obj);
+    unsigned int i;
+
+    if (!stats)
+        return;
+
+    draw_entry_export(hostname, &stats->pm_read);
+    draw_entry_export(hostname, &stats->smn_read);
+    draw_entry_export(hostname, &stats->smn_batch);
+    for (i = 0; i < stats->cmd_count; i++)
+        draw_entry_export(hostname, &stats->cmds[i]);
+}
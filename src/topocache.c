@@ -0,0 +1,164 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+/**
+ * Cache of the static processor facts gathered by init_sysinfo().
+ *
+ * The file lives on tmpfs and is keyed by SMU FW, PM table version, CPUID
+ * signature and boot ID, so a BIOS update, a CPU swap or a reboot invalidate it.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <cpuid.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "topocache.h"
+
+typedef struct {
+    char magic[8];
+    unsigned int version;
+    topocache_key key;
+    char cpu_name[64];
+    unsigned int family;
+    unsigned int model;
+    unsigned int cores;
+    unsigned int ccds;
+    unsigned int ccxs;
+    unsigned int cores_per_ccx;
+    unsigned int core_disable_map;
+    unsigned int core_disable_map_pmt;
+    unsigned int enabled_cores_count;
+    unsigned int physical_cores;
+    //Followed by cores ints of coremap
+} topocache_header;
+
+void topocache_make_key(topocache_key *key, unsigned int smu_version, unsigned int pm_table_version) {
+    unsigned int eax, ebx, ecx, edx;
+    FILE *fp;
+
+    memset(key, 0, sizeof(*key));
+    key->smu_version = smu_version;
+    key->pm_table_version = pm_table_version;
+
+    //Left at 0 without the leaf, the boot id still keys the cache
+    if (__get_cpuid(0x00000001, &eax, &ebx, &ecx, &edx))
+        key->cpuid_signature = eax;
+
+    fp = fopen("/proc/sys/kernel/random/boot_id", "r");
+    if (fp) {
+        if (!fgets(key->boot_id, sizeof(key->boot_id), fp))
+            key->boot_id[0] = 0;
+        key->boot_id[strcspn(key->boot_id, "\n")] = 0;
+        fclose(fp);
+    }
+}
+
+int topocache_load(system_info *sysinfo, const topocache_key *key) {
+    static char cpu_name[64];
+    topocache_header hdr;
+    int *coremap;
+    FILE *fp;
+
+    if (!key->boot_id[0])
+        return -1;
+
+    fp = fopen(TOPOCACHE_PATH, "rb");
+    if (!fp)
+        return -1;
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        memcmp(hdr.magic, TOPOCACHE_MAGIC, sizeof(hdr.magic)) ||
+        hdr.version != TOPOCACHE_VERSION ||
+        memcmp(&hdr.key, key, sizeof(*key)) ||
+        hdr.cores == 0 || hdr.cores > 256) {
+        fclose(fp);
+        return -1;
+    }
+
+    coremap = (int *)malloc(hdr.cores * sizeof(int));
+    if (!coremap || fread(coremap, sizeof(int), hdr.cores, fp) != hdr.cores) {
+        free(coremap);
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    memcpy(cpu_name, hdr.cpu_name, sizeof(cpu_name));
+    cpu_name[sizeof(cpu_name)-1] = 0;
+
+    sysinfo->cpu_name            = cpu_name;
+    sysinfo->family              = hdr.family;
+    sysinfo->model               = hdr.model;
+    sysinfo->cores               = hdr.cores;
+    sysinfo->ccds                = hdr.ccds;
+    sysinfo->ccxs                = hdr.ccxs;
+    sysinfo->cores_per_ccx       = hdr.cores_per_ccx;
+    sysinfo->core_disable_map    = hdr.core_disable_map;
+    sysinfo->core_disable_map_pmt= hdr.core_disable_map_pmt;
+    sysinfo->enabled_cores_count = hdr.enabled_cores_count;
+    sysinfo->physical_cores      = hdr.physical_cores;
+    sysinfo->coremap             = coremap;
+    sysinfo->available           = 1;
+
+    return 0;
+}
+
+int topocache_store(const system_info *sysinfo, const topocache_key *key) {
+    char tmp_path[sizeof(TOPOCACHE_PATH) + 16];
+    topocache_header hdr;
+    FILE *fp;
+    int ok;
+
+    if (!key->boot_id[0] || !sysinfo->available || !sysinfo->coremap)
+        return -1;
+
+    mkdir(TOPOCACHE_DIR, 0755);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TOPOCACHE_MAGIC, sizeof(hdr.magic));
+    hdr.version              = TOPOCACHE_VERSION;
+    hdr.key                  = *key;
+    snprintf(hdr.cpu_name, sizeof(hdr.cpu_name), "%s", sysinfo->cpu_name ? sysinfo->cpu_name : "");
+    hdr.family               = sysinfo->family;
+    hdr.model                = sysinfo->model;
+    hdr.cores                = sysinfo->cores;
+    hdr.ccds                 = sysinfo->ccds;
+    hdr.ccxs                 = sysinfo->ccxs;
+    hdr.cores_per_ccx        = sysinfo->cores_per_ccx;
+    hdr.core_disable_map     = sysinfo->core_disable_map;
+    hdr.core_disable_map_pmt = sysinfo->core_disable_map_pmt;
+    hdr.enabled_cores_count  = sysinfo->enabled_cores_count;
+    hdr.physical_cores       = sysinfo->physical_cores;
+
+    //Write aside and rename, concurrent starts must never see a partial file
+    snprintf(tmp_path, sizeof(tmp_path), "%s.%d", TOPOCACHE_PATH, (int)getpid());
+    fp = fopen(tmp_path, "wb");
+    if (!fp)
+        return -1;
+    ok = fwrite(&hdr, sizeof(hdr), 1, fp) == 1 &&
+         fwrite(sysinfo->coremap, sizeof(int), sysinfo->cores, fp) == sysinfo->cores;
+    ok = (fclose(fp) == 0) && ok;
+    if (!ok || rename(tmp_path, TOPOCACHE_PATH) != 0) {
+        remove(tmp_path);
+        return -1;
+    }
+    return 0;
+}
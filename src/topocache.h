@@ -0,0 +1,42 @@
+/**
+ * Ryzen SMU Userspace Sensor Monitor and toolset
+ *
+ * Copyleft ManniX (github.com/mann1x)
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **/
+
+#ifndef TOPOCACHE_H
+#define TOPOCACHE_H
+
+#include "readinfo.h"
+
+#define TOPOCACHE_DIR       "/run/ryzen_monitor_ng"
+#define TOPOCACHE_PATH      TOPOCACHE_DIR "/topology.cache"
+#define TOPOCACHE_MAGIC     "RMNGTOPO"
+#define TOPOCACHE_VERSION   1
+
+//Everything that invalidates the cached static facts
+typedef struct {
+    unsigned int smu_version;
+    unsigned int pm_table_version;
+    unsigned int cpuid_signature;
+    char boot_id[40];
+} topocache_key;
+
+void topocache_make_key(topocache_key *key, unsigned int smu_version, unsigned int pm_table_version);
+int topocache_load(system_info *sysinfo, const topocache_key *key);
+int topocache_store(const system_info *sysinfo, const topocache_key *key);
+
+#endif